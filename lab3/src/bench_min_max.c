@@ -0,0 +1,151 @@
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <getopt.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#else
+#define HAVE_RDTSC 0
+#endif
+
+#include "find_min_max.h"
+#include "utils.h"
+
+// Сравнение реализаций GetMinMax: байт за такт и ГБ/с на массиве из
+// кэша (--array_size небольшой) и из памяти (по умолчанию 64M чисел).
+// Такты считаются по TSC, то есть на номинальной частоте процессора.
+
+static double NowSeconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t Cycles(void) {
+#if HAVE_RDTSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+int main(int argc, char **argv) {
+  int seed = 1;
+  int array_size = 64 * 1024 * 1024;
+  int repeats = 10;
+
+  while (true) {
+    static struct option options[] = {{"seed", required_argument, 0, 0},
+                                      {"array_size", required_argument, 0, 0},
+                                      {"repeats", required_argument, 0, 0},
+                                      {0, 0, 0, 0}};
+
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+
+    if (c == -1) break;
+
+    switch (c) {
+      case 0:
+        switch (option_index) {
+          case 0:
+            seed = atoi(optarg);
+            if (seed <= 0) {
+              printf("Seed must be positive\n");
+              return 1;
+            }
+            break;
+          case 1:
+            array_size = atoi(optarg);
+            if (array_size <= 0) {
+              printf("Array size must be positive\n");
+              return 1;
+            }
+            break;
+          case 2:
+            repeats = atoi(optarg);
+            if (repeats <= 0) {
+              printf("Repeats must be positive\n");
+              return 1;
+            }
+            break;
+          default:
+            printf("Index %d is out of options\n", option_index);
+        }
+        break;
+
+      case '?':
+        break;
+
+      default:
+        printf("getopt returned character code 0%o?\n", c);
+    }
+  }
+
+  int *array = malloc(sizeof(int) * array_size);
+  if (array == NULL) {
+    printf("Can not allocate %d numbers\n", array_size);
+    return 1;
+  }
+  GenerateArray(array, array_size, seed);
+
+  // Смещение на одно число проверяет невыровненные начало и хвост
+  unsigned int begin = array_size > 1 ? 1 : 0;
+  unsigned int end = array_size;
+  double bytes = (double)(end - begin) * sizeof(int);
+  struct MinMax reference = GetMinMaxIsa(MINMAX_SCALAR, array, begin, end);
+
+  printf("Array: %u numbers (%.1f MB), %d repeats, selected: %s\n",
+         end - begin, bytes / 1e6, repeats,
+         MinMaxIsaName(MinMaxSelectedIsa()));
+  printf("%-8s %12s %10s %10s %8s\n", "isa", "us/pass", "GB/s", "bytes/cyc",
+         "speedup");
+
+  double scalar_time = 0;
+  for (int isa = 0; isa < MINMAX_ISA_COUNT; isa++) {
+    if (!MinMaxIsaSupported((enum MinMaxIsa)isa)) {
+      printf("%-8s %12s\n", MinMaxIsaName((enum MinMaxIsa)isa),
+             "unsupported");
+      continue;
+    }
+
+    // Первый проход прогревает кэш и TLB и не учитывается
+    struct MinMax result =
+        GetMinMaxIsa((enum MinMaxIsa)isa, array, begin, end);
+    if (result.min != reference.min || result.max != reference.max) {
+      printf("%s: wrong result %d..%d, expected %d..%d\n",
+             MinMaxIsaName((enum MinMaxIsa)isa), result.min, result.max,
+             reference.min, reference.max);
+      return 1;
+    }
+
+    double best_time = 1e30;
+    uint64_t best_cycles = UINT64_MAX;
+    for (int r = 0; r < repeats; r++) {
+      double start = NowSeconds();
+      uint64_t start_cycles = Cycles();
+      result = GetMinMaxIsa((enum MinMaxIsa)isa, array, begin, end);
+      uint64_t cycles = Cycles() - start_cycles;
+      double elapsed = NowSeconds() - start;
+      // Результат используется, чтобы вызов не выбросил компилятор
+      if (result.min > result.max) printf("?");
+      if (elapsed < best_time) best_time = elapsed;
+      if (cycles < best_cycles) best_cycles = cycles;
+    }
+    if (isa == MINMAX_SCALAR) scalar_time = best_time;
+
+    printf("%-8s %12.3f %10.2f %10.2f %7.2fx\n",
+           MinMaxIsaName((enum MinMaxIsa)isa), best_time * 1e6,
+           bytes / best_time / 1e9,
+           best_cycles ? bytes / best_cycles : 0.0, scalar_time / best_time);
+  }
+
+  free(array);
+  return 0;
+}
@@ -1,8 +1,27 @@
 #ifndef FIND_MIN_MAX_H
 #define FIND_MIN_MAX_H
 
+#include <stdbool.h>
+
 #include "utils.h"
 
+// Реализации поиска минимума и максимума. GetMinMax использует лучшую из
+// поддерживаемых процессором; она выбирается один раз при запуске по cpuid.
+enum MinMaxIsa {
+  MINMAX_SCALAR,
+  MINMAX_SSE41,
+  MINMAX_AVX2,
+  MINMAX_AVX512,
+  MINMAX_ISA_COUNT
+};
+
 struct MinMax GetMinMax(int *array, unsigned int begin, unsigned int end);
 
+// Для сравнения реализаций: конкретная реализация, ее поддержка и имя
+struct MinMax GetMinMaxIsa(enum MinMaxIsa isa, int *array, unsigned int begin,
+                           unsigned int end);
+bool MinMaxIsaSupported(enum MinMaxIsa isa);
+enum MinMaxIsa MinMaxSelectedIsa(void);
+const char *MinMaxIsaName(enum MinMaxIsa isa);
+
 #endif
@@ -1,6 +1,7 @@
 #include <ctype.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,102 +12,106 @@
 #include <sys/wait.h>
 
 #include <getopt.h>
+#include <pthread.h>
 
+#include "file_min_max.h"
 #include "find_min_max.h"
 #include "utils.h"
 
-int main(int argc, char **argv) {
-  int seed = -1;
-  int array_size = -1;
-  int pnum = -1;
-  bool with_files = false;
+enum Backend { BACKEND_FORK, BACKEND_THREADS };
 
-  while (true) {
-    int current_optind = optind ? optind : 1;
+// Откуда берутся числа: массив из GenerateArray или файл --input
+struct Source {
+  int *array;
+  struct IntFile *file;  // NULL для массива
+  uint64_t count;
+};
 
-    static struct option options[] = {{"seed", required_argument, 0, 0},
-                                      {"array_size", required_argument, 0, 0},
-                                      {"pnum", required_argument, 0, 0},
-                                      {"by_files", no_argument, 0, 'f'},
-                                      {0, 0, 0, 0}};
-
-    int option_index = 0;
-    int c = getopt_long(argc, argv, "f", options, &option_index);
+// Часть входа для потока
+struct ThreadTask {
+  const struct Source *source;
+  int index;
+  int pnum;
+  struct MinMax min_max;
+  bool done;
+};
 
-    if (c == -1) break;
+// Минимум и максимум части index из pnum; файл читается только в пределах
+// своей части, по смещению. false - ошибка чтения
+static bool PartMinMax(const struct Source *source, int index, int pnum,
+                       struct MinMax *min_max) {
+  uint64_t chunk_size = source->count / pnum;
+  uint64_t begin = index * chunk_size;
+  uint64_t end = (index == pnum - 1) ? source->count : (index + 1) * chunk_size;
 
-    switch (c) {
-      case 0:
-        switch (option_index) {
-          case 0:
-            seed = atoi(optarg);
-            // your code here
-            if (seed <= 0) {
-              printf("Seed must be positive\n");
-              return 1;
-            }
-            break;
-          case 1:
-            array_size = atoi(optarg);
-            // your code here
-            if (array_size <= 0) {
-              printf("Array size must be positive\n");
-              return 1;
-            }
-            break;
-          case 2:
-            pnum = atoi(optarg);
-            // your code here
-            if (pnum <= 0) {
-              printf("pnum must be positive\n");
-              return 1;
-            }
-            break;
-          case 3:
-            with_files = true;
-            break;
+  if (source->file != NULL) {
+    return FileMinMax(source->file, begin, end, NULL, min_max);
+  }
+  *min_max = GetMinMax(source->array, begin, end);
+  return true;
+}
 
-          default:
-            printf("Index %d is out of options\n", option_index);
-        }
-        break;
-      case 'f':
-        with_files = true;
-        break;
+static void *ThreadMinMax(void *arg) {
+  struct ThreadTask *task = (struct ThreadTask *)arg;
+  task->done =
+      PartMinMax(task->source, task->index, task->pnum, &task->min_max);
+  return NULL;
+}
 
-      case '?':
-        break;
+// Те же части массива, что и у процессов, но в pnum потоках над общим
+// массивом: без копирования таблиц страниц и copy-on-write
+static int RunThreads(const struct Source *source, int pnum,
+                      struct MinMax *min_max) {
+  pthread_t *threads = malloc(sizeof(pthread_t) * pnum);
+  struct ThreadTask *tasks = malloc(sizeof(struct ThreadTask) * pnum);
+  if (threads == NULL || tasks == NULL) {
+    perror("malloc");
+    free(threads);
+    free(tasks);
+    return -1;
+  }
 
-      default:
-        printf("getopt returned character code 0%o?\n", c);
+  int created = 0;
+  bool failed = false;
+  for (int i = 0; i < pnum; i++) {
+    tasks[i].source = source;
+    tasks[i].index = i;
+    tasks[i].pnum = pnum;
+    if (pthread_create(&threads[i], NULL, ThreadMinMax, &tasks[i]) != 0) {
+      printf("Thread creation failed!\n");
+      break;
     }
+    created++;
   }
 
-  if (optind < argc) {
-    printf("Has at least one no option argument\n");
-    return 1;
+  min_max->min = INT_MAX;
+  min_max->max = INT_MIN;
+  for (int i = 0; i < created; i++) {
+    pthread_join(threads[i], NULL);
+    if (!tasks[i].done) {
+      failed = true;
+      continue;
+    }
+    if (tasks[i].min_max.min < min_max->min) min_max->min = tasks[i].min_max.min;
+    if (tasks[i].min_max.max > min_max->max) min_max->max = tasks[i].min_max.max;
   }
 
-  if (seed == -1 || array_size == -1 || pnum == -1) {
-    printf("Usage: %s --seed \"num\" --array_size \"num\" --pnum \"num\" \n",
-           argv[0]);
-    return 1;
-  }
+  free(threads);
+  free(tasks);
+  return created == pnum && !failed ? 0 : -1;
+}
 
-  int *array = malloc(sizeof(int) * array_size);
-  GenerateArray(array, array_size, seed);
+static int RunProcesses(const struct Source *source, int pnum, bool with_files,
+                        struct MinMax *min_max) {
   int active_child_processes = 0;
 
-  struct timeval start_time;
-  gettimeofday(&start_time, NULL);
-
   // массив каналов для общения с процессами
   int pipefd[pnum][2];
   if (!with_files) {
     for (int i = 0; i < pnum; i++) {
       if (pipe(pipefd[i]) == -1) {
         perror("pipe");
-        return 1;
+        return -1;
       }
     }
   }
@@ -118,11 +123,10 @@ int main(int argc, char **argv) {
       active_child_processes += 1;
       if (child_pid == 0) {
         // child process
-        int chunk_size = array_size / pnum;
-        int start = i * chunk_size;
-        int end = (i == pnum - 1) ? array_size : (i + 1) * chunk_size;
-
-        struct MinMax local_minmax = GetMinMax(array, start, end);
+        struct MinMax local_minmax;
+        if (!PartMinMax(source, i, pnum, &local_minmax)) {
+          exit(1);
+        }
 
         if (with_files) {
           // use files here
@@ -131,7 +135,7 @@ int main(int argc, char **argv) {
           FILE *f = fopen(filename, "w");
           if (f == NULL) {
             perror("fopen");
-            return 1;
+            exit(1);
           }
           fprintf(f, "%d %d\n", local_minmax.min, local_minmax.max);
           fclose(f);
@@ -142,12 +146,12 @@ int main(int argc, char **argv) {
           write(pipefd[i][1], &local_minmax.max, sizeof(int));
           close(pipefd[i][1]);
         }
-        return 0;
+        exit(0);
       }
 
     } else {
       printf("Fork failed!\n");
-      return 1;
+      return -1;
     }
   }
 
@@ -157,9 +161,8 @@ int main(int argc, char **argv) {
     active_child_processes -= 1;
   }
 
-  struct MinMax min_max;
-  min_max.min = INT_MAX;
-  min_max.max = INT_MIN;
+  min_max->min = INT_MAX;
+  min_max->max = INT_MIN;
 
   for (int i = 0; i < pnum; i++) {
     int min = INT_MAX;
@@ -172,7 +175,7 @@ int main(int argc, char **argv) {
       FILE *f = fopen(filename, "r");
       if (f == NULL) {
         perror("fopen");
-        return 1;
+        return -1;
       }
       fscanf(f, "%d %d", &min, &max);
       fclose(f);
@@ -180,13 +183,165 @@ int main(int argc, char **argv) {
     } else {
       // read from pipes
       close(pipefd[i][1]);
-      read(pipefd[i][0], &min, sizeof(int));
-      read(pipefd[i][0], &max, sizeof(int));
+      // Процесс, не сумевший прочитать свою часть файла, завершается без записи
+      bool got = read(pipefd[i][0], &min, sizeof(int)) == sizeof(int) &&
+                 read(pipefd[i][0], &max, sizeof(int)) == sizeof(int);
       close(pipefd[i][0]);
+      if (!got) {
+        printf("Process %d returned no result\n", i);
+        return -1;
+      }
+    }
+
+    if (min < min_max->min) min_max->min = min;
+    if (max > min_max->max) min_max->max = max;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int seed = -1;
+  int array_size = -1;
+  int pnum = -1;
+  const char *input_path = NULL;
+  bool with_files = false;
+  enum Backend backend = BACKEND_FORK;
+  enum Generator generator = GENERATOR_COUNTER;
+
+  while (true) {
+    int current_optind = optind ? optind : 1;
+
+    static struct option options[] = {{"seed", required_argument, 0, 0},
+                                      {"array_size", required_argument, 0, 0},
+                                      {"pnum", required_argument, 0, 0},
+                                      {"by_files", no_argument, 0, 'f'},
+                                      {"backend", required_argument, 0, 0},
+                                      {"generator", required_argument, 0, 0},
+                                      {"input", required_argument, 0, 0},
+                                      {0, 0, 0, 0}};
+
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "f", options, &option_index);
+
+    if (c == -1) break;
+
+    switch (c) {
+      case 0:
+        switch (option_index) {
+          case 0:
+            seed = atoi(optarg);
+            // your code here
+            if (seed <= 0) {
+              printf("Seed must be positive\n");
+              return 1;
+            }
+            break;
+          case 1:
+            array_size = atoi(optarg);
+            // your code here
+            if (array_size <= 0) {
+              printf("Array size must be positive\n");
+              return 1;
+            }
+            break;
+          case 2:
+            pnum = atoi(optarg);
+            // your code here
+            if (pnum <= 0) {
+              printf("pnum must be positive\n");
+              return 1;
+            }
+            break;
+          case 3:
+            with_files = true;
+            break;
+          case 4:
+            if (strcmp(optarg, "fork") == 0) {
+              backend = BACKEND_FORK;
+            } else if (strcmp(optarg, "threads") == 0) {
+              backend = BACKEND_THREADS;
+            } else {
+              printf("Backend must be fork or threads\n");
+              return 1;
+            }
+            break;
+          case 5:
+            if (!ParseGenerator(optarg, &generator)) {
+              printf("Generator must be counter or rand\n");
+              return 1;
+            }
+            break;
+          case 6:
+            input_path = optarg;
+            break;
+
+          default:
+            printf("Index %d is out of options\n", option_index);
+        }
+        break;
+      case 'f':
+        with_files = true;
+        break;
+
+      case '?':
+        break;
+
+      default:
+        printf("getopt returned character code 0%o?\n", c);
     }
+  }
+
+  if (optind < argc) {
+    printf("Has at least one no option argument\n");
+    return 1;
+  }
+
+  if (pnum == -1 ||
+      (input_path == NULL && (seed == -1 || array_size == -1))) {
+    printf("Usage: %s --seed \"num\" --array_size \"num\" --pnum \"num\" "
+           "[--by_files] [--backend fork|threads] [--generator counter|rand]\n",
+           argv[0]);
+    printf("       %s --input \"file\"|- --pnum \"num\" [...]  (int32 numbers)\n",
+           argv[0]);
+    return 1;
+  }
 
-    if (min < min_max.min) min_max.min = min;
-    if (max > min_max.max) min_max.max = max;
+  // Файл не загружается: обработчики отображают только свои части
+  struct IntFile file;
+  struct Source source = {NULL, NULL, 0};
+  int *array = NULL;
+  if (input_path != NULL) {
+    if (!OpenIntFile(input_path, &file)) {
+      return 1;
+    }
+    source.file = &file;
+    source.count = file.count;
+  } else {
+    array = malloc(sizeof(int) * array_size);
+    GenerateArrayWith(generator, array, array_size, seed, pnum);
+    source.array = array;
+    source.count = array_size;
+  }
+
+  struct timeval start_time;
+  gettimeofday(&start_time, NULL);
+
+  struct MinMax min_max;
+  int status;
+  if (source.file != NULL && !source.file->seekable) {
+    // Канал не делится по смещению: читается потоком в этом процессе
+    status = StreamMinMax(source.file, &min_max) ? 0 : -1;
+  } else if (backend == BACKEND_THREADS) {
+    status = RunThreads(&source, pnum, &min_max);
+  } else {
+    status = RunProcesses(&source, pnum, with_files, &min_max);
+  }
+  if (source.file != NULL) {
+    CloseIntFile(source.file);
+  }
+  if (status != 0) {
+    free(array);
+    return 1;
   }
 
   struct timeval finish_time;
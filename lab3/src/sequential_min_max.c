@@ -1,15 +1,45 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "file_min_max.h"
 #include "find_min_max.h"
 #include "utils.h"
 
+// Числа int32 из файла или stdin ("-"): обычный файл отображается окнами,
+// канал читается потоком, целиком в память вход не загружается
+static int FileMain(const char *path) {
+  struct IntFile file;
+  if (!OpenIntFile(path, &file)) {
+    return 1;
+  }
+
+  struct MinMax min_max;
+  bool ok = file.seekable
+                ? FileMinMax(&file, 0, file.count, NULL, &min_max)
+                : StreamMinMax(&file, &min_max);
+  CloseIntFile(&file);
+  if (!ok) {
+    return 1;
+  }
+
+  printf("min: %d\n", min_max.min);
+  printf("max: %d\n", min_max.max);
+
+  return 0;
+}
+
 int main(int argc, char **argv) {
-  if (argc != 3) {
-    printf("Usage: %s seed arraysize\n", argv[0]);
+  if (argc != 3 && argc != 4) {
+    printf("Usage: %s seed arraysize [counter|rand]\n", argv[0]);
+    printf("       %s --input file|-\n", argv[0]);
     return 1;
   }
 
+  if (strcmp(argv[1], "--input") == 0) {
+    return FileMain(argv[2]);
+  }
+
   int seed = atoi(argv[1]);
   if (seed <= 0) {
     printf("seed is a positive number\n");
@@ -22,8 +52,14 @@ int main(int argc, char **argv) {
     return 1;
   }
 
+  enum Generator generator = GENERATOR_COUNTER;
+  if (argc == 4 && !ParseGenerator(argv[3], &generator)) {
+    printf("generator is counter or rand\n");
+    return 1;
+  }
+
   int *array = malloc(array_size * sizeof(int));
-  GenerateArray(array, array_size, seed);
+  GenerateArrayWith(generator, array, array_size, seed, 1);
   struct MinMax min_max = GetMinMax(array, 0, array_size);
   free(array);
 
@@ -1,10 +1,105 @@
 #include "utils.h"
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
 void GenerateArray(int *array, unsigned int array_size, unsigned int seed) {
   srand(seed);
   for (int i = 0; i < array_size; i++) {
     array[i] = rand();
   }
 }
+
+// Финализатор SplitMix64: биективное перемешивание 64-битного счетчика
+static uint64_t Mix64(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+void GenerateArrayRange(int *array, unsigned int begin, unsigned int end,
+                        unsigned int seed) {
+  const uint64_t gamma = 0x9E3779B97F4A7C15ULL;
+  uint64_t base = Mix64(seed);
+  for (unsigned int i = begin; i < end; i++) {
+    uint64_t z = Mix64(base + (i + 1ULL) * gamma);
+    array[i] = (int)((z >> 32) % ((uint64_t)RAND_MAX + 1));
+  }
+}
+
+struct GenerateArgs {
+  int *array;
+  unsigned int begin;
+  unsigned int end;
+  unsigned int seed;
+};
+
+static void *ThreadGenerate(void *arg) {
+  struct GenerateArgs *args = (struct GenerateArgs *)arg;
+  GenerateArrayRange(args->array, args->begin, args->end, args->seed);
+  return NULL;
+}
+
+void GenerateArrayWith(enum Generator generator, int *array,
+                       unsigned int array_size, unsigned int seed,
+                       int workers) {
+  if (generator == GENERATOR_RAND) {
+    GenerateArray(array, array_size, seed);
+    return;
+  }
+  // Потоков больше, чем процессоров, генерация не ускоряет: workers
+  // ограничивается их числом, результат от этого не меняется
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (cpus > 0 && workers > cpus) workers = (int)cpus;
+  if (workers < 1) workers = 1;
+
+  pthread_t *threads = malloc(sizeof(pthread_t) * workers);
+  struct GenerateArgs *args = malloc(sizeof(struct GenerateArgs) * workers);
+  bool *started = malloc(sizeof(bool) * workers);
+  if (threads == NULL || args == NULL || started == NULL) {
+    free(threads);
+    free(args);
+    free(started);
+    GenerateArrayRange(array, 0, array_size, seed);
+    return;
+  }
+
+  unsigned int chunk_size = array_size / workers;
+  for (int i = 0; i < workers; i++) {
+    args[i].array = array;
+    args[i].begin = i * chunk_size;
+    args[i].end = (i == workers - 1) ? array_size : (i + 1) * chunk_size;
+    args[i].seed = seed;
+    // Первую часть заполняет вызывающий поток
+    started[i] = i > 0 &&
+                 pthread_create(&threads[i], NULL, ThreadGenerate, &args[i]) == 0;
+  }
+
+  // Части, для которых не удалось создать поток, тоже заполняются здесь
+  for (int i = 0; i < workers; i++) {
+    if (!started[i]) ThreadGenerate(&args[i]);
+  }
+  for (int i = 1; i < workers; i++) {
+    if (started[i]) pthread_join(threads[i], NULL);
+  }
+
+  free(threads);
+  free(args);
+  free(started);
+}
+
+bool ParseGenerator(const char *name, enum Generator *generator) {
+  if (strcmp(name, "counter") == 0) {
+    *generator = GENERATOR_COUNTER;
+  } else if (strcmp(name, "rand") == 0) {
+    *generator = GENERATOR_RAND;
+  } else {
+    return false;
+  }
+  return true;
+}
@@ -1,11 +1,30 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <stdbool.h>
+
 struct MinMax {
   int min;
   int max;
 };
 
+// GENERATOR_COUNTER: элемент i зависит только от (seed, i), поэтому массив
+// можно заполнять частями параллельно и он не зависит от числа потоков.
+// GENERATOR_RAND: прежняя последовательность srand(seed) и rand()
+enum Generator { GENERATOR_COUNTER, GENERATOR_RAND };
+
 void GenerateArray(int *array, unsigned int array_size, unsigned int seed);
 
+// Элементы [begin, end) счетного генератора, значения в [0, RAND_MAX]
+void GenerateArrayRange(int *array, unsigned int begin, unsigned int end,
+                        unsigned int seed);
+
+// Массив выбранным генератором; счетный заполняется в workers потоках
+void GenerateArrayWith(enum Generator generator, int *array,
+                       unsigned int array_size, unsigned int seed,
+                       int workers);
+
+// "counter" или "rand"
+bool ParseGenerator(const char *name, enum Generator *generator);
+
 #endif
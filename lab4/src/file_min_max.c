@@ -0,0 +1,145 @@
+#define _DEFAULT_SOURCE
+#include "file_min_max.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "find_min_max.h"
+
+// Окно отображения и блок потокового чтения. Пока просматривается одно
+// окно, ядро по POSIX_FADV_WILLNEED уже читает следующее
+#define MAP_WINDOW (64u << 20)
+#define STREAM_BLOCK (16u << 20)
+
+static void MergeMinMax(struct MinMax *total, struct MinMax part) {
+  if (part.min < total->min) total->min = part.min;
+  if (part.max > total->max) total->max = part.max;
+}
+
+bool OpenIntFile(const char *path, struct IntFile *file) {
+  file->fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+  if (file->fd < 0) {
+    perror(path);
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(file->fd, &st) != 0) {
+    perror("fstat");
+    CloseIntFile(file);
+    return false;
+  }
+  file->seekable = S_ISREG(st.st_mode);
+  file->count = file->seekable ? (uint64_t)st.st_size / sizeof(int) : 0;
+  if (file->seekable && st.st_size % sizeof(int) != 0) {
+    printf("Input size %lld is not a multiple of %zu bytes\n",
+           (long long)st.st_size, sizeof(int));
+    CloseIntFile(file);
+    return false;
+  }
+  if (file->seekable && file->count == 0) {
+    printf("Input is empty\n");
+    CloseIntFile(file);
+    return false;
+  }
+  return true;
+}
+
+void CloseIntFile(struct IntFile *file) {
+  if (file->fd > STDIN_FILENO) close(file->fd);
+  file->fd = -1;
+}
+
+bool FileMinMax(const struct IntFile *file, uint64_t begin, uint64_t end,
+                const int *cancel, struct MinMax *min_max) {
+  min_max->min = INT_MAX;
+  min_max->max = INT_MIN;
+
+  uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+  uint64_t offset = begin * sizeof(int);
+  uint64_t end_offset = end * sizeof(int);
+  posix_fadvise(file->fd, offset, end_offset - offset, POSIX_FADV_SEQUENTIAL);
+
+  while (offset < end_offset) {
+    if (cancel != NULL && __atomic_load_n(cancel, __ATOMIC_RELAXED)) {
+      return false;
+    }
+
+    // Смещение mmap кратно странице; окно кратно странице, поэтому
+    // граница окна не режет число
+    uint64_t map_start = offset & ~(page - 1);
+    uint64_t map_end = map_start + MAP_WINDOW;
+    if (map_end > end_offset) map_end = end_offset;
+    size_t length = map_end - map_start;
+
+    char *map = mmap(NULL, length, PROT_READ, MAP_SHARED, file->fd,
+                     (off_t)map_start);
+    if (map == MAP_FAILED) {
+      perror("mmap");
+      return false;
+    }
+    madvise(map, length, MADV_SEQUENTIAL);
+    if (map_end < end_offset) {
+      posix_fadvise(file->fd, map_end, MAP_WINDOW, POSIX_FADV_WILLNEED);
+    }
+
+    int *numbers = (int *)(map + (offset - map_start));
+    MergeMinMax(min_max,
+                GetMinMax(numbers, 0, (map_end - offset) / sizeof(int)));
+    munmap(map, length);
+    offset = map_end;
+  }
+  return true;
+}
+
+bool StreamMinMax(const struct IntFile *file, struct MinMax *min_max) {
+  min_max->min = INT_MAX;
+  min_max->max = INT_MIN;
+
+  int *buffer = malloc(STREAM_BLOCK);
+  if (buffer == NULL) {
+    perror("malloc");
+    return false;
+  }
+
+  // Хвост неполного числа переносится в начало буфера
+  size_t filled = 0;
+  uint64_t total = 0;
+  while (true) {
+    ssize_t got = read(file->fd, (char *)buffer + filled, STREAM_BLOCK - filled);
+    if (got < 0) {
+      if (errno == EINTR) continue;
+      perror("read");
+      free(buffer);
+      return false;
+    }
+    if (got == 0) break;
+    filled += got;
+
+    size_t count = filled / sizeof(int);
+    total += count;
+    MergeMinMax(min_max, GetMinMax(buffer, 0, count));
+    size_t rest = filled - count * sizeof(int);
+    memmove(buffer, (char *)buffer + count * sizeof(int), rest);
+    filled = rest;
+  }
+  free(buffer);
+
+  if (filled != 0) {
+    printf("Input size is not a multiple of %zu bytes\n", sizeof(int));
+    return false;
+  }
+  if (total == 0) {
+    printf("Input is empty\n");
+    return false;
+  }
+  return true;
+}
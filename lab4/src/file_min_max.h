@@ -0,0 +1,31 @@
+#ifndef FILE_MIN_MAX_H
+#define FILE_MIN_MAX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "utils.h"
+
+// Двоичный файл из int32 в порядке байтов машины. Обычный файл читается
+// окнами mmap и делится между обработчиками по смещению; канал (stdin из
+// pipe) можно только прочитать потоком целиком.
+struct IntFile {
+  int fd;
+  uint64_t count;  // чисел в обычном файле
+  bool seekable;
+};
+
+// path "-" означает stdin
+bool OpenIntFile(const char *path, struct IntFile *file);
+void CloseIntFile(struct IntFile *file);
+
+// Минимум и максимум чисел [begin, end) обычного файла. Файл отображается
+// окнами, так что в памяти никогда нет всего файла. Если cancel не NULL,
+// между окнами проверяется флаг отмены. false - отмена или ошибка
+bool FileMinMax(const struct IntFile *file, uint64_t begin, uint64_t end,
+                const int *cancel, struct MinMax *min_max);
+
+// Минимум и максимум всего входа чтением большими блоками
+bool StreamMinMax(const struct IntFile *file, struct MinMax *min_max);
+
+#endif
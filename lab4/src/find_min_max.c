@@ -1,15 +1,224 @@
 #include "find_min_max.h"
 
 #include <limits.h>
+#include <stdint.h>
 
-struct MinMax GetMinMax(int *array, unsigned int begin, unsigned int end) {
+#if defined(__x86_64__) && defined(__GNUC__)
+#define MINMAX_X86 1
+#include <immintrin.h>
+#else
+#define MINMAX_X86 0
+#endif
+
+// Независимых аккумуляторов на min и на max: скрывают задержку pminsd/pmaxsd
+// и дают процессору загружать несколько векторов за такт
+#define MINMAX_ACCUMULATORS 4
+
+typedef struct MinMax (*MinMaxKernel)(const int *, const int *);
+
+static struct MinMax ScalarRange(const int *from, const int *to,
+                                 struct MinMax min_max) {
+  for (const int *p = from; p < to; p++) {
+    if (*p < min_max.min) min_max.min = *p;
+    if (*p > min_max.max) min_max.max = *p;
+  }
+  return min_max;
+}
+
+static struct MinMax MinMaxScalar(const int *from, const int *to) {
   struct MinMax min_max;
   min_max.min = INT_MAX;
   min_max.max = INT_MIN;
+  return ScalarRange(from, to, min_max);
+}
+
+// Начало векторной части: первый адрес, выровненный на align байт
+static const int *AlignUp(const int *from, const int *to, uintptr_t align) {
+  uintptr_t addr = ((uintptr_t)from + align - 1) & ~(align - 1);
+  return (const int *)addr < to ? (const int *)addr : to;
+}
+
+#if MINMAX_X86
+
+__attribute__((target("sse4.1"))) static struct MinMax MinMaxSse41(
+    const int *from, const int *to) {
+  const int width = 4;
+  const int *head = AlignUp(from, to, 16);
+  struct MinMax min_max = MinMaxScalar(from, head);
+  const int *p = head;
+
+  __m128i mins[MINMAX_ACCUMULATORS], maxs[MINMAX_ACCUMULATORS];
+  for (int k = 0; k < MINMAX_ACCUMULATORS; k++) {
+    mins[k] = _mm_set1_epi32(INT_MAX);
+    maxs[k] = _mm_set1_epi32(INT_MIN);
+  }
+  for (; to - p >= width * MINMAX_ACCUMULATORS;
+       p += width * MINMAX_ACCUMULATORS) {
+    for (int k = 0; k < MINMAX_ACCUMULATORS; k++) {
+      __m128i v = _mm_load_si128((const __m128i *)(p + k * width));
+      mins[k] = _mm_min_epi32(mins[k], v);
+      maxs[k] = _mm_max_epi32(maxs[k], v);
+    }
+  }
+  for (int k = 1; k < MINMAX_ACCUMULATORS; k++) {
+    mins[0] = _mm_min_epi32(mins[0], mins[k]);
+    maxs[0] = _mm_max_epi32(maxs[0], maxs[k]);
+  }
+
+  int lanes_min[4], lanes_max[4];
+  _mm_storeu_si128((__m128i *)lanes_min, mins[0]);
+  _mm_storeu_si128((__m128i *)lanes_max, maxs[0]);
+  for (int j = 0; j < width; j++) {
+    if (lanes_min[j] < min_max.min) min_max.min = lanes_min[j];
+    if (lanes_max[j] > min_max.max) min_max.max = lanes_max[j];
+  }
+  return ScalarRange(p, to, min_max);
+}
+
+__attribute__((target("avx2"))) static struct MinMax MinMaxAvx2(
+    const int *from, const int *to) {
+  const int width = 8;
+  const int *head = AlignUp(from, to, 32);
+  struct MinMax min_max = MinMaxScalar(from, head);
+  const int *p = head;
+
+  __m256i mins[MINMAX_ACCUMULATORS], maxs[MINMAX_ACCUMULATORS];
+  for (int k = 0; k < MINMAX_ACCUMULATORS; k++) {
+    mins[k] = _mm256_set1_epi32(INT_MAX);
+    maxs[k] = _mm256_set1_epi32(INT_MIN);
+  }
+  for (; to - p >= width * MINMAX_ACCUMULATORS;
+       p += width * MINMAX_ACCUMULATORS) {
+    for (int k = 0; k < MINMAX_ACCUMULATORS; k++) {
+      __m256i v = _mm256_load_si256((const __m256i *)(p + k * width));
+      mins[k] = _mm256_min_epi32(mins[k], v);
+      maxs[k] = _mm256_max_epi32(maxs[k], v);
+    }
+  }
+  for (int k = 1; k < MINMAX_ACCUMULATORS; k++) {
+    mins[0] = _mm256_min_epi32(mins[0], mins[k]);
+    maxs[0] = _mm256_max_epi32(maxs[0], maxs[k]);
+  }
+
+  int lanes_min[8], lanes_max[8];
+  _mm256_storeu_si256((__m256i *)lanes_min, mins[0]);
+  _mm256_storeu_si256((__m256i *)lanes_max, maxs[0]);
+  for (int j = 0; j < width; j++) {
+    if (lanes_min[j] < min_max.min) min_max.min = lanes_min[j];
+    if (lanes_max[j] > min_max.max) min_max.max = lanes_max[j];
+  }
+  return ScalarRange(p, to, min_max);
+}
+
+// Невыровненные начало и хвост читаются маскированной загрузкой, скалярной
+// части нет; _mm512_reduce_* сводят аккумуляторы
+__attribute__((target("avx512f"))) static struct MinMax MinMaxAvx512(
+    const int *from, const int *to) {
+  const int width = 16;
+  const __m512i init_min = _mm512_set1_epi32(INT_MAX);
+  const __m512i init_max = _mm512_set1_epi32(INT_MIN);
+  __m512i mins[MINMAX_ACCUMULATORS], maxs[MINMAX_ACCUMULATORS];
+  for (int k = 0; k < MINMAX_ACCUMULATORS; k++) {
+    mins[k] = init_min;
+    maxs[k] = init_max;
+  }
 
-  for (int i = begin; i < end; i++) {
-    if (array[i] < min_max.min) min_max.min = array[i];
-    if (array[i] > min_max.max) min_max.max = array[i];
+  const int *p = AlignUp(from, to, 64);
+  if (p > from) {
+    __mmask16 mask = (__mmask16)((1u << (p - from)) - 1);
+    mins[0] = _mm512_mask_loadu_epi32(init_min, mask, from);
+    maxs[0] = _mm512_mask_loadu_epi32(init_max, mask, from);
+  }
+  for (; to - p >= width * MINMAX_ACCUMULATORS;
+       p += width * MINMAX_ACCUMULATORS) {
+    for (int k = 0; k < MINMAX_ACCUMULATORS; k++) {
+      __m512i v = _mm512_load_si512((const void *)(p + k * width));
+      mins[k] = _mm512_min_epi32(mins[k], v);
+      maxs[k] = _mm512_max_epi32(maxs[k], v);
+    }
+  }
+  for (; to - p >= width; p += width) {
+    __m512i v = _mm512_load_si512((const void *)p);
+    mins[0] = _mm512_min_epi32(mins[0], v);
+    maxs[0] = _mm512_max_epi32(maxs[0], v);
+  }
+  if (p < to) {
+    __mmask16 mask = (__mmask16)((1u << (to - p)) - 1);
+    mins[1] = _mm512_min_epi32(mins[1],
+                               _mm512_mask_loadu_epi32(init_min, mask, p));
+    maxs[1] = _mm512_max_epi32(maxs[1],
+                               _mm512_mask_loadu_epi32(init_max, mask, p));
+  }
+  for (int k = 1; k < MINMAX_ACCUMULATORS; k++) {
+    mins[0] = _mm512_min_epi32(mins[0], mins[k]);
+    maxs[0] = _mm512_max_epi32(maxs[0], maxs[k]);
   }
+
+  struct MinMax min_max;
+  min_max.min = _mm512_reduce_min_epi32(mins[0]);
+  min_max.max = _mm512_reduce_max_epi32(maxs[0]);
   return min_max;
 }
+
+#endif
+
+static const char *kIsaNames[MINMAX_ISA_COUNT] = {"scalar", "sse4.1", "avx2",
+                                                  "avx512"};
+
+static MinMaxKernel kernels[MINMAX_ISA_COUNT] = {
+    MinMaxScalar,
+#if MINMAX_X86
+    MinMaxSse41,
+    MinMaxAvx2,
+    MinMaxAvx512,
+#endif
+};
+
+static enum MinMaxIsa selected_isa = MINMAX_SCALAR;
+
+bool MinMaxIsaSupported(enum MinMaxIsa isa) {
+#if MINMAX_X86
+  __builtin_cpu_init();
+  switch (isa) {
+    case MINMAX_SCALAR:
+      return true;
+    case MINMAX_SSE41:
+      return __builtin_cpu_supports("sse4.1");
+    case MINMAX_AVX2:
+      return __builtin_cpu_supports("avx2");
+    case MINMAX_AVX512:
+      return __builtin_cpu_supports("avx512f");
+    default:
+      return false;
+  }
+#else
+  return isa == MINMAX_SCALAR;
+#endif
+}
+
+// Выбор реализации до main: дальше GetMinMax только вызывает указатель,
+// и дочерние процессы после fork наследуют готовый выбор
+__attribute__((constructor)) static void SelectMinMaxIsa(void) {
+  for (int isa = MINMAX_ISA_COUNT - 1; isa > MINMAX_SCALAR; isa--) {
+    if (MinMaxIsaSupported((enum MinMaxIsa)isa)) {
+      selected_isa = (enum MinMaxIsa)isa;
+      return;
+    }
+  }
+}
+
+enum MinMaxIsa MinMaxSelectedIsa(void) { return selected_isa; }
+
+const char *MinMaxIsaName(enum MinMaxIsa isa) {
+  return isa < MINMAX_ISA_COUNT ? kIsaNames[isa] : "unknown";
+}
+
+struct MinMax GetMinMaxIsa(enum MinMaxIsa isa, int *array, unsigned int begin,
+                           unsigned int end) {
+  if (end < begin) end = begin;
+  return kernels[isa](array + begin, array + end);
+}
+
+struct MinMax GetMinMax(int *array, unsigned int begin, unsigned int end) {
+  return GetMinMaxIsa(selected_isa, array, begin, end);
+}
@@ -1,7 +1,9 @@
 #define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
 #include <ctype.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,12 +11,15 @@
 #include <signal.h>
 #include <errno.h>
 
+#include <sys/mman.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
 #include <getopt.h>
+#include <pthread.h>
 
+#include "file_min_max.h"
 #include "find_min_max.h"
 #include "utils.h"
 
@@ -22,8 +27,43 @@
 static pid_t *child_pids = NULL;
 static int timeout_seconds = -1;  // -1 означает отсутствие таймаута
 
+// Способ передачи результатов от дочерних процессов родителю
+enum ResultTransport { TRANSPORT_PIPES, TRANSPORT_FILES, TRANSPORT_SHM };
+
+// Ячейка результата в общей памяти: своя кэш-линия на процесс, чтобы
+// записи соседей не делили линию. ready выставляется после записи min_max,
+// по нему родитель отличает результат от ячейки убитого по таймауту процесса
+struct ResultSlot {
+  struct MinMax min_max;
+  int ready;
+} __attribute__((aligned(64)));
+
+// Потоки проверяют флаг между блоками и бросают работу после таймаута
+#define CANCEL_BLOCK (1 << 20)
+static int cancel_requested = 0;
+
+enum Backend { BACKEND_FORK, BACKEND_THREADS };
+
+// Откуда берутся числа: массив из GenerateArray или файл --input
+struct Source {
+  int *array;
+  struct IntFile *file;  // NULL для массива
+  uint64_t count;
+};
+
+// Часть входа для потока; done выставляется, только если часть
+// просмотрена целиком до отмены
+struct ThreadTask {
+  const struct Source *source;
+  int index;
+  int pnum;
+  struct MinMax min_max;
+  bool done;
+};
+
 // Обработчик сигнала SIGALRM
 void timeout_handler(int sig) {
+    __atomic_store_n(&cancel_requested, 1, __ATOMIC_RELAXED);
     if (child_pids != NULL) {
         for (int i = 0; i < optind; i++) {
             if (child_pids[i] > 0) {
@@ -33,94 +73,114 @@ void timeout_handler(int sig) {
     }
 }
 
-int main(int argc, char **argv) {
-  int seed = -1;
-  int array_size = -1;
-  int pnum = -1;
-  bool with_files = false;
-  timeout_seconds = -1;  // Инициализация таймаута
-
-  while (true) {
-    int current_optind = optind ? optind : 1;
+// Минимум и максимум части index из pnum. Файл читается только в
+// пределах своей части, по смещению. Если cancel не NULL, флаг отмены
+// проверяется между блоками. false - отмена или ошибка чтения
+static bool PartMinMax(const struct Source *source, int index, int pnum,
+                       const int *cancel, struct MinMax *min_max) {
+  uint64_t chunk_size = source->count / pnum;
+  uint64_t begin = index * chunk_size;
+  uint64_t end = (index == pnum - 1) ? source->count : (index + 1) * chunk_size;
+
+  if (source->file != NULL) {
+    return FileMinMax(source->file, begin, end, cancel, min_max);
+  }
+  if (cancel == NULL) {
+    *min_max = GetMinMax(source->array, begin, end);
+    return true;
+  }
 
-    static struct option options[] = {
-        {"seed", required_argument, 0, 0},
-        {"array_size", required_argument, 0, 0},
-        {"pnum", required_argument, 0, 0},
-        {"by_files", no_argument, 0, 'f'},
-        {"timeout", required_argument, 0, 0},  // Добавлена опция timeout
-        {0, 0, 0, 0}
-    };
+  min_max->min = INT_MAX;
+  min_max->max = INT_MIN;
+  for (uint64_t from = begin; from < end; from += CANCEL_BLOCK) {
+    if (__atomic_load_n(cancel, __ATOMIC_RELAXED)) {
+      return false;
+    }
+    uint64_t to = end - from > CANCEL_BLOCK ? from + CANCEL_BLOCK : end;
+    struct MinMax part = GetMinMax(source->array, from, to);
+    if (part.min < min_max->min) min_max->min = part.min;
+    if (part.max > min_max->max) min_max->max = part.max;
+  }
+  return true;
+}
 
-    int option_index = 0;
-    int c = getopt_long(argc, argv, "f", options, &option_index);
+static void *ThreadMinMax(void *arg) {
+  struct ThreadTask *task = (struct ThreadTask *)arg;
+  task->done = PartMinMax(task->source, task->index, task->pnum,
+                          &cancel_requested, &task->min_max);
+  return NULL;
+}
 
-    if (c == -1) break;
+// Те же части массива, что и у процессов, но в pnum потоках над общим
+// массивом: без копирования таблиц страниц и copy-on-write. Таймаут
+// отменяет потоки кооперативно. Возвращает число потоков, досчитавших
+// свою часть, или -1 при ошибке
+static int RunThreads(const struct Source *source, int pnum,
+                      struct MinMax *min_max) {
+  pthread_t *threads = malloc(sizeof(pthread_t) * pnum);
+  struct ThreadTask *tasks = calloc(pnum, sizeof(struct ThreadTask));
+  if (threads == NULL || tasks == NULL) {
+    perror("malloc");
+    free(threads);
+    free(tasks);
+    return -1;
+  }
 
-    switch (c) {
-      case 0:
-        switch (option_index) {
-          case 0:  // seed
-            seed = atoi(optarg);
-            if (seed <= 0) {
-              printf("Seed must be positive\n");
-              return 1;
-            }
-            break;
-          case 1:  // array_size
-            array_size = atoi(optarg);
-            if (array_size <= 0) {
-              printf("Array size must be positive\n");
-              return 1;
-            }
-            break;
-          case 2:  // pnum
-            pnum = atoi(optarg);
-            if (pnum <= 0) {
-              printf("pnum must be positive\n");
-              return 1;
-            }
-            break;
-          case 3:  // by_files
-            with_files = true;
-            break;
-          case 4:  // timeout
-            timeout_seconds = atoi(optarg);
-            if (timeout_seconds < 0) {
-              printf("Timeout must be non-negative\n");
-              return 1;
-            }
-            break;
-          default:
-            printf("Index %d is out of options\n", option_index);
-        }
-        break;
-      case 'f':
-        with_files = true;
-        break;
-      case '?':
-        break;
-      default:
-        printf("getopt returned character code 0%o?\n", c);
+  int created = 0;
+  for (int i = 0; i < pnum; i++) {
+    tasks[i].source = source;
+    tasks[i].index = i;
+    tasks[i].pnum = pnum;
+    if (pthread_create(&threads[i], NULL, ThreadMinMax, &tasks[i]) != 0) {
+      printf("Thread creation failed!\n");
+      __atomic_store_n(&cancel_requested, 1, __ATOMIC_RELAXED);
+      break;
     }
+    created++;
   }
 
-  if (optind < argc) {
-    printf("Has at least one no option argument\n");
-    return 1;
+  // Устанавливаем таймаут, если задан
+  if (timeout_seconds >= 0 && created == pnum) {
+    alarm(timeout_seconds);
   }
 
-  if (seed == -1 || array_size == -1 || pnum == -1) {
-    printf("Usage: %s --seed \"num\" --array_size \"num\" --pnum \"num\" [--timeout \"seconds\"]\n",
-           argv[0]);
-    return 1;
+  for (int i = 0; i < created; i++) {
+    pthread_join(threads[i], NULL);
   }
 
+  // Отменяем таймер, если он еще не сработал
+  if (timeout_seconds >= 0) {
+    alarm(0);
+  }
+
+  min_max->min = INT_MAX;
+  min_max->max = INT_MIN;
+  int completed = 0;
+  for (int i = 0; i < created; i++) {
+    if (!tasks[i].done) continue;
+    completed++;
+    if (tasks[i].min_max.min < min_max->min) min_max->min = tasks[i].min_max.min;
+    if (tasks[i].min_max.max > min_max->max) min_max->max = tasks[i].min_max.max;
+  }
+  if (completed < pnum && created == pnum) {
+    printf("Timeout reached! Worker threads were cancelled.\n");
+  }
+
+  free(threads);
+  free(tasks);
+  return created == pnum ? completed : -1;
+}
+
+// Запуск pnum дочерних процессов; результаты приходят через transport.
+// Возвращает число процессов, завершившихся до таймаута, или -1 при ошибке
+static int RunProcesses(const struct Source *source, int pnum,
+                        enum ResultTransport transport,
+                        struct MinMax *min_max) {
   // Выделяем память для хранения PID дочерних процессов
   child_pids = malloc(sizeof(pid_t) * pnum);
   if (child_pids == NULL) {
     perror("malloc");
-    return 1;
+    return -1;
   }
 
   // Инициализируем массив PID
@@ -128,44 +188,28 @@ int main(int argc, char **argv) {
     child_pids[i] = 0;
   }
 
-  int *array = malloc(sizeof(int) * array_size);
-  if (array == NULL) {
-    perror("malloc");
-    free(child_pids);
-    return 1;
-  }
-  
-  GenerateArray(array, array_size, seed);
   int active_child_processes = 0;
 
-  struct timeval start_time;
-  gettimeofday(&start_time, NULL);
-
   // массив каналов для общения с процессами
   int pipefd[pnum][2];
-  if (!with_files) {
+  if (transport == TRANSPORT_PIPES) {
     for (int i = 0; i < pnum; i++) {
       if (pipe(pipefd[i]) == -1) {
         perror("pipe");
-        free(array);
-        free(child_pids);
-        return 1;
+        return -1;
       }
     }
   }
 
-  // Регистрируем обработчик сигнала SIGALRM, если задан таймаут
-  if (timeout_seconds >= 0) {
-    struct sigaction sa;
-    sa.sa_handler = timeout_handler;
-    sigemptyset(&sa.sa_mask);
-    sa.sa_flags = 0;
-    
-    if (sigaction(SIGALRM, &sa, NULL) == -1) {
-      perror("sigaction");
-      free(array);
-      free(child_pids);
-      return 1;
+  // Общий массив результатов создается до fork, и дочерние процессы
+  // наследуют то же отображение
+  struct ResultSlot *slots = NULL;
+  if (transport == TRANSPORT_SHM) {
+    slots = mmap(NULL, sizeof(struct ResultSlot) * pnum,
+                 PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (slots == MAP_FAILED) {
+      perror("mmap");
+      return -1;
     }
   }
 
@@ -182,20 +226,25 @@ int main(int argc, char **argv) {
           signal(SIGALRM, SIG_IGN);
         }
         
-        int chunk_size = array_size / pnum;
-        int start = i * chunk_size;
-        int end = (i == pnum - 1) ? array_size : (i + 1) * chunk_size;
-
-        struct MinMax local_minmax = GetMinMax(array, start, end);
+        // Без результата родитель не учтет эту часть, как при таймауте
+        struct MinMax local_minmax;
+        if (!PartMinMax(source, i, pnum, NULL, &local_minmax)) {
+          exit(1);
+        }
 
-        if (with_files) {
+        if (transport == TRANSPORT_SHM) {
+          // mmap заполняет память нулями, ready == 0 до записи результата
+          slots[i].min_max = local_minmax;
+          __atomic_store_n(&slots[i].ready, 1, __ATOMIC_RELEASE);
+        } else if (transport == TRANSPORT_FILES) {
           // use files here
+          // PID родителя в имени разводит одновременные запуски в одном каталоге
           char filename[256];
-          sprintf(filename, "temp_%d.txt", i);
+          sprintf(filename, "temp_%d_%d.txt", (int)getppid(), i);
           FILE *f = fopen(filename, "w");
           if (f == NULL) {
             perror("fopen");
-            return 1;
+            exit(1);
           }
           fprintf(f, "%d %d\n", local_minmax.min, local_minmax.max);
           fclose(f);
@@ -206,16 +255,14 @@ int main(int argc, char **argv) {
           write(pipefd[i][1], &local_minmax.max, sizeof(int));
           close(pipefd[i][1]);
         }
-        return 0;
+        exit(0);
       } else {
         // родительский процесс сохраняет PID дочернего
         child_pids[i] = child_pid;
       }
     } else {
       printf("Fork failed!\n");
-      free(array);
-      free(child_pids);
-      return 1;
+      return -1;
     }
   }
 
@@ -274,19 +321,24 @@ int main(int argc, char **argv) {
 
   active_child_processes = 0;  // Все процессы завершены
 
-  struct MinMax min_max;
-  min_max.min = INT_MAX;
-  min_max.max = INT_MIN;
+  min_max->min = INT_MAX;
+  min_max->max = INT_MIN;
 
   // Чтение результатов только от завершенных процессов
   for (int i = 0; i < pnum; i++) {
     int min = INT_MAX;
     int max = INT_MIN;
 
-    if (with_files) {
+    if (transport == TRANSPORT_SHM) {
+      // Процесс, убитый по таймауту, не успел выставить ready
+      if (__atomic_load_n(&slots[i].ready, __ATOMIC_ACQUIRE)) {
+        min = slots[i].min_max.min;
+        max = slots[i].min_max.max;
+      }
+    } else if (transport == TRANSPORT_FILES) {
       // read from files
       char filename[256];
-      sprintf(filename, "temp_%d.txt", i);
+      sprintf(filename, "temp_%d_%d.txt", (int)getpid(), i);
       FILE *f = fopen(filename, "r");
       if (f != NULL) {
         fscanf(f, "%d %d", &min, &max);
@@ -306,8 +358,189 @@ int main(int argc, char **argv) {
       close(pipefd[i][0]);
     }
 
-    if (min < min_max.min) min_max.min = min;
-    if (max > min_max.max) min_max.max = max;
+    if (min < min_max->min) min_max->min = min;
+    if (max > min_max->max) min_max->max = max;
+  }
+
+  if (slots != NULL) {
+    munmap(slots, sizeof(struct ResultSlot) * pnum);
+  }
+  return completed_processes;
+}
+
+int main(int argc, char **argv) {
+  int seed = -1;
+  int array_size = -1;
+  int pnum = -1;
+  const char *input_path = NULL;
+  enum Generator generator = GENERATOR_COUNTER;
+  enum ResultTransport transport = TRANSPORT_PIPES;
+  enum Backend backend = BACKEND_FORK;
+  timeout_seconds = -1;  // Инициализация таймаута
+
+  while (true) {
+    int current_optind = optind ? optind : 1;
+
+    static struct option options[] = {
+        {"seed", required_argument, 0, 0},
+        {"array_size", required_argument, 0, 0},
+        {"pnum", required_argument, 0, 0},
+        {"by_files", no_argument, 0, 'f'},
+        {"timeout", required_argument, 0, 0},  // Добавлена опция timeout
+        {"by_shm", no_argument, 0, 's'},
+        {"backend", required_argument, 0, 0},
+        {"input", required_argument, 0, 0},
+        {"generator", required_argument, 0, 0},
+        {0, 0, 0, 0}
+    };
+
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "fs", options, &option_index);
+
+    if (c == -1) break;
+
+    switch (c) {
+      case 0:
+        switch (option_index) {
+          case 0:  // seed
+            seed = atoi(optarg);
+            if (seed <= 0) {
+              printf("Seed must be positive\n");
+              return 1;
+            }
+            break;
+          case 1:  // array_size
+            array_size = atoi(optarg);
+            if (array_size <= 0) {
+              printf("Array size must be positive\n");
+              return 1;
+            }
+            break;
+          case 2:  // pnum
+            pnum = atoi(optarg);
+            if (pnum <= 0) {
+              printf("pnum must be positive\n");
+              return 1;
+            }
+            break;
+          case 3:  // by_files
+            transport = TRANSPORT_FILES;
+            break;
+          case 4:  // timeout
+            timeout_seconds = atoi(optarg);
+            if (timeout_seconds < 0) {
+              printf("Timeout must be non-negative\n");
+              return 1;
+            }
+            break;
+          case 6:  // backend
+            if (strcmp(optarg, "fork") == 0) {
+              backend = BACKEND_FORK;
+            } else if (strcmp(optarg, "threads") == 0) {
+              backend = BACKEND_THREADS;
+            } else {
+              printf("Backend must be fork or threads\n");
+              return 1;
+            }
+            break;
+          case 7:  // input
+            input_path = optarg;
+            break;
+          case 8:  // generator
+            if (!ParseGenerator(optarg, &generator)) {
+              printf("Generator must be counter or rand\n");
+              return 1;
+            }
+            break;
+          default:
+            printf("Index %d is out of options\n", option_index);
+        }
+        break;
+      case 'f':
+        transport = TRANSPORT_FILES;
+        break;
+      case 's':
+        transport = TRANSPORT_SHM;
+        break;
+      case '?':
+        break;
+      default:
+        printf("getopt returned character code 0%o?\n", c);
+    }
+  }
+
+  if (optind < argc) {
+    printf("Has at least one no option argument\n");
+    return 1;
+  }
+
+  if (pnum == -1 ||
+      (input_path == NULL && (seed == -1 || array_size == -1))) {
+    printf("Usage: %s --seed \"num\" --array_size \"num\" --pnum \"num\" [--timeout \"seconds\"] [--by_files | --by_shm] [--backend fork|threads] [--generator counter|rand]\n",
+           argv[0]);
+    printf("       %s --input \"file\"|- --pnum \"num\" [...]  (int32 numbers)\n",
+           argv[0]);
+    return 1;
+  }
+
+  // Файл не загружается: обработчики отображают только свои части
+  struct IntFile file;
+  struct Source source = {NULL, NULL, 0};
+  int *array = NULL;
+  if (input_path != NULL) {
+    if (!OpenIntFile(input_path, &file)) {
+      return 1;
+    }
+    source.file = &file;
+    source.count = file.count;
+  } else {
+    array = malloc(sizeof(int) * array_size);
+    if (array == NULL) {
+      perror("malloc");
+      return 1;
+    }
+
+    // Счетный генератор заполняет массив в pnum потоках
+    GenerateArrayWith(generator, array, array_size, seed, pnum);
+    source.array = array;
+    source.count = array_size;
+  }
+
+  struct timeval start_time;
+  gettimeofday(&start_time, NULL);
+
+  // Регистрируем обработчик сигнала SIGALRM, если задан таймаут
+  if (timeout_seconds >= 0) {
+    struct sigaction sa;
+    sa.sa_handler = timeout_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    
+    if (sigaction(SIGALRM, &sa, NULL) == -1) {
+      perror("sigaction");
+      free(array);
+      return 1;
+    }
+  }
+
+  struct MinMax min_max;
+  int completed_processes;
+  if (source.file != NULL && !source.file->seekable) {
+    // Канал не делится по смещению: читается потоком в этом процессе
+    completed_processes = StreamMinMax(source.file, &min_max) ? pnum : -1;
+  } else if (backend == BACKEND_THREADS) {
+    completed_processes = RunThreads(&source, pnum, &min_max);
+  } else {
+    completed_processes = RunProcesses(&source, pnum, transport, &min_max);
+    free(child_pids);
+    child_pids = NULL;
+  }
+  if (source.file != NULL) {
+    CloseIntFile(source.file);
+  }
+  if (completed_processes < 0) {
+    free(array);
+    return 1;
   }
 
   struct timeval finish_time;
@@ -317,14 +550,17 @@ int main(int argc, char **argv) {
   elapsed_time += (finish_time.tv_usec - start_time.tv_usec) / 1000.0;
 
   free(array);
-  free(child_pids);
 
   printf("Min: %d\n", min_max.min);
   printf("Max: %d\n", min_max.max);
   printf("Elapsed time: %fms\n", elapsed_time);
   
   if (timeout_seconds >= 0 && completed_processes < pnum) {
-    printf("Warning: Some child processes were terminated due to timeout.\n");
+    if (backend == BACKEND_THREADS) {
+      printf("Warning: Some worker threads were cancelled due to timeout.\n");
+    } else {
+      printf("Warning: Some child processes were terminated due to timeout.\n");
+    }
   }
   
   fflush(NULL);
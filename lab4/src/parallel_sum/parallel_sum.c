@@ -42,11 +42,13 @@ int main(int argc, char **argv) {
     uint32_t threads_num = 0;
     uint32_t array_size = 0;
     uint32_t seed = 0;
+    enum Generator generator = GENERATOR_COUNTER;
     
     static struct option options[] = {
         {"threads_num", required_argument, 0, 't'},
         {"array_size", required_argument, 0, 'a'},
         {"seed", required_argument, 0, 's'},
+        {"generator", required_argument, 0, 'g'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
@@ -54,7 +56,7 @@ int main(int argc, char **argv) {
     int option_index = 0;
     int c;
     
-    while ((c = getopt_long(argc, argv, "t:a:s:h", options, &option_index)) != -1) {
+    while ((c = getopt_long(argc, argv, "t:a:s:g:h", options, &option_index)) != -1) {
         switch (c) {
             case 't':
                 threads_num = atoi(optarg);
@@ -73,8 +75,14 @@ int main(int argc, char **argv) {
             case 's':
                 seed = atoi(optarg);
                 break;
+            case 'g':
+                if (!ParseGenerator(optarg, &generator)) {
+                    printf("Generator must be counter or rand\n");
+                    return 1;
+                }
+                break;
             case 'h':
-                printf("Usage: %s --threads_num <num> --array_size <num> --seed <num>\n", argv[0]);
+                printf("Usage: %s --threads_num <num> --array_size <num> --seed <num> [--generator counter|rand]\n", argv[0]);
                 printf("Example: %s --threads_num 4 --array_size 1000000 --seed 42\n", argv[0]);
                 return 0;
             default:
@@ -100,7 +108,8 @@ int main(int argc, char **argv) {
         return 1;
     }
     
-    GenerateArray(array, array_size, seed);
+    // Счетный генератор заполняет массив теми же потоками, что и суммируют
+    GenerateArrayWith(generator, array, array_size, seed, threads_num);
     
     int sequential_sum = 0;
     for (uint32_t i = 0; i < array_size; i++) {
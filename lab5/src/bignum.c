@@ -0,0 +1,650 @@
+#include "bignum.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Пороги в разрядах по 2^32: ниже них более простой алгоритм быстрее
+#define KARATSUBA_THRESHOLD 32
+#define TOOM3_THRESHOLD 160
+#define RECIPROCAL_THRESHOLD 16
+#define DECIMAL_THRESHOLD 64
+
+// Числа не длиннее этого перемножаются в листе дерева без рекурсии
+#define PRODUCT_LEAF 16
+
+#define DECIMAL_BASE 1000000000u
+#define DECIMAL_DIGITS 9
+
+// Знаковое число для промежуточных значений Тоома-3 и Ньютона
+typedef struct {
+    BigInt mag;
+    int neg;
+} SignedBig;
+
+static void mul(BigInt* r, const BigInt* a, const BigInt* b);
+
+static void reserve(BigInt* x, size_t capacity) {
+    if (x->capacity >= capacity) {
+        return;
+    }
+    uint32_t* grown = (uint32_t*)realloc(x->limbs, capacity * sizeof(uint32_t));
+    if (grown == NULL) {
+        fprintf(stderr, "Ошибка выделения памяти\n");
+        exit(1);
+    }
+    x->limbs = grown;
+    x->capacity = capacity;
+}
+
+static void normalize(BigInt* x) {
+    while (x->size > 0 && x->limbs[x->size - 1] == 0) {
+        x->size--;
+    }
+}
+
+void bigint_init(BigInt* x) {
+    x->limbs = NULL;
+    x->size = 0;
+    x->capacity = 0;
+}
+
+void bigint_free(BigInt* x) {
+    free(x->limbs);
+    bigint_init(x);
+}
+
+void bigint_set_u64(BigInt* x, uint64_t value) {
+    reserve(x, 2);
+    x->limbs[0] = (uint32_t)value;
+    x->limbs[1] = (uint32_t)(value >> 32);
+    x->size = 2;
+    normalize(x);
+}
+
+static void copy(BigInt* r, const BigInt* a) {
+    if (r == a) {
+        return;
+    }
+    reserve(r, a->size);
+    if (a->size > 0) {
+        memcpy(r->limbs, a->limbs, a->size * sizeof(uint32_t));
+    }
+    r->size = a->size;
+}
+
+// Разряды a с номерами [from, from + len), обрезанные по длине a
+static void slice(BigInt* r, const BigInt* a, size_t from, size_t len) {
+    if (from >= a->size) {
+        r->size = 0;
+        return;
+    }
+    if (from + len > a->size) {
+        len = a->size - from;
+    }
+    reserve(r, len);
+    memcpy(r->limbs, a->limbs + from, len * sizeof(uint32_t));
+    r->size = len;
+    normalize(r);
+}
+
+// r = a * B^shift
+static void shift_up(BigInt* r, const BigInt* a, size_t shift) {
+    if (a->size == 0) {
+        r->size = 0;
+        return;
+    }
+    reserve(r, a->size + shift);
+    memmove(r->limbs + shift, a->limbs, a->size * sizeof(uint32_t));
+    memset(r->limbs, 0, shift * sizeof(uint32_t));
+    r->size = a->size + shift;
+}
+
+static int compare(const BigInt* a, const BigInt* b) {
+    if (a->size != b->size) {
+        return a->size < b->size ? -1 : 1;
+    }
+    for (size_t i = a->size; i > 0; i--) {
+        if (a->limbs[i - 1] != b->limbs[i - 1]) {
+            return a->limbs[i - 1] < b->limbs[i - 1] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// r = a + b; r может совпадать с a или b
+static void add(BigInt* r, const BigInt* a, const BigInt* b) {
+    if (a->size < b->size) {
+        const BigInt* t = a;
+        a = b;
+        b = t;
+    }
+    size_t an = a->size;
+    size_t bn = b->size;
+    reserve(r, an + 1);
+    uint64_t carry = 0;
+    for (size_t i = 0; i < an; i++) {
+        carry += (uint64_t)a->limbs[i] + (i < bn ? b->limbs[i] : 0);
+        r->limbs[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    r->limbs[an] = (uint32_t)carry;
+    r->size = an + 1;
+    normalize(r);
+}
+
+// r = a - b при a >= b; r может совпадать с a или b
+static void sub(BigInt* r, const BigInt* a, const BigInt* b) {
+    size_t an = a->size;
+    size_t bn = b->size;
+    reserve(r, an);
+    int64_t borrow = 0;
+    for (size_t i = 0; i < an; i++) {
+        int64_t d = (int64_t)a->limbs[i] - (i < bn ? b->limbs[i] : 0) - borrow;
+        borrow = d < 0;
+        r->limbs[i] = (uint32_t)(d + (borrow << 32));
+    }
+    r->size = an;
+    normalize(r);
+}
+
+// r += a * B^shift
+static void add_shifted(BigInt* r, const BigInt* a, size_t shift) {
+    if (a->size == 0) {
+        return;
+    }
+    size_t n = (r->size > a->size + shift ? r->size : a->size + shift) + 1;
+    reserve(r, n);
+    memset(r->limbs + r->size, 0, (n - r->size) * sizeof(uint32_t));
+    uint64_t carry = 0;
+    size_t i = 0;
+    for (; i < a->size; i++) {
+        carry += (uint64_t)r->limbs[shift + i] + a->limbs[i];
+        r->limbs[shift + i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    for (i += shift; carry != 0; i++) {
+        carry += r->limbs[i];
+        r->limbs[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    r->size = n;
+    normalize(r);
+}
+
+static void add_small(BigInt* x, uint32_t value) {
+    BigInt t = {&value, 1, 1};
+    add(x, x, &t);
+}
+
+static void sub_small(BigInt* x, uint32_t value) {
+    BigInt t = {&value, 1, 1};
+    sub(x, x, &t);
+}
+
+// x /= d на месте, возвращает остаток
+static uint32_t div_small(BigInt* x, uint32_t d) {
+    uint64_t rem = 0;
+    for (size_t i = x->size; i > 0; i--) {
+        uint64_t cur = (rem << 32) | x->limbs[i - 1];
+        x->limbs[i - 1] = (uint32_t)(cur / d);
+        rem = cur % d;
+    }
+    normalize(x);
+    return (uint32_t)rem;
+}
+
+static void mul_schoolbook(BigInt* r, const BigInt* a, const BigInt* b) {
+    size_t an = a->size;
+    size_t bn = b->size;
+    reserve(r, an + bn);
+    memset(r->limbs, 0, (an + bn) * sizeof(uint32_t));
+    for (size_t i = 0; i < an; i++) {
+        uint64_t carry = 0;
+        uint64_t ai = a->limbs[i];
+        for (size_t j = 0; j < bn; j++) {
+            carry += ai * b->limbs[j] + r->limbs[i + j];
+            r->limbs[i + j] = (uint32_t)carry;
+            carry >>= 32;
+        }
+        r->limbs[i + bn] = (uint32_t)carry;
+    }
+    r->size = an + bn;
+    normalize(r);
+}
+
+// a длиннее b хотя бы вдвое: a режется на куски длины b
+static void mul_unbalanced(BigInt* r, const BigInt* a, const BigInt* b) {
+    BigInt chunk, part;
+    bigint_init(&chunk);
+    bigint_init(&part);
+    r->size = 0;
+    for (size_t from = 0; from < a->size; from += b->size) {
+        slice(&chunk, a, from, b->size);
+        mul(&part, &chunk, b);
+        add_shifted(r, &part, from);
+    }
+    bigint_free(&chunk);
+    bigint_free(&part);
+}
+
+// (a1 B^m + a0)(b1 B^m + b0) через три умножения:
+// z1 = (a0 + a1)(b0 + b1) - z0 - z2
+static void mul_karatsuba(BigInt* r, const BigInt* a, const BigInt* b) {
+    size_t m = a->size / 2;
+    BigInt a0, a1, b0, b1, z0, z1, z2;
+    bigint_init(&a0);
+    bigint_init(&a1);
+    bigint_init(&b0);
+    bigint_init(&b1);
+    bigint_init(&z0);
+    bigint_init(&z1);
+    bigint_init(&z2);
+
+    slice(&a0, a, 0, m);
+    slice(&a1, a, m, a->size - m);
+    slice(&b0, b, 0, m);
+    slice(&b1, b, m, b->size);
+    mul(&z0, &a0, &b0);
+    mul(&z2, &a1, &b1);
+    add(&a0, &a0, &a1);
+    add(&b0, &b0, &b1);
+    mul(&z1, &a0, &b0);
+    sub(&z1, &z1, &z0);
+    sub(&z1, &z1, &z2);
+
+    copy(r, &z0);
+    add_shifted(r, &z1, m);
+    add_shifted(r, &z2, 2 * m);
+
+    bigint_free(&a0);
+    bigint_free(&a1);
+    bigint_free(&b0);
+    bigint_free(&b1);
+    bigint_free(&z0);
+    bigint_free(&z1);
+    bigint_free(&z2);
+}
+
+static void signed_init(SignedBig* x) {
+    bigint_init(&x->mag);
+    x->neg = 0;
+}
+
+static void signed_set(SignedBig* r, const BigInt* a) {
+    copy(&r->mag, a);
+    r->neg = 0;
+}
+
+// r = a + (negate ? -b : b); r не совпадает с b
+static void signed_add(SignedBig* r, const SignedBig* a, const SignedBig* b,
+                       int negate) {
+    int bneg = b->neg ^ negate;
+    if (a->neg == bneg) {
+        add(&r->mag, &a->mag, &b->mag);
+        r->neg = a->neg;
+    } else if (compare(&a->mag, &b->mag) >= 0) {
+        sub(&r->mag, &a->mag, &b->mag);
+        r->neg = a->neg;
+    } else {
+        sub(&r->mag, &b->mag, &a->mag);
+        r->neg = bneg;
+    }
+    if (r->mag.size == 0) {
+        r->neg = 0;
+    }
+}
+
+static void signed_mul(SignedBig* r, const SignedBig* a, const SignedBig* b) {
+    mul(&r->mag, &a->mag, &b->mag);
+    r->neg = r->mag.size != 0 && (a->neg ^ b->neg);
+}
+
+// Значения многочлена a0 + a1 x + a2 x^2 в точках 1, -1, -2
+static void toom3_evaluate(const BigInt* part, SignedBig* p1, SignedBig* pm1,
+                           SignedBig* pm2) {
+    SignedBig even, odd, high, low;
+    signed_init(&even);
+    signed_init(&odd);
+    signed_init(&high);
+    signed_init(&low);
+    signed_set(&low, &part[0]);
+    signed_set(&odd, &part[1]);
+    signed_set(&high, &part[2]);
+
+    add(&even.mag, &part[0], &part[2]);
+    signed_add(p1, &even, &odd, 0);
+    signed_add(pm1, &even, &odd, 1);
+    // p(-2) = 2 (p(-1) + a2) - a0
+    signed_add(&even, pm1, &high, 0);
+    add(&even.mag, &even.mag, &even.mag);
+    signed_add(pm2, &even, &low, 1);
+
+    bigint_free(&even.mag);
+    bigint_free(&odd.mag);
+    bigint_free(&high.mag);
+    bigint_free(&low.mag);
+}
+
+// Тоом-3 в варианте Бодрато: пять умножений в точках 0, 1, -1, -2,
+// бесконечность и интерполяция с точными делениями на 2 и 3
+static void mul_toom3(BigInt* r, const BigInt* a, const BigInt* b) {
+    size_t k = (a->size + 2) / 3;
+    BigInt ap[3], bp[3];
+    for (int i = 0; i < 3; i++) {
+        bigint_init(&ap[i]);
+        bigint_init(&bp[i]);
+        slice(&ap[i], a, i * k, k);
+        slice(&bp[i], b, i * k, k);
+    }
+
+    SignedBig pa1, pam1, pam2, pb1, pbm1, pbm2;
+    SignedBig r0, r1, rm1, rm2, rinf, t;
+    SignedBig* all[] = {&pa1, &pam1, &pam2, &pb1, &pbm1, &pbm2,
+                        &r0, &r1, &rm1, &rm2, &rinf, &t};
+    for (size_t i = 0; i < sizeof(all) / sizeof(all[0]); i++) {
+        signed_init(all[i]);
+    }
+
+    toom3_evaluate(ap, &pa1, &pam1, &pam2);
+    toom3_evaluate(bp, &pb1, &pbm1, &pbm2);
+    mul(&r0.mag, &ap[0], &bp[0]);
+    signed_mul(&r1, &pa1, &pb1);
+    signed_mul(&rm1, &pam1, &pbm1);
+    signed_mul(&rm2, &pam2, &pbm2);
+    mul(&rinf.mag, &ap[2], &bp[2]);
+
+    // r3 = (r(-2) - r(1)) / 3
+    signed_add(&t, &rm2, &r1, 1);
+    div_small(&t.mag, 3);
+    // r1 = (r(1) - r(-1)) / 2
+    signed_add(&rm2, &r1, &rm1, 1);
+    div_small(&rm2.mag, 2);
+    // r2 = r(-1) - r(0)
+    signed_add(&pa1, &rm1, &r0, 1);
+    // r3 = (r2 - r3) / 2 + 2 r(inf)
+    signed_add(&pam1, &pa1, &t, 1);
+    div_small(&pam1.mag, 2);
+    add(&t.mag, &rinf.mag, &rinf.mag);
+    t.neg = 0;
+    signed_add(&r1, &pam1, &t, 0);
+    // r2 = r2 + r1 - r(inf)
+    signed_add(&pam2, &pa1, &rm2, 0);
+    signed_add(&rm1, &pam2, &rinf, 1);
+    // r1 = r1 - r3
+    signed_add(&pam2, &rm2, &r1, 1);
+
+    // Коэффициенты произведения неотрицательны: r0, pam2, rm1, r1, rinf
+    copy(r, &r0.mag);
+    add_shifted(r, &pam2.mag, k);
+    add_shifted(r, &rm1.mag, 2 * k);
+    add_shifted(r, &r1.mag, 3 * k);
+    add_shifted(r, &rinf.mag, 4 * k);
+
+    for (int i = 0; i < 3; i++) {
+        bigint_free(&ap[i]);
+        bigint_free(&bp[i]);
+    }
+    for (size_t i = 0; i < sizeof(all) / sizeof(all[0]); i++) {
+        bigint_free(&all[i]->mag);
+    }
+}
+
+// r = a * b, r не совпадает с a и b
+static void mul(BigInt* r, const BigInt* a, const BigInt* b) {
+    if (a->size < b->size) {
+        const BigInt* t = a;
+        a = b;
+        b = t;
+    }
+    if (b->size == 0) {
+        r->size = 0;
+    } else if (b->size < KARATSUBA_THRESHOLD) {
+        mul_schoolbook(r, a, b);
+    } else if (a->size >= 2 * b->size) {
+        mul_unbalanced(r, a, b);
+    } else if (b->size < TOOM3_THRESHOLD) {
+        mul_karatsuba(r, a, b);
+    } else {
+        mul_toom3(r, a, b);
+    }
+}
+
+void bigint_mul(BigInt* r, const BigInt* a, const BigInt* b) {
+    if (r != a && r != b) {
+        mul(r, a, b);
+        return;
+    }
+    BigInt t;
+    bigint_init(&t);
+    mul(&t, a, b);
+    bigint_free(r);
+    *r = t;
+}
+
+void bigint_product_range(BigInt* r, uint64_t first, uint64_t last) {
+    if (first > last) {
+        bigint_set_u64(r, 1);
+        return;
+    }
+    if (first == 0) {
+        r->size = 0;
+        return;
+    }
+    if (last - first < PRODUCT_LEAF) {
+        // Множители копятся в 64-битном числе, пока не грозит переполнение
+        uint64_t acc = 1;
+        bigint_set_u64(r, 1);
+        for (uint64_t n = first;; n++) {
+            if (acc > UINT64_MAX / n) {
+                BigInt t;
+                bigint_init(&t);
+                bigint_set_u64(&t, acc);
+                bigint_mul(r, r, &t);
+                bigint_free(&t);
+                acc = 1;
+            }
+            acc *= n;
+            if (n == last) {
+                break;
+            }
+        }
+        BigInt t;
+        bigint_init(&t);
+        bigint_set_u64(&t, acc);
+        bigint_mul(r, r, &t);
+        bigint_free(&t);
+        return;
+    }
+
+    uint64_t mid = first + (last - first) / 2;
+    BigInt left, right;
+    bigint_init(&left);
+    bigint_init(&right);
+    bigint_product_range(&left, first, mid);
+    bigint_product_range(&right, mid + 1, last);
+    mul(r, &left, &right);
+    bigint_free(&left);
+    bigint_free(&right);
+}
+
+// v = floor(B^(2n) / d) при малом n делением в столбик по битам
+static void reciprocal_small(BigInt* v, const BigInt* d) {
+    size_t n = d->size;
+    size_t bits = 64 * n;
+    BigInt rem;
+    bigint_init(&rem);
+    bigint_set_u64(&rem, 1);
+    reserve(v, 2 * n + 1);
+    memset(v->limbs, 0, (2 * n + 1) * sizeof(uint32_t));
+    v->size = 2 * n + 1;
+    for (size_t bit = bits + 1; bit > 0; bit--) {
+        if (bit <= bits) {
+            add(&rem, &rem, &rem);
+        }
+        if (compare(&rem, d) >= 0) {
+            sub(&rem, &rem, d);
+            v->limbs[(bit - 1) / 32] |= 1u << ((bit - 1) % 32);
+        }
+    }
+    normalize(v);
+    bigint_free(&rem);
+}
+
+// v = floor(B^(2n) / d), n = d->size. Приближение по старшим n / 2 + 2
+// разрядам d, затем шаг Ньютона v += v (B^(2n) - d v) / B^(2n) и точная
+// поправка остатком
+static void reciprocal(BigInt* v, const BigInt* d) {
+    size_t n = d->size;
+    if (n <= RECIPROCAL_THRESHOLD) {
+        reciprocal_small(v, d);
+        return;
+    }
+    size_t h = n / 2 + 2;
+    size_t low = n - h;
+
+    BigInt top, power;
+    SignedBig err, step, x;
+    bigint_init(&top);
+    bigint_init(&power);
+    signed_init(&err);
+    signed_init(&step);
+    signed_init(&x);
+
+    slice(&top, d, low, h);
+    reciprocal(&step.mag, &top);
+    shift_up(&x.mag, &step.mag, low);
+
+    bigint_set_u64(&top, 1);
+    shift_up(&power, &top, 2 * n);
+
+    // err = B^(2n) - d x; x += x err / B^(2n)
+    mul(&top, d, &x.mag);
+    signed_set(&step, &top);
+    signed_set(&err, &power);
+    signed_add(&err, &err, &step, 1);
+    mul(&top, &x.mag, &err.mag);
+    slice(&step.mag, &top, 2 * n, top.size);
+    step.neg = err.neg;
+    signed_add(&err, &x, &step, 0);
+
+    // Остаток B^(2n) - d v приводится в [0, d)
+    mul(&top, d, &err.mag);
+    copy(v, &err.mag);
+    while (compare(&top, &power) > 0) {
+        sub_small(v, 1);
+        sub(&top, &top, d);
+    }
+    sub(&power, &power, &top);
+    while (compare(&power, d) >= 0) {
+        add_small(v, 1);
+        sub(&power, &power, d);
+    }
+
+    bigint_free(&top);
+    bigint_free(&power);
+    bigint_free(&err.mag);
+    bigint_free(&step.mag);
+    bigint_free(&x.mag);
+}
+
+// q, r = divmod(x, p) по Барретту при x < B^(2n), n = p->size,
+// v = floor(B^(2n) / p): q = floor(floor(x / B^(n - 1)) v / B^(n + 1))
+// меньше точного частного не больше чем на 2
+static void divmod(BigInt* q, BigInt* r, const BigInt* x, const BigInt* p,
+                   const BigInt* v) {
+    size_t n = p->size;
+    BigInt t;
+    bigint_init(&t);
+    slice(r, x, n - 1, x->size);
+    mul(&t, r, v);
+    slice(q, &t, n + 1, t.size);
+    mul(&t, q, p);
+    sub(r, x, &t);
+    while (compare(r, p) >= 0) {
+        sub(r, r, p);
+        add_small(q, 1);
+    }
+    bigint_free(&t);
+}
+
+typedef struct {
+    BigInt* powers;      // 10^(9 * 2^i)
+    BigInt* reciprocals;
+} DecimalLevels;
+
+// Пишет ровно width цифр x (с ведущими нулями) в out; x < 10^width
+static void to_decimal(const BigInt* x, int level, const DecimalLevels* levels,
+                       char* out, size_t width) {
+    if (level < 0 || x->size <= DECIMAL_THRESHOLD) {
+        BigInt t;
+        bigint_init(&t);
+        copy(&t, x);
+        memset(out, '0', width);
+        for (size_t pos = width; t.size > 0; pos -= DECIMAL_DIGITS) {
+            uint32_t chunk = div_small(&t, DECIMAL_BASE);
+            for (size_t i = 0; i < DECIMAL_DIGITS; i++) {
+                out[pos - 1 - i] = (char)('0' + chunk % 10);
+                chunk /= 10;
+            }
+        }
+        bigint_free(&t);
+        return;
+    }
+
+    BigInt q, r;
+    bigint_init(&q);
+    bigint_init(&r);
+    divmod(&q, &r, x, &levels->powers[level], &levels->reciprocals[level]);
+    to_decimal(&q, level - 1, levels, out, width / 2);
+    to_decimal(&r, level - 1, levels, out + width / 2, width / 2);
+    bigint_free(&q);
+    bigint_free(&r);
+}
+
+char* bigint_to_decimal(const BigInt* x) {
+    // Уровень top подобран так, что x < (10^(9 * 2^top))^2: тогда частное
+    // и остаток на каждом шаге вдвое короче и помещаются в свою половину
+    int capacity = 64;
+    DecimalLevels levels;
+    levels.powers = (BigInt*)calloc(capacity, sizeof(BigInt));
+    levels.reciprocals = (BigInt*)calloc(capacity, sizeof(BigInt));
+    if (levels.powers == NULL || levels.reciprocals == NULL) {
+        fprintf(stderr, "Ошибка выделения памяти\n");
+        exit(1);
+    }
+    int top = 0;
+    bigint_set_u64(&levels.powers[0], DECIMAL_BASE);
+    while (x->size + 2 > 2 * levels.powers[top].size) {
+        mul(&levels.powers[top + 1], &levels.powers[top], &levels.powers[top]);
+        top++;
+    }
+    for (int i = 0; i <= top; i++) {
+        if (levels.powers[i].size > DECIMAL_THRESHOLD / 2) {
+            reciprocal(&levels.reciprocals[i], &levels.powers[i]);
+        }
+    }
+
+    size_t width = (size_t)DECIMAL_DIGITS << (top + 1);
+    char* out = (char*)malloc(width + 1);
+    if (out == NULL) {
+        fprintf(stderr, "Ошибка выделения памяти\n");
+        exit(1);
+    }
+    to_decimal(x, top, &levels, out, width);
+    out[width] = '\0';
+
+    size_t zeros = 0;
+    while (zeros + 1 < width && out[zeros] == '0') {
+        zeros++;
+    }
+    memmove(out, out + zeros, width - zeros + 1);
+
+    for (int i = 0; i <= top; i++) {
+        bigint_free(&levels.powers[i]);
+        bigint_free(&levels.reciprocals[i]);
+    }
+    free(levels.powers);
+    free(levels.reciprocals);
+    return out;
+}
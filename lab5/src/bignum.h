@@ -0,0 +1,32 @@
+#ifndef BIGNUM_H
+#define BIGNUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Неотрицательное целое произвольной длины: разряды по основанию 2^32,
+// младшие первыми. При нехватке памяти функции печатают ошибку и
+// завершают программу, поэтому кодов возврата нет.
+typedef struct {
+    uint32_t* limbs;
+    size_t size;        // значащих разрядов, 0 для нуля
+    size_t capacity;
+} BigInt;
+
+void bigint_init(BigInt* x);
+void bigint_free(BigInt* x);
+void bigint_set_u64(BigInt* x, uint64_t value);
+
+// r = a * b; r может совпадать с a или b. Алгоритм выбирается по длине:
+// школьный, Карацуба, Тоом-3, для сильно разных длин - по кускам.
+void bigint_mul(BigInt* r, const BigInt* a, const BigInt* b);
+
+// r = first * (first + 1) * ... * last сбалансированным деревом
+// произведений; при first > last r = 1
+void bigint_product_range(BigInt* r, uint64_t first, uint64_t last);
+
+// Десятичная запись (malloc), перевод делением пополам по степеням
+// 10^(9 * 2^i) с обратными по Ньютону
+char* bigint_to_decimal(const BigInt* x);
+
+#endif
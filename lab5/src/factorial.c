@@ -1,3 +1,6 @@
+// Сборка: gcc factorial.c bignum.c -pthread -o factorial
+#define _GNU_SOURCE
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
@@ -5,6 +8,69 @@
 #include <unistd.h>
 #include <getopt.h>
 #include <stdatomic.h>
+#include <time.h>
+
+#include "bignum.h"
+
+// Способ раздачи чисел потокам
+typedef enum {
+    SCHEDULE_ITEM,    // по одному числу за атомарную операцию
+    SCHEDULE_BLOCK,   // блоками фиксированного размера
+    SCHEDULE_GUIDED,  // блоками, убывающими вместе с остатком работы
+    SCHEDULE_STATIC   // каждый поток заранее получает свой отрезок
+} Schedule;
+
+// Политика закрепления потоков за процессорами
+typedef enum {
+    AFFINITY_NONE,      // потоки размещает ядро ОС
+    AFFINITY_COMPACT,   // SMT-соседи, затем ядра одного сокета, затем сокеты
+    AFFINITY_SCATTER,   // сокеты поочередно, SMT-соседи в последнюю очередь
+    AFFINITY_PHYSICAL   // как compact, но по одному потоку на физическое ядро
+} Affinity;
+
+// Способ сложить локальные результаты потоков в общий
+typedef enum {
+    REDUCE_MUTEX,       // общий результат под мьютексом
+    REDUCE_TREE,        // слоты потоков, попарное дерево после join
+    REDUCE_CAS          // общий результат через compare-and-swap
+} Reduce;
+
+// Состояние старта --exact (под result_mutex). Барьер дерева ждет все pnum
+// потоков, поэтому при ошибке создания потока уже созданные не должны до
+// него дойти: они ждут решения и по START_CANCEL сразу выходят
+#define START_WAIT 0
+#define START_GO 1
+#define START_CANCEL 2
+
+// Глубина стека произведений в --exact. Отрезки guided становятся короче,
+// и каждое новое произведение короче лежащего ниже, так что правило
+// слияния может не сработать ни разу: у полного стека два верхних числа
+// сливаются без условия
+#define EXACT_STACK_DEPTH 64
+
+// Размер строки кэша; слоты соседних потоков не делят строку
+#define CACHE_LINE 64
+
+typedef struct {
+    long long value;
+    char pad[CACHE_LINE - sizeof(long long)];
+} __attribute__((aligned(CACHE_LINE))) ResultSlot;
+
+// Параметры раздачи работы и сборки результата
+typedef struct {
+    Schedule schedule;
+    long long block;            // Размер блока (минимальный для guided)
+    Affinity affinity;
+    Reduce reduce;
+} RunOptions;
+
+// Логический процессор и его место в топологии
+typedef struct {
+    int cpu;
+    int package;        // сокет
+    int core;           // ядро (для scatter - номер ядра внутри сокета)
+    int smt;            // номер среди SMT-соседей ядра
+} CpuInfo;
 
 // Структура для передачи данных в потоки
 typedef struct {
@@ -13,36 +79,310 @@ typedef struct {
     long long* current;         // Текущее число для обработки (разделяемая переменная)
     long long* result;          // Результат (разделяемая переменная)
     pthread_mutex_t* result_mutex;  // Мьютекс для синхронизации результата
+    ResultSlot* slots;          // Слоты потоков для REDUCE_TREE
+    BigInt* big_slots;          // Точные произведения потоков для --exact
+    pthread_barrier_t* barrier; // Шаги дерева произведений для --exact
+    pthread_cond_t* start_cond; // Старт --exact: ждать, пока созданы все потоки
+    int* start_state;           // START_WAIT, START_GO или START_CANCEL
+    Schedule schedule;          // Способ раздачи чисел
+    long long block;            // Размер блока (минимальный для guided)
+    Reduce reduce;              // Способ сборки результата
+    int pnum;                   // Количество потоков
+    int index;                  // Номер потока, нужен для static
+    long long claims;           // Сколько раз поток забирал работу
 } ThreadData;
 
+// a * b mod m без переполнения: произведение считается в 128 битах
+long long mul_mod(long long a, long long b, long long mod) {
+    return (long long)((unsigned __int128)a * (unsigned long long)b % mod);
+}
+
+// first * ... * last mod m в четырех независимых цепочках: умножение с
+// делением длится десятки тактов, и соседние цепочки выполняются
+// одновременно, а не ждут друг друга
+long long range_product(long long first, long long last, long long mod) {
+    long long acc[4] = {1 % mod, 1 % mod, 1 % mod, 1 % mod};
+    long long num = first;
+    for (; num + 3 <= last; num += 4) {
+        acc[0] = mul_mod(acc[0], num, mod);
+        acc[1] = mul_mod(acc[1], num + 1, mod);
+        acc[2] = mul_mod(acc[2], num + 2, mod);
+        acc[3] = mul_mod(acc[3], num + 3, mod);
+    }
+    for (; num <= last; num++) {
+        acc[0] = mul_mod(acc[0], num, mod);
+    }
+    return mul_mod(mul_mod(acc[0], acc[1], mod), mul_mod(acc[2], acc[3], mod), mod);
+}
+
+// Забирает очередной отрезок [*first, *last]; возвращает 0, если работы
+// не осталось
+int claim_range(ThreadData* data, long long* first, long long* last) {
+    long long size = 0;
+    long long start = 0;
+
+    switch (data->schedule) {
+        case SCHEDULE_ITEM:
+            size = 1;
+            start = __atomic_fetch_add(data->current, size, __ATOMIC_RELAXED);
+            break;
+        case SCHEDULE_BLOCK:
+            size = data->block;
+            start = __atomic_fetch_add(data->current, size, __ATOMIC_RELAXED);
+            break;
+        case SCHEDULE_GUIDED:
+            // Блок - доля остатка на поток: в начале крупные блоки дают мало
+            // обращений к общему счетчику, в конце мелкие выравнивают потоки
+            start = __atomic_load_n(data->current, __ATOMIC_RELAXED);
+            do {
+                if (start > data->k) {
+                    return 0;
+                }
+                size = (data->k - start + 1) / (2LL * data->pnum);
+                if (size < data->block) {
+                    size = data->block;
+                }
+            } while (!__atomic_compare_exchange_n(data->current, &start,
+                                                  start + size, 1,
+                                                  __ATOMIC_RELAXED,
+                                                  __ATOMIC_RELAXED));
+            break;
+        case SCHEDULE_STATIC: {
+            // Общий счетчик не нужен: отрезок вычисляется по номеру потока
+            if (data->claims > 0) {
+                return 0;
+            }
+            long long base = data->k / data->pnum;
+            long long extra = data->k % data->pnum;
+            start = 1 + data->index * base +
+                    (data->index < extra ? data->index : extra);
+            size = base + (data->index < extra ? 1 : 0);
+            if (size == 0) {
+                return 0;
+            }
+        } break;
+    }
+
+    if (start > data->k) {
+        return 0;
+    }
+    *first = start;
+    *last = (size > data->k - start) ? data->k : start + size - 1;
+    data->claims++;
+    return 1;
+}
+
 // Функция, которую выполняет каждый поток
 void* worker(void* arg) {
     ThreadData* data = (ThreadData*)arg;
     long long local_result = 1;
-    long long num = 0;
+    long long first = 0;
+    long long last = 0;
     
-    // Каждый поток берет следующее число для обработки
-    while (1) {
-        num = __atomic_fetch_add(data->current, 1, __ATOMIC_RELAXED);
-        
-        if (num > data->k) {
-            break;  // Все числа обработаны
-        }
-        
+    // Каждый поток забирает отрезок чисел и перемножает его без обращений
+    // к общим данным
+    while (claim_range(data, &first, &last)) {
         // Вычисляем локальный результат
-        local_result = (local_result * num) % data->mod;
+        local_result = mul_mod(local_result, range_product(first, last, data->mod),
+                               data->mod);
     }
     
-    // Синхронизация итогового результата с использованием мьютекса
+    switch (data->reduce) {
+        case REDUCE_MUTEX:
+            // Синхронизация итогового результата с использованием мьютекса
+            pthread_mutex_lock(data->result_mutex);
+            *data->result = mul_mod(*data->result, local_result, data->mod);
+            pthread_mutex_unlock(data->result_mutex);
+            break;
+        case REDUCE_TREE:
+            // Свой слот на отдельной строке кэша; собирает главный поток
+            data->slots[data->index].value = local_result;
+            break;
+        case REDUCE_CAS: {
+            // Повтор, если между чтением и записью результат изменил
+            // другой поток; ожидания на блокировке нет
+            long long old = __atomic_load_n(data->result, __ATOMIC_RELAXED);
+            long long updated;
+            do {
+                updated = mul_mod(old, local_result, data->mod);
+            } while (!__atomic_compare_exchange_n(data->result, &old, updated, 1,
+                                                  __ATOMIC_RELAXED,
+                                                  __ATOMIC_RELAXED));
+        } break;
+    }
+    
+    return NULL;
+}
+
+// Точный вариант worker: произведения отрезков копятся стеком, в котором
+// верхнее число сливается с нижним, как только оно не короче его, поэтому
+// перемножаются числа близкой длины. Затем потоки вместе сворачивают свои
+// произведения попарным деревом: на шаге step поток index (кратный
+// 2 * step) умножает свой слот на слот index + step, барьер разделяет шаги.
+void* exact_worker(void* arg) {
+    ThreadData* data = (ThreadData*)arg;
+    BigInt stack[EXACT_STACK_DEPTH];
+    int depth = 0;
+    long long first = 0;
+    long long last = 0;
+
     pthread_mutex_lock(data->result_mutex);
-    *data->result = (*data->result * local_result) % data->mod;
+    while (*data->start_state == START_WAIT) {
+        pthread_cond_wait(data->start_cond, data->result_mutex);
+    }
+    int cancelled = *data->start_state == START_CANCEL;
     pthread_mutex_unlock(data->result_mutex);
-    
+    if (cancelled) {
+        return NULL;
+    }
+
+    while (claim_range(data, &first, &last)) {
+        if (depth == EXACT_STACK_DEPTH) {
+            bigint_mul(&stack[depth - 2], &stack[depth - 2], &stack[depth - 1]);
+            bigint_free(&stack[depth - 1]);
+            depth--;
+        }
+        bigint_init(&stack[depth]);
+        bigint_product_range(&stack[depth], first, last);
+        depth++;
+        while (depth >= 2 && stack[depth - 1].size >= stack[depth - 2].size) {
+            bigint_mul(&stack[depth - 2], &stack[depth - 2], &stack[depth - 1]);
+            bigint_free(&stack[depth - 1]);
+            depth--;
+        }
+    }
+
+    BigInt* own = &data->big_slots[data->index];
+    bigint_set_u64(own, 1);
+    while (depth > 0) {
+        depth--;
+        bigint_mul(own, own, &stack[depth]);
+        bigint_free(&stack[depth]);
+    }
+
+    for (int step = 1; step < data->pnum; step *= 2) {
+        pthread_barrier_wait(data->barrier);
+        if (data->index % (2 * step) == 0 && data->index + step < data->pnum) {
+            bigint_mul(own, own, &data->big_slots[data->index + step]);
+            bigint_free(&data->big_slots[data->index + step]);
+        }
+    }
     return NULL;
 }
 
+int read_topology_id(int cpu, const char* name, int fallback) {
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+    FILE* f = fopen(path, "r");
+    int value = fallback;
+    if (f != NULL) {
+        if (fscanf(f, "%d", &value) != 1) {
+            value = fallback;
+        }
+        fclose(f);
+    }
+    return value;
+}
+
+int compare_compact(const void* a, const void* b) {
+    const CpuInfo* x = (const CpuInfo*)a;
+    const CpuInfo* y = (const CpuInfo*)b;
+    if (x->package != y->package) return x->package - y->package;
+    if (x->core != y->core) return x->core - y->core;
+    if (x->smt != y->smt) return x->smt - y->smt;
+    return x->cpu - y->cpu;
+}
+
+int compare_scatter(const void* a, const void* b) {
+    const CpuInfo* x = (const CpuInfo*)a;
+    const CpuInfo* y = (const CpuInfo*)b;
+    if (x->smt != y->smt) return x->smt - y->smt;
+    if (x->core != y->core) return x->core - y->core;
+    if (x->package != y->package) return x->package - y->package;
+    return x->cpu - y->cpu;
+}
+
+// Заполняет order номерами процессоров в порядке занятия потоками по
+// политике; возвращает их количество (0 - закреплять не нужно).
+// Топология читается из /sys/devices/system/cpu для процессоров,
+// разрешенных процессу.
+int build_cpu_order(Affinity affinity, int** order) {
+    cpu_set_t allowed;
+    *order = NULL;
+    if (affinity == AFFINITY_NONE ||
+        sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return 0;
+    }
+
+    int count = CPU_COUNT(&allowed);
+    CpuInfo* cpus = (CpuInfo*)malloc(count * sizeof(CpuInfo));
+    *order = (int*)malloc(count * sizeof(int));
+    if (cpus == NULL || *order == NULL) {
+        free(cpus);
+        free(*order);
+        *order = NULL;
+        return 0;
+    }
+
+    int n = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE && n < count; cpu++) {
+        if (CPU_ISSET(cpu, &allowed)) {
+            cpus[n].cpu = cpu;
+            cpus[n].package = read_topology_id(cpu, "physical_package_id", 0);
+            cpus[n].core = read_topology_id(cpu, "core_id", cpu);
+            cpus[n].smt = 0;
+            n++;
+        }
+    }
+
+    // После сортировки SMT-соседи идут подряд: нумеруем их, а ядра
+    // перенумеровываем внутри сокета (core_id бывает с пропусками)
+    qsort(cpus, count, sizeof(CpuInfo), compare_compact);
+    int rank = 0;
+    int prev_core = -1;
+    for (int i = 0; i < count; i++) {
+        int core = cpus[i].core;
+        if (i == 0 || cpus[i].package != cpus[i - 1].package) {
+            rank = 0;
+        } else if (core == prev_core) {
+            cpus[i].smt = cpus[i - 1].smt + 1;
+        } else {
+            rank++;
+        }
+        prev_core = core;
+        cpus[i].core = rank;
+    }
+    if (affinity == AFFINITY_SCATTER) {
+        qsort(cpus, count, sizeof(CpuInfo), compare_scatter);
+    }
+
+    n = 0;
+    for (int i = 0; i < count; i++) {
+        if (affinity != AFFINITY_PHYSICAL || cpus[i].smt == 0) {
+            (*order)[n++] = cpus[i].cpu;
+        }
+    }
+    free(cpus);
+    return n;
+}
+
+// Попарное дерево: на шаге step слот i забирает слот i + step, глубина
+// log2(pnum), соседние умножения независимы
+long long tree_reduce(ResultSlot* slots, int count, long long mod) {
+    for (int step = 1; step < count; step *= 2) {
+        for (int i = 0; i + step < count; i += 2 * step) {
+            slots[i].value = mul_mod(slots[i].value, slots[i + step].value, mod);
+        }
+    }
+    return slots[0].value;
+}
+
 // Функция для вычисления факториала
-long long calculate_factorial(long long k, int pnum, long long mod) {
+// claims - массив на pnum элементов или NULL. Если exact не NULL, туда
+// записывается точное значение k!, а mod и options->reduce не используются.
+long long calculate_factorial(long long k, int pnum, long long mod,
+                              const RunOptions* options, long long* claims,
+                              BigInt* exact) {
     long long current = 1;
     long long result = 1;
     pthread_t* threads = NULL;
@@ -58,15 +398,35 @@ long long calculate_factorial(long long k, int pnum, long long mod) {
     // Выделяем память для потоков и их данных
     threads = (pthread_t*)malloc(pnum * sizeof(pthread_t));
     thread_data = (ThreadData*)malloc(pnum * sizeof(ThreadData));
+    ResultSlot* slots = (ResultSlot*)aligned_alloc(CACHE_LINE, pnum * sizeof(ResultSlot));
+    BigInt* big_slots = (BigInt*)calloc(pnum, sizeof(BigInt));
     
-    if (threads == NULL || thread_data == NULL) {
+    if (threads == NULL || thread_data == NULL || slots == NULL || big_slots == NULL) {
         fprintf(stderr, "Ошибка выделения памяти\n");
         free(threads);
         free(thread_data);
+        free(slots);
+        free(big_slots);
+        pthread_mutex_destroy(&result_mutex);
+        return -1;
+    }
+
+    pthread_barrier_t barrier;
+    pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+    int start_state = START_WAIT;
+    if (exact != NULL && pthread_barrier_init(&barrier, NULL, pnum) != 0) {
+        fprintf(stderr, "Ошибка инициализации барьера\n");
+        free(threads);
+        free(thread_data);
+        free(slots);
+        free(big_slots);
         pthread_mutex_destroy(&result_mutex);
         return -1;
     }
     
+    int* cpu_order = NULL;
+    int cpu_count = build_cpu_order(options->affinity, &cpu_order);
+
     // Создаем и запускаем потоки
     for (int i = 0; i < pnum; i++) {
         thread_data[i].k = k;
@@ -74,42 +434,190 @@ long long calculate_factorial(long long k, int pnum, long long mod) {
         thread_data[i].current = &current;
         thread_data[i].result = &result;
         thread_data[i].result_mutex = &result_mutex;
+        thread_data[i].slots = slots;
+        thread_data[i].big_slots = big_slots;
+        thread_data[i].barrier = &barrier;
+        thread_data[i].start_cond = &start_cond;
+        thread_data[i].start_state = &start_state;
+        thread_data[i].schedule = options->schedule;
+        thread_data[i].block = options->block;
+        thread_data[i].reduce = options->reduce;
+        thread_data[i].pnum = pnum;
+        thread_data[i].index = i;
+        thread_data[i].claims = 0;
         
-        if (pthread_create(&threads[i], NULL, worker, &thread_data[i]) != 0) {
+        void* (*routine)(void*) = exact != NULL ? exact_worker : worker;
+        if (pthread_create(&threads[i], NULL, routine, &thread_data[i]) != 0) {
             fprintf(stderr, "Ошибка создания потока %d\n", i);
+            if (exact != NULL) {
+                // Созданные потоки еще ждут старта: отменяем их до барьера
+                pthread_mutex_lock(&result_mutex);
+                start_state = START_CANCEL;
+                pthread_cond_broadcast(&start_cond);
+                pthread_mutex_unlock(&result_mutex);
+            }
             // Завершаем уже созданные потоки
             for (int j = 0; j < i; j++) {
                 pthread_join(threads[j], NULL);
             }
+            if (exact != NULL) {
+                pthread_barrier_destroy(&barrier);
+            }
             free(threads);
             free(thread_data);
+            free(slots);
+            free(big_slots);
             pthread_mutex_destroy(&result_mutex);
+            free(cpu_order);
             return -1;
         }
+
+        // Поток i закрепляется за cpu_order[i % cpu_count]
+        if (cpu_count > 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu_order[i % cpu_count], &set);
+            if (pthread_setaffinity_np(threads[i], sizeof(set), &set) != 0) {
+                fprintf(stderr, "Предупреждение: не удалось закрепить поток %d\n", i);
+            }
+        }
+    }
+    free(cpu_order);
+
+    if (exact != NULL) {
+        pthread_mutex_lock(&result_mutex);
+        start_state = START_GO;
+        pthread_cond_broadcast(&start_cond);
+        pthread_mutex_unlock(&result_mutex);
     }
     
     // Ожидаем завершения всех потоков
     for (int i = 0; i < pnum; i++) {
         pthread_join(threads[i], NULL);
+        if (claims != NULL) {
+            claims[i] = thread_data[i].claims;
+        }
+    }
+    
+    if (exact != NULL) {
+        bigint_free(exact);
+        *exact = big_slots[0];
+        pthread_barrier_destroy(&barrier);
+        result = 0;
+    } else if (options->reduce == REDUCE_TREE) {
+        result = tree_reduce(slots, pnum, mod);
     }
     
     // Освобождаем ресурсы
     free(threads);
     free(thread_data);
+    free(slots);
+    free(big_slots);
     pthread_mutex_destroy(&result_mutex);
     
     return result;
 }
 
 void print_usage(const char* program_name) {
-    printf("Использование: %s -k <число> --pnum=<количество_потоков> --mod=<модуль>\n", program_name);
+    printf("Использование: %s -k <число> --pnum=<количество_потоков> --mod=<модуль> "
+           "[--schedule=item|block|guided|static] [--block=<размер>] "
+           "[--affinity=none|compact|scatter|physical] [--reduce=mutex|tree|cas] "
+           "[--bench]\n", program_name);
+    printf("       %s -k <число> --pnum=<количество_потоков> --exact\n", program_name);
     printf("Пример: %s -k 10 --pnum=4 --mod=10\n", program_name);
+    printf("--exact печатает k! целиком вместо остатка по модулю\n");
+    printf("--bench сравнивает способы сборки результата на 1..128 потоках\n");
+}
+
+int parse_schedule(const char* name, Schedule* schedule) {
+    static const char* names[] = {"item", "block", "guided", "static"};
+    for (int i = 0; i < 4; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *schedule = (Schedule)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int parse_affinity(const char* name, Affinity* affinity) {
+    static const char* names[] = {"none", "compact", "scatter", "physical"};
+    for (int i = 0; i < 4; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *affinity = (Affinity)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int parse_reduce(const char* name, Reduce* reduce) {
+    static const char* names[] = {"mutex", "tree", "cas"};
+    for (int i = 0; i < 3; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *reduce = (Reduce)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Лучшее из нескольких запусков время для 1, 2, 4, ..., 128 потоков и
+// каждого способа сборки результата. Результаты сверяются между собой.
+int run_reduce_bench(long long k, long long mod, RunOptions options) {
+    static const char* names[] = {"mutex", "tree", "cas"};
+    const int repeats = 5;
+
+    printf("%8s", "threads");
+    for (int r = 0; r < 3; r++) {
+        printf(" %12s", names[r]);
+    }
+    printf("\n");
+
+    for (int pnum = 1; pnum <= 128; pnum *= 2) {
+        long long expected = -1;
+        printf("%8d", pnum);
+        for (int r = 0; r < 3; r++) {
+            options.reduce = (Reduce)r;
+            double best = 0;
+            for (int rep = 0; rep < repeats; rep++) {
+                double started = now_seconds();
+                long long result = calculate_factorial(k, pnum, mod, &options, NULL, NULL);
+                double elapsed = now_seconds() - started;
+                if (result == -1 || (expected != -1 && result != expected)) {
+                    fprintf(stderr, "\nОшибка: %s дал %lld вместо %lld\n",
+                            names[r], result, expected);
+                    return 1;
+                }
+                expected = result;
+                if (rep == 0 || elapsed < best) {
+                    best = elapsed;
+                }
+            }
+            printf(" %10.3fms", best * 1e3);
+        }
+        printf("\n");
+    }
+    return 0;
 }
 
 int main(int argc, char* argv[]) {
     long long k = 0;
     int pnum = 1;
     long long mod = 0;
+    RunOptions options = {SCHEDULE_GUIDED, 1024, AFFINITY_NONE, REDUCE_MUTEX};
+    const char* affinity_name = "none";
+    const char* reduce_name = "mutex";
+    int report = 0;             // печатать время и число захватов
+    int bench = 0;
+    int exact = 0;
+    BigInt exact_result;
     int opt;
     int option_index = 0;
     
@@ -117,6 +625,12 @@ int main(int argc, char* argv[]) {
     struct option long_options[] = {
         {"pnum", required_argument, 0, 'p'},
         {"mod", required_argument, 0, 'm'},
+        {"schedule", required_argument, 0, 's'},
+        {"block", required_argument, 0, 'b'},
+        {"affinity", required_argument, 0, 'a'},
+        {"reduce", required_argument, 0, 'r'},
+        {"bench", no_argument, 0, 'B'},
+        {"exact", no_argument, 0, 'e'},
         {0, 0, 0, 0}
     };
     
@@ -132,6 +646,41 @@ int main(int argc, char* argv[]) {
             case 'm':
                 mod = atoll(optarg);
                 break;
+            case 's':
+                if (!parse_schedule(optarg, &options.schedule)) {
+                    fprintf(stderr, "Ошибка: неизвестный способ раздачи %s\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                report = 1;
+                break;
+            case 'b':
+                options.block = atoll(optarg);
+                break;
+            case 'a':
+                if (!parse_affinity(optarg, &options.affinity)) {
+                    fprintf(stderr, "Ошибка: неизвестная политика привязки %s\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                affinity_name = optarg;
+                report = 1;
+                break;
+            case 'r':
+                if (!parse_reduce(optarg, &options.reduce)) {
+                    fprintf(stderr, "Ошибка: неизвестный способ сборки %s\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                reduce_name = optarg;
+                report = 1;
+                break;
+            case 'B':
+                bench = 1;
+                break;
+            case 'e':
+                exact = 1;
+                break;
             default:
                 print_usage(argv[0]);
                 return 1;
@@ -139,12 +688,15 @@ int main(int argc, char* argv[]) {
     }
     
     // Проверка корректности введенных данных
-    if (k <= 0 || pnum <= 0 || mod <= 0) {
+    if (k <= 0 || pnum <= 0 || (mod <= 0 && !exact) || options.block <= 0) {
         fprintf(stderr, "Ошибка: все параметры должны быть положительными числами!\n");
         print_usage(argv[0]);
         return 1;
     }
     
+    if (bench) {
+        return run_reduce_bench(k, mod, options);
+    }
     
     // Если потоков больше чем чисел для обработки
     if (pnum > k) {
@@ -152,16 +704,54 @@ int main(int argc, char* argv[]) {
         printf("Предупреждение: количество потоков уменьшено до %d (так как k = %lld)\n", pnum, k);
     }
     
+    long long* claims = (long long*)calloc(pnum, sizeof(long long));
+    if (claims == NULL) {
+        fprintf(stderr, "Ошибка выделения памяти\n");
+        return 1;
+    }
+    bigint_init(&exact_result);
+
     // Вычисляем факториал
-    long long result = calculate_factorial(k, pnum, mod);
+    double started = now_seconds();
+    long long result = calculate_factorial(k, pnum, mod, &options, claims,
+                                           exact ? &exact_result : NULL);
+    double elapsed = now_seconds() - started;
     
     if (result == -1) {
         fprintf(stderr, "Ошибка при вычислении факториала\n");
+        free(claims);
         return 1;
     }
     
     // Выводим результат
-    printf("%lld! mod %lld = %lld\n", k, mod, result);
+    if (exact) {
+        double convert_started = now_seconds();
+        char* digits = bigint_to_decimal(&exact_result);
+        double convert_elapsed = now_seconds() - convert_started;
+        printf("%lld! = %s\n", k, digits);
+        if (report) {
+            printf("Цифр: %zu, перевод в десятичную запись: %.6f с\n",
+                   strlen(digits), convert_elapsed);
+        }
+        free(digits);
+        bigint_free(&exact_result);
+    } else {
+        printf("%lld! mod %lld = %lld\n", k, mod, result);
+    }
+
+    // При явном --schedule или --affinity печатаем, во что обошлась раздача работы
+    if (report) {
+        long long total_claims = 0;
+        printf("Время: %.6f с\n", elapsed);
+        printf("Привязка потоков: %s\n", affinity_name);
+        printf("Сборка результата: %s\n", exact ? "exact" : reduce_name);
+        for (int i = 0; i < pnum; i++) {
+            printf("Поток %d: захватов %lld\n", i, claims[i]);
+            total_claims += claims[i];
+        }
+        printf("Всего захватов: %lld\n", total_claims);
+    }
+    free(claims);
     
     return 0;
 }
\ No newline at end of file
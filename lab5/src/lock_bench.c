@@ -0,0 +1,503 @@
+// Сборка: gcc -O2 lock_bench.c -pthread -o lock_bench
+//
+// Нагрузка из mutex.c: поток захватывает блокировку, читает общий счетчик,
+// крутит цикл внутри критической секции и записывает счетчик обратно.
+// Одна и та же нагрузка прогоняется с разными примитивами синхронизации.
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lockhist.h"
+
+// Размер строки кэша; слова разных блокировок и узлы MCS не делят строку
+#define CACHE_LINE 64
+#define MAX_THREADS 1024
+
+// Примитив, которым защищен общий счетчик
+typedef enum {
+    LOCK_MUTEX,     // pthread_mutex_t
+    LOCK_SPIN,      // pthread_spinlock_t
+    LOCK_TTAS,      // test-and-test-and-set: ждем на чтении, потом exchange
+    LOCK_TICKET,    // билеты: захват строго в порядке прихода
+    LOCK_MCS,       // очередь MCS: каждый ждет на своем узле
+    LOCK_FUTEX,     // слово 0/1/2 и системный вызов futex для ожидания
+    LOCK_ATOMIC,    // без блокировки: атомарный инкремент счетчика
+    LOCK_COUNT
+} LockKind;
+
+static const char* lock_names[LOCK_COUNT] = {"mutex", "spin", "ttas", "ticket",
+                                             "mcs", "futex", "atomic"};
+
+// Узел очереди MCS, у каждого потока свой
+typedef struct McsNode {
+    struct McsNode* next;
+    int locked;
+} __attribute__((aligned(CACHE_LINE))) McsNode;
+
+// Все блокировки сразу; используется та, что выбрана в kind
+typedef struct {
+    LockKind kind;
+    pthread_mutex_t mutex;
+    pthread_spinlock_t spin;
+    int flag __attribute__((aligned(CACHE_LINE)));          // ttas
+    int futex_word __attribute__((aligned(CACHE_LINE)));    // 0 свободно, 1 занято, 2 есть ждущие
+    unsigned next_ticket __attribute__((aligned(CACHE_LINE)));
+    unsigned now_serving __attribute__((aligned(CACHE_LINE)));
+    McsNode* tail __attribute__((aligned(CACHE_LINE)));
+    long long common __attribute__((aligned(CACHE_LINE)));  // общий счетчик из mutex.c
+} Lock;
+
+// Параметры прогона
+typedef struct {
+    long long cs_work;          // итераций цикла внутри критической секции
+    long long think_work;       // итераций цикла между захватами
+    int duration_ms;            // длительность одного прогона
+    int sample;                 // замерять ожидание каждого sample-го захвата
+    int per_thread;             // печатать число захватов каждого потока
+} BenchOptions;
+
+// Данные потока; выровнены, чтобы счетчики соседей не делили строку
+typedef struct {
+    McsNode node;
+    Lock* lock;
+    const BenchOptions* options;
+    pthread_barrier_t* barrier;
+    int* stop;
+    long long acquisitions;
+    uint64_t wait_max;
+    uint64_t hist[HIST_BUCKETS];
+} __attribute__((aligned(CACHE_LINE))) ThreadData;
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Цикл, который компилятор не выбросит, - аналог "long cycle" из mutex.c
+static inline void spin_work(long long iterations) {
+    for (long long i = 0; i < iterations; i++) {
+        __asm__ __volatile__("" ::: "memory");
+    }
+}
+
+static long futex(int* word, int op, int value) {
+    return syscall(SYS_futex, word, op, value, NULL, NULL, 0);
+}
+
+// Блокировка на futex по схеме Дреппера ("Futexes Are Tricky", mutex2):
+// свободный захват и освобождение без ожидающих обходятся без системных вызовов
+static void futex_lock(int* word) {
+    int c = 0;
+    if (__atomic_compare_exchange_n(word, &c, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return;
+    }
+    if (c != 2) {
+        c = __atomic_exchange_n(word, 2, __ATOMIC_ACQUIRE);
+    }
+    while (c != 0) {
+        futex(word, FUTEX_WAIT_PRIVATE, 2);
+        c = __atomic_exchange_n(word, 2, __ATOMIC_ACQUIRE);
+    }
+}
+
+static void futex_unlock(int* word) {
+    if (__atomic_fetch_sub(word, 1, __ATOMIC_RELEASE) != 1) {
+        __atomic_store_n(word, 0, __ATOMIC_RELEASE);
+        futex(word, FUTEX_WAKE_PRIVATE, 1);
+    }
+}
+
+static void mcs_lock(McsNode** tail, McsNode* node) {
+    node->next = NULL;
+    node->locked = 1;
+    McsNode* prev = __atomic_exchange_n(tail, node, __ATOMIC_ACQ_REL);
+    if (prev == NULL) {
+        return;
+    }
+    __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+    while (__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE)) {
+        cpu_relax();
+    }
+}
+
+static void mcs_unlock(McsNode** tail, McsNode* node) {
+    McsNode* next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+    if (next == NULL) {
+        McsNode* expected = node;
+        if (__atomic_compare_exchange_n(tail, &expected, NULL, 0, __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED)) {
+            return;
+        }
+        // Преемник уже встал в очередь, но еще не записал себя в next
+        while ((next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)) == NULL) {
+            cpu_relax();
+        }
+    }
+    __atomic_store_n(&next->locked, 0, __ATOMIC_RELEASE);
+}
+
+void lock_acquire(Lock* lock, McsNode* node) {
+    switch (lock->kind) {
+        case LOCK_MUTEX:
+            pthread_mutex_lock(&lock->mutex);
+            break;
+        case LOCK_SPIN:
+            pthread_spin_lock(&lock->spin);
+            break;
+        case LOCK_TTAS:
+            while (__atomic_exchange_n(&lock->flag, 1, __ATOMIC_ACQUIRE)) {
+                while (__atomic_load_n(&lock->flag, __ATOMIC_RELAXED)) {
+                    cpu_relax();
+                }
+            }
+            break;
+        case LOCK_TICKET: {
+            unsigned ticket = __atomic_fetch_add(&lock->next_ticket, 1, __ATOMIC_RELAXED);
+            while (__atomic_load_n(&lock->now_serving, __ATOMIC_ACQUIRE) != ticket) {
+                cpu_relax();
+            }
+            break;
+        }
+        case LOCK_MCS:
+            mcs_lock(&lock->tail, node);
+            break;
+        case LOCK_FUTEX:
+            futex_lock(&lock->futex_word);
+            break;
+        default:
+            break;
+    }
+}
+
+void lock_release(Lock* lock, McsNode* node) {
+    switch (lock->kind) {
+        case LOCK_MUTEX:
+            pthread_mutex_unlock(&lock->mutex);
+            break;
+        case LOCK_SPIN:
+            pthread_spin_unlock(&lock->spin);
+            break;
+        case LOCK_TTAS:
+            __atomic_store_n(&lock->flag, 0, __ATOMIC_RELEASE);
+            break;
+        case LOCK_TICKET:
+            // Писать now_serving может только владелец, поэтому хватает store
+            __atomic_store_n(&lock->now_serving,
+                             __atomic_load_n(&lock->now_serving, __ATOMIC_RELAXED) + 1,
+                             __ATOMIC_RELEASE);
+            break;
+        case LOCK_MCS:
+            mcs_unlock(&lock->tail, node);
+            break;
+        case LOCK_FUTEX:
+            futex_unlock(&lock->futex_word);
+            break;
+        default:
+            break;
+    }
+}
+
+void* worker(void* arg) {
+    ThreadData* data = (ThreadData*)arg;
+    Lock* lock = data->lock;
+    const BenchOptions* options = data->options;
+    long long count = 0;
+
+    pthread_barrier_wait(data->barrier);
+    while (!__atomic_load_n(data->stop, __ATOMIC_RELAXED)) {
+        int timed = count % options->sample == 0;
+        uint64_t started = 0;
+        uint64_t waited = 0;
+
+        if (lock->kind == LOCK_ATOMIC) {
+            // Защищать нечего: работа секции идет снаружи, замеряется сам инкремент
+            spin_work(options->cs_work);
+            if (timed) {
+                started = now_ns();
+            }
+            __atomic_fetch_add(&lock->common, 1, __ATOMIC_RELAXED);
+            if (timed) {
+                waited = now_ns() - started;
+            }
+        } else {
+            if (timed) {
+                started = now_ns();
+            }
+            lock_acquire(lock, &data->node);
+            if (timed) {
+                waited = now_ns() - started;
+            }
+            long long work = lock->common;
+            spin_work(options->cs_work);
+            lock->common = work + 1;
+            lock_release(lock, &data->node);
+        }
+
+        if (timed) {
+            data->hist[hist_bucket(waited)]++;
+            if (waited > data->wait_max) {
+                data->wait_max = waited;
+            }
+        }
+        count++;
+        spin_work(options->think_work);
+    }
+    data->acquisitions = count;
+    return NULL;
+}
+
+// Один прогон: pnum потоков в течение duration_ms. Возвращает 0 при успехе.
+int run_bench(LockKind kind, int pnum, const BenchOptions* options) {
+    Lock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.kind = kind;
+    if (pthread_mutex_init(&lock.mutex, NULL) != 0 ||
+        pthread_spin_init(&lock.spin, PTHREAD_PROCESS_PRIVATE) != 0) {
+        fprintf(stderr, "Ошибка инициализации блокировки\n");
+        return 1;
+    }
+
+    ThreadData* data = aligned_alloc(CACHE_LINE, pnum * sizeof(ThreadData));
+    pthread_t* threads = malloc(pnum * sizeof(pthread_t));
+    if (data == NULL || threads == NULL) {
+        fprintf(stderr, "Ошибка выделения памяти\n");
+        exit(1);
+    }
+    memset(data, 0, pnum * sizeof(ThreadData));
+
+    pthread_barrier_t barrier;
+    if (pthread_barrier_init(&barrier, NULL, pnum + 1) != 0) {
+        fprintf(stderr, "Ошибка инициализации барьера\n");
+        exit(1);
+    }
+    int stop = 0;
+
+    int created = 0;
+    for (; created < pnum; created++) {
+        data[created].lock = &lock;
+        data[created].options = options;
+        data[created].barrier = &barrier;
+        data[created].stop = &stop;
+        if (pthread_create(&threads[created], NULL, worker, &data[created]) != 0) {
+            fprintf(stderr, "Ошибка создания потока %d\n", created);
+            exit(1);
+        }
+    }
+
+    pthread_barrier_wait(&barrier);
+    uint64_t started = now_ns();
+    struct timespec pause = {options->duration_ms / 1000,
+                             (options->duration_ms % 1000) * 1000000L};
+    nanosleep(&pause, NULL);
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    for (int i = 0; i < pnum; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed = (now_ns() - started) / 1e9;
+
+    // Сводка: пропускная способность, равномерность и распределение ожидания
+    uint64_t hist[HIST_BUCKETS] = {0};
+    uint64_t wait_max = 0;
+    uint64_t samples = 0;
+    long long total = 0;
+    long long min_count = data[0].acquisitions;
+    long long max_count = data[0].acquisitions;
+    double sum_squares = 0;
+    for (int i = 0; i < pnum; i++) {
+        long long count = data[i].acquisitions;
+        total += count;
+        sum_squares += (double)count * count;
+        if (count < min_count) {
+            min_count = count;
+        }
+        if (count > max_count) {
+            max_count = count;
+        }
+        if (data[i].wait_max > wait_max) {
+            wait_max = data[i].wait_max;
+        }
+        for (int b = 0; b < HIST_BUCKETS; b++) {
+            hist[b] += data[i].hist[b];
+            samples += data[i].hist[b];
+        }
+    }
+
+    int result = 0;
+    if (lock.common != total) {
+        fprintf(stderr, "Ошибка: %s потерял обновления: счетчик %lld, захватов %lld\n",
+                lock_names[kind], lock.common, total);
+        result = 1;
+    }
+
+    // Индекс Джейна: 1 - все потоки захватывали поровну, 1/pnum - один поток
+    double jain = sum_squares > 0 ? (double)total * total / (pnum * sum_squares) : 0;
+    printf("%-7s %7d %10.3f %6.3f %10lld %10lld %8lu %8lu %8lu %10lu\n",
+           lock_names[kind], pnum, total / elapsed / 1e6, jain, min_count, max_count,
+           hist_percentile(hist, samples, wait_max, 0.5),
+           hist_percentile(hist, samples, wait_max, 0.99),
+           hist_percentile(hist, samples, wait_max, 0.999), wait_max);
+    if (options->per_thread) {
+        printf("        захваты по потокам:");
+        for (int i = 0; i < pnum; i++) {
+            printf(" %lld", data[i].acquisitions);
+        }
+        printf("\n");
+    }
+
+    pthread_barrier_destroy(&barrier);
+    pthread_spin_destroy(&lock.spin);
+    pthread_mutex_destroy(&lock.mutex);
+    free(threads);
+    free(data);
+    return result;
+}
+
+void print_usage(const char* program_name) {
+    printf("Использование: %s [--lock=<список>] [--threads=<список>] [--cs=<итераций>] "
+           "[--think=<итераций>] [--duration=<мс>] [--sample=<n>] [--per_thread]\n",
+           program_name);
+    printf("Блокировки: mutex,spin,ttas,ticket,mcs,futex,atomic или all (по умолчанию)\n");
+    printf("Пример: %s --lock=mutex,mcs --threads=1,2,4,8 --cs=100 --think=100\n",
+           program_name);
+    printf("--cs и --think задают длину цикла внутри и вне критической секции,\n");
+    printf("--sample=n замеряет ожидание только каждого n-го захвата\n");
+}
+
+// Разбирает список через запятую; возвращает 0 при ошибке
+int parse_locks(const char* list, int* selected) {
+    char* copy = strdup(list);
+    char* saveptr = NULL;
+    int ok = 1;
+    memset(selected, 0, LOCK_COUNT * sizeof(int));
+    for (char* name = strtok_r(copy, ",", &saveptr); name != NULL;
+         name = strtok_r(NULL, ",", &saveptr)) {
+        int found = 0;
+        for (int i = 0; i < LOCK_COUNT; i++) {
+            if (strcmp(name, "all") == 0 || strcmp(name, lock_names[i]) == 0) {
+                selected[i] = 1;
+                found = 1;
+            }
+        }
+        if (!found) {
+            fprintf(stderr, "Ошибка: неизвестная блокировка %s\n", name);
+            ok = 0;
+        }
+    }
+    free(copy);
+    return ok;
+}
+
+int parse_threads(const char* list, int* counts, int* n) {
+    char* copy = strdup(list);
+    char* saveptr = NULL;
+    int ok = 1;
+    *n = 0;
+    for (char* item = strtok_r(copy, ",", &saveptr); item != NULL && ok;
+         item = strtok_r(NULL, ",", &saveptr)) {
+        int count = atoi(item);
+        if (count <= 0 || count > MAX_THREADS || *n == MAX_THREADS) {
+            fprintf(stderr, "Ошибка: число потоков должно быть от 1 до %d\n", MAX_THREADS);
+            ok = 0;
+        } else {
+            counts[(*n)++] = count;
+        }
+    }
+    free(copy);
+    return ok && *n > 0;
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options = {100, 100, 1000, 1, 0};
+    int selected[LOCK_COUNT];
+    int thread_counts[MAX_THREADS];
+    int thread_runs = 0;
+    int opt;
+    int option_index = 0;
+
+    parse_locks("all", selected);
+    parse_threads("1,2,4,8", thread_counts, &thread_runs);
+
+    struct option long_options[] = {
+        {"lock", required_argument, 0, 'l'},
+        {"threads", required_argument, 0, 't'},
+        {"cs", required_argument, 0, 'c'},
+        {"think", required_argument, 0, 'w'},
+        {"duration", required_argument, 0, 'd'},
+        {"sample", required_argument, 0, 's'},
+        {"per_thread", no_argument, 0, 'P'},
+        {0, 0, 0, 0}
+    };
+
+    while ((opt = getopt_long(argc, argv, "", long_options, &option_index)) != -1) {
+        switch (opt) {
+            case 'l':
+                if (!parse_locks(optarg, selected)) {
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 't':
+                if (!parse_threads(optarg, thread_counts, &thread_runs)) {
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'c':
+                options.cs_work = atoll(optarg);
+                break;
+            case 'w':
+                options.think_work = atoll(optarg);
+                break;
+            case 'd':
+                options.duration_ms = atoi(optarg);
+                break;
+            case 's':
+                options.sample = atoi(optarg);
+                break;
+            case 'P':
+                options.per_thread = 1;
+                break;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (options.cs_work < 0 || options.think_work < 0 || options.duration_ms <= 0 ||
+        options.sample <= 0) {
+        fprintf(stderr, "Ошибка: длины циклов неотрицательны, длительность и sample положительны\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    printf("cs=%lld think=%lld duration=%dms, процессоров: %ld\n", options.cs_work,
+           options.think_work, options.duration_ms, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%-7s %7s %10s %6s %10s %10s %8s %8s %8s %10s\n", "lock", "threads", "Mops/s",
+           "jain", "min", "max", "p50ns", "p99ns", "p999ns", "maxns");
+
+    int failed = 0;
+    for (int i = 0; i < LOCK_COUNT; i++) {
+        if (!selected[i]) {
+            continue;
+        }
+        for (int t = 0; t < thread_runs; t++) {
+            failed |= run_bench((LockKind)i, thread_counts[t], &options);
+        }
+    }
+    return failed;
+}
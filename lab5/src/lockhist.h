@@ -0,0 +1,55 @@
+#ifndef LOCKHIST_H
+#define LOCKHIST_H
+
+#include <stdint.h>
+
+// Гистограмма времен для lock_bench и lockprof, как в lab6/metrics:
+// 2^HIST_SUB_BITS корзин на каждую степень двойки наносекунд, перцентиль
+// завышается не больше чем на 25%. Заголовок подключается в однофайловые
+// программы, поэтому функции static inline.
+#define HIST_SUB_BITS 2
+#define HIST_BUCKETS (64 << HIST_SUB_BITS)
+
+static inline int hist_bucket(uint64_t value) {
+    if (value < (1u << HIST_SUB_BITS)) {
+        return (int)value;
+    }
+    int msb = 63 - __builtin_clzll(value);
+    int sub = (int)(value >> (msb - HIST_SUB_BITS)) & ((1 << HIST_SUB_BITS) - 1);
+    return ((msb - HIST_SUB_BITS + 1) << HIST_SUB_BITS) + sub;
+}
+
+static inline uint64_t hist_bucket_upper(int index) {
+    if (index < (1 << HIST_SUB_BITS)) {
+        return (uint64_t)index;
+    }
+    int msb = (index >> HIST_SUB_BITS) + HIST_SUB_BITS - 1;
+    uint64_t sub = (uint64_t)(index & ((1 << HIST_SUB_BITS) - 1));
+    int shift = msb - HIST_SUB_BITS;
+    uint64_t lower = (((uint64_t)1 << HIST_SUB_BITS) + sub) << shift;
+    return lower + (((uint64_t)1 << shift) - 1);
+}
+
+// Верхняя граница корзины, в которую попадает доля q из total значений;
+// не больше наблюдавшегося максимума max
+static inline uint64_t hist_percentile(const uint64_t* hist, uint64_t total,
+                                       uint64_t max, double q) {
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(q * total);
+    if (rank >= total) {
+        rank = total - 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += hist[i];
+        if (seen > rank) {
+            uint64_t upper = hist_bucket_upper(i);
+            return upper < max ? upper : max;
+        }
+    }
+    return max;
+}
+
+#endif
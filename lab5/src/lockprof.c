@@ -0,0 +1,297 @@
+// Сборка: gcc -O2 -shared -fPIC lockprof.c -o liblockprof.so -ldl -pthread
+// Запуск: LD_PRELOAD=./liblockprof.so ./deadlock
+// (или сборка программы с -L. -llockprof: библиотека стоит раньше libc
+// и перехватывает те же символы)
+//
+// Перехватывает pthread_mutex_lock/trylock/unlock и для каждого мьютекса
+// считает захваты, захваты с ожиданием, гистограммы ожидания и удержания.
+// Порядок захвата ведется в графе "удерживался A - захвачен B"; если новое
+// ребро замыкает цикл, как у thread1/thread2 в deadlock.c, об инверсии
+// сообщается до вызова настоящего lock, то есть до зависания.
+// Сводка печатается в stderr при выходе из программы.
+//
+// Переменные окружения:
+//   LOCKPROF_ABORT=1  после сообщения об инверсии напечатать сводку и abort()
+//   LOCKPROF_TOP=n    сколько самых нагруженных мьютексов печатать (20)
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lockhist.h"
+
+// Отслеживаемых мьютексов не больше MAX_LOCKS (степень двойки): таблица и
+// граф порядка статические, чтобы перехватчик не вызывал malloc
+#define MAX_LOCKS 1024
+#define MAX_HELD 32
+#define BACKTRACE_DEPTH 16
+
+// Статистика мьютекса. Все поля, кроме key, меняются только владельцем
+// мьютекса, пока он захвачен, поэтому обходятся без атомарных операций;
+// сводка читает их без синхронизации.
+typedef struct {
+    uintptr_t key;              // адрес мьютекса, 0 - слот свободен
+    uint64_t acquisitions;
+    uint64_t contended;         // trylock не удался, пришлось ждать
+    uint64_t wait_sum;
+    uint64_t wait_max;
+    uint64_t hold_sum;
+    uint64_t hold_max;
+    uint64_t acquired_ns;       // когда захвачен текущим владельцем
+    uint64_t wait_hist[HIST_BUCKETS];
+    uint64_t hold_hist[HIST_BUCKETS];
+} LockStats;
+
+static int (*real_lock)(pthread_mutex_t*);
+static int (*real_trylock)(pthread_mutex_t*);
+static int (*real_unlock)(pthread_mutex_t*);
+
+static LockStats locks[MAX_LOCKS];
+static uint64_t untracked;      // мьютексы, не поместившиеся в таблицу
+
+// order[a][b / 64] бит b: мьютекс b захватывался, пока удерживался a.
+// Новые ребра редки, их добавление и поиск цикла идут под graph_lock.
+static uint64_t order[MAX_LOCKS][MAX_LOCKS / 64];
+static int graph_lock;
+static int abort_on_inversion;
+static int report_top = 20;
+
+// Мьютексы, удерживаемые текущим потоком
+static __thread int held[MAX_HELD];
+static __thread int held_count;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void resolve(void) {
+    real_lock = dlsym(RTLD_NEXT, "pthread_mutex_lock");
+    real_trylock = dlsym(RTLD_NEXT, "pthread_mutex_trylock");
+    real_unlock = dlsym(RTLD_NEXT, "pthread_mutex_unlock");
+    if (real_lock == NULL || real_trylock == NULL || real_unlock == NULL) {
+        fprintf(stderr, "lockprof: не найдены функции pthread_mutex_*\n");
+        abort();
+    }
+}
+
+// Слот мьютекса в таблице с открытой адресацией; -1, если таблица заполнена
+static int lookup(pthread_mutex_t* mutex) {
+    uintptr_t key = (uintptr_t)mutex;
+    unsigned start = (unsigned)((key >> 4) * 0x9E3779B97F4A7C15ULL >> 32) & (MAX_LOCKS - 1);
+    for (unsigned probe = 0; probe < MAX_LOCKS; probe++) {
+        unsigned i = (start + probe) & (MAX_LOCKS - 1);
+        uintptr_t current = __atomic_load_n(&locks[i].key, __ATOMIC_ACQUIRE);
+        if (current == key) {
+            return (int)i;
+        }
+        if (current == 0) {
+            uintptr_t expected = 0;
+            if (__atomic_compare_exchange_n(&locks[i].key, &expected, key, 0,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) ||
+                expected == key) {
+                return (int)i;
+            }
+        }
+    }
+    __atomic_fetch_add(&untracked, 1, __ATOMIC_RELAXED);
+    return -1;
+}
+
+static int has_edge(int from, int to) {
+    return (__atomic_load_n(&order[from][to / 64], __ATOMIC_RELAXED) >> (to % 64)) & 1;
+}
+
+// Есть ли путь from -> ... -> to; вызывается под graph_lock
+static int reachable(int from, int to) {
+    static int stack[MAX_LOCKS];
+    static uint64_t visited[MAX_LOCKS / 64];
+    int top = 0;
+    memset(visited, 0, sizeof(visited));
+    stack[top++] = from;
+    visited[from / 64] |= 1ULL << (from % 64);
+    while (top > 0) {
+        int node = stack[--top];
+        if (node == to) {
+            return 1;
+        }
+        for (int w = 0; w < MAX_LOCKS / 64; w++) {
+            uint64_t next = order[node][w] & ~visited[w];
+            visited[w] |= next;
+            while (next != 0) {
+                stack[top++] = w * 64 + __builtin_ctzll(next);
+                next &= next - 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static void report(void);
+
+static void report_inversion(int holding, int wanted) {
+    void* frames[BACKTRACE_DEPTH];
+    fprintf(stderr,
+            "lockprof: инверсия порядка блокировок: захватывается %p при удержании %p,\n"
+            "          а раньше %p захватывался при удержании %p - возможна взаимоблокировка\n",
+            (void*)locks[wanted].key, (void*)locks[holding].key,
+            (void*)locks[holding].key, (void*)locks[wanted].key);
+    int depth = backtrace(frames, BACKTRACE_DEPTH);
+    backtrace_symbols_fd(frames, depth, 2);
+    if (abort_on_inversion) {
+        report();
+        abort();
+    }
+}
+
+// Ребра held[*] -> index; при первом появлении ребра проверяется цикл
+static void record_order(int index) {
+    for (int h = 0; h < held_count; h++) {
+        int from = held[h];
+        if (from == index || has_edge(from, index)) {
+            continue;
+        }
+        while (__atomic_exchange_n(&graph_lock, 1, __ATOMIC_ACQUIRE)) {
+        }
+        int inversion = !has_edge(from, index) && reachable(index, from);
+        __atomic_fetch_or(&order[from][index / 64], 1ULL << (index % 64), __ATOMIC_RELAXED);
+        __atomic_store_n(&graph_lock, 0, __ATOMIC_RELEASE);
+        if (inversion) {
+            report_inversion(from, index);
+        }
+    }
+}
+
+static void on_acquired(int index, uint64_t waited, int contended) {
+    LockStats* stats = &locks[index];
+    stats->acquisitions++;
+    if (contended) {
+        stats->contended++;
+        stats->wait_sum += waited;
+        if (waited > stats->wait_max) {
+            stats->wait_max = waited;
+        }
+        stats->wait_hist[hist_bucket(waited)]++;
+    }
+    stats->acquired_ns = now_ns();
+    if (held_count < MAX_HELD) {
+        held[held_count++] = index;
+    }
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex) {
+    if (real_lock == NULL) {
+        resolve();
+    }
+    int index = lookup(mutex);
+    if (index < 0) {
+        return real_lock(mutex);
+    }
+    record_order(index);
+
+    // Свободный мьютекс берется через trylock без замера ожидания
+    if (real_trylock(mutex) == 0) {
+        on_acquired(index, 0, 0);
+        return 0;
+    }
+    uint64_t started = now_ns();
+    int result = real_lock(mutex);
+    if (result == 0) {
+        on_acquired(index, now_ns() - started, 1);
+    }
+    return result;
+}
+
+int pthread_mutex_trylock(pthread_mutex_t* mutex) {
+    if (real_trylock == NULL) {
+        resolve();
+    }
+    int result = real_trylock(mutex);
+    if (result == 0) {
+        // trylock не ждет, поэтому в граф порядка не попадает
+        int index = lookup(mutex);
+        if (index >= 0) {
+            on_acquired(index, 0, 0);
+        }
+    }
+    return result;
+}
+
+int pthread_mutex_unlock(pthread_mutex_t* mutex) {
+    if (real_unlock == NULL) {
+        resolve();
+    }
+    for (int h = held_count - 1; h >= 0; h--) {
+        LockStats* stats = &locks[held[h]];
+        if (stats->key != (uintptr_t)mutex) {
+            continue;
+        }
+        uint64_t hold = now_ns() - stats->acquired_ns;
+        stats->hold_sum += hold;
+        if (hold > stats->hold_max) {
+            stats->hold_max = hold;
+        }
+        stats->hold_hist[hist_bucket(hold)]++;
+        held[h] = held[--held_count];
+        break;
+    }
+    return real_unlock(mutex);
+}
+
+static int compare_wait(const void* a, const void* b) {
+    const LockStats* x = *(const LockStats* const*)a;
+    const LockStats* y = *(const LockStats* const*)b;
+    if (x->wait_sum != y->wait_sum) {
+        return x->wait_sum < y->wait_sum ? 1 : -1;
+    }
+    return x->acquisitions < y->acquisitions ? 1 : (x->acquisitions > y->acquisitions ? -1 : 0);
+}
+
+// Самые нагруженные мьютексы по суммарному ожиданию
+static void report(void) {
+    static LockStats* sorted[MAX_LOCKS];
+    int count = 0;
+    for (int i = 0; i < MAX_LOCKS; i++) {
+        if (locks[i].key != 0 && locks[i].acquisitions > 0) {
+            sorted[count++] = &locks[i];
+        }
+    }
+    qsort(sorted, count, sizeof(sorted[0]), compare_wait);
+
+    fprintf(stderr, "lockprof: мьютексов %d, не отслежено захватов %lu\n", count,
+            __atomic_load_n(&untracked, __ATOMIC_RELAXED));
+    fprintf(stderr, "%-18s %10s %10s %10s %10s %10s %10s %10s %10s\n", "mutex", "acq",
+            "contended", "wait_ms", "wait_p99us", "wait_max", "hold_avg", "hold_p99us",
+            "hold_max");
+    for (int i = 0; i < count && i < report_top; i++) {
+        const LockStats* s = sorted[i];
+        fprintf(stderr, "%-18p %10lu %10lu %10.3f %10.1f %10.1f %10.2f %10.1f %10.1f\n",
+                (void*)s->key, s->acquisitions, s->contended, s->wait_sum / 1e6,
+                hist_percentile(s->wait_hist, s->contended, s->wait_max, 0.99) / 1e3,
+                s->wait_max / 1e3, s->hold_sum / 1e3 / s->acquisitions,
+                hist_percentile(s->hold_hist, s->acquisitions, s->hold_max, 0.99) / 1e3,
+                s->hold_max / 1e3);
+    }
+}
+
+__attribute__((constructor)) static void lockprof_init(void) {
+    if (real_lock == NULL) {
+        resolve();
+    }
+    const char* value = getenv("LOCKPROF_ABORT");
+    abort_on_inversion = value != NULL && atoi(value) != 0;
+    value = getenv("LOCKPROF_TOP");
+    if (value != NULL && atoi(value) > 0) {
+        report_top = atoi(value);
+    }
+}
+
+__attribute__((destructor)) static void lockprof_fini(void) {
+    report();
+}
@@ -0,0 +1,32 @@
+#!/bin/sh
+# Проверка --exact на глубоком стеке произведений: --block=1 и потоков
+# больше, чем процессоров. Поток, забравший большую часть отрезков guided,
+# получает длинную цепочку убывающих произведений; результат сравнивается
+# с однопоточным.
+# Запуск из lab5/src: sh tests/test_exact.sh
+set -e
+
+K=${K:-100000}
+CPUS=$(nproc)
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+gcc -O2 factorial.c bignum.c -pthread -o "$DIR/factorial"
+"$DIR/factorial" -k "$K" --pnum=1 --exact > "$DIR/expected"
+
+status=0
+for pnum in $((CPUS * 4)) 32; do
+    for run in 1 2 3; do
+        if ! "$DIR/factorial" -k "$K" --pnum="$pnum" --exact --block=1 \
+                > "$DIR/actual" 2>&1 ||
+           ! cmp -s "$DIR/expected" "$DIR/actual"; then
+            echo "FAIL: -k $K --pnum=$pnum --exact --block=1 (run $run)"
+            status=1
+        fi
+    done
+done
+
+if [ "$status" -eq 0 ]; then
+    echo "OK: -k $K --exact --block=1 on $CPUS cpus"
+fi
+exit $status
@@ -0,0 +1,177 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <getopt.h>
+
+#include "multmodulo.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#else
+#define HAVE_RDTSC 0
+#endif
+
+// Сравнение исходного MultModulo с ModMul/ModRangeProduct на произведении
+// begin * ... * end для модулей разного размера, затем ядер
+// ModRangeProductKernel между собой
+
+// Наименьший из модулей замера. Диапазон [mod - count - 1, mod - 2]
+// должен начинаться с единицы или выше, отсюда верхняя граница --count
+#define SMALLEST_MOD 1000000007ULL
+#define MAX_COUNT (SMALLEST_MOD - 2)
+
+struct BenchModulus {
+    const char *name;
+    uint64_t mod;
+};
+
+static double NowSeconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t ProductLegacy(uint64_t begin, uint64_t end, uint64_t mod) {
+    uint64_t ans = 1;
+    for (uint64_t i = begin; i <= end; i++)
+        ans = MultModulo(ans, i, mod);
+    return ans;
+}
+
+static uint64_t ProductModMul(const struct ModContext *ctx, uint64_t begin,
+                              uint64_t end) {
+    uint64_t ans = 1 % ctx->mod;
+    for (uint64_t i = begin; i <= end; i++)
+        ans = ModMul(ctx, ans, i);
+    return ans;
+}
+
+static uint64_t ReadCycles(void) {
+#if HAVE_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Время и умножения за такт (по счетчику TSC) для каждого ядра на
+// модулях, где оно применимо; результат сверяется с последовательным
+static bool BenchKernels(const struct BenchModulus *moduli, int moduli_count,
+                         uint64_t count) {
+    bool ok = true;
+    printf("\n%-10s %-8s %12s %12s %9s\n", "modulus", "kernel", "ns/mul",
+           HAVE_RDTSC ? "mul/cycle" : "-", "speedup");
+
+    for (int m = 0; m < moduli_count; m++) {
+        uint64_t mod = moduli[m].mod;
+        uint64_t begin = mod - count - 1;
+        uint64_t end = begin + count - 1;
+        struct ModContext ctx;
+        ModContextInit(&ctx, mod);
+
+        uint64_t expected = 0;
+        double serial_ns = 0;
+        for (int k = MOD_KERNEL_SERIAL; k <= MOD_KERNEL_IFMA; k++) {
+            if (!ModKernelAvailable(&ctx, (enum ModKernel)k))
+                continue;
+            double t0 = NowSeconds();
+            uint64_t c0 = ReadCycles();
+            uint64_t result =
+                ModRangeProductKernel(&ctx, begin, end, (enum ModKernel)k);
+            uint64_t cycles = ReadCycles() - c0;
+            double ns = (NowSeconds() - t0) * 1e9 / count;
+
+            if (k == MOD_KERNEL_SERIAL) {
+                expected = result;
+                serial_ns = ns;
+            } else if (result != expected) {
+                fprintf(stderr, "Kernel %s mismatch for mod %lu: %lu %lu\n",
+                        ModKernelName((enum ModKernel)k), mod, result,
+                        expected);
+                ok = false;
+            }
+            printf("%-10s %-8s %12.3f %12.3f %8.1fx\n", moduli[m].name,
+                   ModKernelName((enum ModKernel)k), ns,
+                   cycles ? (double)count / cycles : 0.0, serial_ns / ns);
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    uint64_t count = 1000000;
+
+    while (true) {
+        static struct option options[] = {
+            {"count", required_argument, 0, 0},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        int c = getopt_long(argc, argv, "", options, &option_index);
+        if (c == -1)
+            break;
+        if (c != 0) {
+            fprintf(stderr, "Using: %s [--count 1000000]\n", argv[0]);
+            return 1;
+        }
+        count = strtoull(optarg, NULL, 10);
+        if (count == 0 || count > MAX_COUNT) {
+            fprintf(stderr, "count must be from 1 to %llu\n", MAX_COUNT);
+            return 1;
+        }
+    }
+
+    const struct BenchModulus moduli[] = {
+        {"small", SMALLEST_MOD},
+        {"32-bit", 4294967291ULL},
+        {"2^52 odd", 4503599627370449ULL},
+        {"2^64 odd", 18446744073709551557ULL},
+        {"2^64 even", 18446744073709551614ULL},
+    };
+    const int moduli_count = sizeof(moduli) / sizeof(moduli[0]);
+    bool ok = true;
+
+    printf("%-10s %-11s %12s %12s %12s %9s\n", "modulus", "kind",
+           "legacy ns", "ModMul ns", "range ns", "speedup");
+
+    for (int m = 0; m < moduli_count; m++) {
+        uint64_t mod = moduli[m].mod;
+        // Начинаем с больших чисел, чтобы множители занимали все слово
+        uint64_t begin = mod - count - 1;
+        uint64_t end = begin + count - 1;
+
+        struct ModContext ctx;
+        ModContextInit(&ctx, mod);
+
+        double t0 = NowSeconds();
+        uint64_t legacy = ProductLegacy(begin, end, mod);
+        double t1 = NowSeconds();
+        uint64_t modmul = ProductModMul(&ctx, begin, end);
+        double t2 = NowSeconds();
+        uint64_t range = ModRangeProduct(&ctx, begin, end);
+        double t3 = NowSeconds();
+
+        const char *kind = ctx.kind == MOD_KIND_BARRETT      ? "barrett"
+                           : ctx.kind == MOD_KIND_MONTGOMERY ? "montgomery"
+                                                             : "wide";
+        double legacy_ns = (t1 - t0) * 1e9 / count;
+        double modmul_ns = (t2 - t1) * 1e9 / count;
+        double range_ns = (t3 - t2) * 1e9 / count;
+
+        printf("%-10s %-11s %12.2f %12.2f %12.2f %8.1fx\n", moduli[m].name,
+               kind, legacy_ns, modmul_ns, range_ns, legacy_ns / range_ns);
+
+        if (legacy != modmul || legacy != range) {
+            fprintf(stderr, "Mismatch for mod %lu: %lu %lu %lu\n", mod,
+                    legacy, modmul, range);
+            ok = false;
+        }
+    }
+
+    ok = BenchKernels(moduli, moduli_count, count) && ok;
+    return ok ? 0 : 1;
+}
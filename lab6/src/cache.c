@@ -0,0 +1,286 @@
+#include "cache.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+static uint64_t Mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+static size_t ExactBucket(const struct RangeCache *cache, uint64_t begin,
+                          uint64_t end, uint64_t mod) {
+    return Mix(begin ^ Mix(end ^ Mix(mod))) & cache->buckets_mask;
+}
+
+static size_t EdgeBucket(const struct RangeCache *cache, uint64_t mod,
+                         uint64_t edge) {
+    return Mix(edge ^ Mix(mod)) & cache->buckets_mask;
+}
+
+static void LruUnlink(struct RangeCache *cache, int idx) {
+    struct CacheEntry *e = &cache->entries[idx];
+    if (e->lru_prev >= 0)
+        cache->entries[e->lru_prev].lru_next = e->lru_next;
+    else
+        cache->lru_head = e->lru_next;
+    if (e->lru_next >= 0)
+        cache->entries[e->lru_next].lru_prev = e->lru_prev;
+    else
+        cache->lru_tail = e->lru_prev;
+}
+
+static void LruPushFront(struct RangeCache *cache, int idx) {
+    struct CacheEntry *e = &cache->entries[idx];
+    e->lru_prev = -1;
+    e->lru_next = cache->lru_head;
+    if (cache->lru_head >= 0)
+        cache->entries[cache->lru_head].lru_prev = idx;
+    cache->lru_head = idx;
+    if (cache->lru_tail < 0)
+        cache->lru_tail = idx;
+}
+
+static void Touch(struct RangeCache *cache, int idx) {
+    if (cache->lru_head == idx)
+        return;
+    LruUnlink(cache, idx);
+    LruPushFront(cache, idx);
+}
+
+// Удаление из односвязной цепочки; field выбирает поле next_*
+#define CHAIN_UNLINK(cache, buckets, bucket, idx, field)           \
+    do {                                                           \
+        int *link = &(buckets)[bucket];                            \
+        while (*link >= 0 && *link != (idx))                       \
+            link = &(cache)->entries[*link].field;                 \
+        if (*link == (idx))                                        \
+            *link = (cache)->entries[idx].field;                   \
+    } while (0)
+
+static void Unlink(struct RangeCache *cache, int idx) {
+    struct CacheEntry *e = &cache->entries[idx];
+    size_t exact = ExactBucket(cache, e->begin, e->end, e->mod);
+    size_t by_begin = EdgeBucket(cache, e->mod, e->begin);
+    size_t by_end = EdgeBucket(cache, e->mod, e->end);
+
+    CHAIN_UNLINK(cache, cache->exact_buckets, exact, idx, next_exact);
+    CHAIN_UNLINK(cache, cache->begin_buckets, by_begin, idx, next_begin);
+    CHAIN_UNLINK(cache, cache->end_buckets, by_end, idx, next_end);
+    LruUnlink(cache, idx);
+}
+
+static int FindExact(const struct RangeCache *cache, uint64_t begin,
+                     uint64_t end, uint64_t mod) {
+    int idx = cache->exact_buckets[ExactBucket(cache, begin, end, mod)];
+    while (idx >= 0) {
+        const struct CacheEntry *e = &cache->entries[idx];
+        if (e->begin == begin && e->end == end && e->mod == mod)
+            return idx;
+        idx = e->next_exact;
+    }
+    return -1;
+}
+
+// Самый длинный кусок [begin, x] с x <= limit
+static int FindLongestFrom(const struct RangeCache *cache, uint64_t mod,
+                           uint64_t begin, uint64_t limit) {
+    int best = -1;
+    int idx = cache->begin_buckets[EdgeBucket(cache, mod, begin)];
+    while (idx >= 0) {
+        const struct CacheEntry *e = &cache->entries[idx];
+        if (e->mod == mod && e->begin == begin && e->end <= limit &&
+            (best < 0 || e->end > cache->entries[best].end))
+            best = idx;
+        idx = e->next_begin;
+    }
+    return best;
+}
+
+// Самый длинный кусок [x, end] с x >= limit
+static int FindLongestTo(const struct RangeCache *cache, uint64_t mod,
+                         uint64_t end, uint64_t limit) {
+    int best = -1;
+    int idx = cache->end_buckets[EdgeBucket(cache, mod, end)];
+    while (idx >= 0) {
+        const struct CacheEntry *e = &cache->entries[idx];
+        if (e->mod == mod && e->end == end && e->begin >= limit &&
+            (best < 0 || e->begin < cache->entries[best].begin))
+            best = idx;
+        idx = e->next_end;
+    }
+    return best;
+}
+
+int CacheInit(struct RangeCache *cache, size_t capacity) {
+    size_t buckets = 1;
+    while (buckets < capacity * 2)
+        buckets *= 2;
+
+    pthread_mutex_init(&cache->mutex, NULL);
+    cache->capacity = capacity;
+    cache->size = 0;
+    cache->buckets_mask = buckets - 1;
+    cache->entries = malloc(sizeof(struct CacheEntry) * capacity);
+    cache->exact_buckets = malloc(sizeof(int) * buckets);
+    cache->begin_buckets = malloc(sizeof(int) * buckets);
+    cache->end_buckets = malloc(sizeof(int) * buckets);
+    if (cache->entries == NULL || cache->exact_buckets == NULL ||
+        cache->begin_buckets == NULL || cache->end_buckets == NULL) {
+        CacheDestroy(cache);
+        return -1;
+    }
+
+    for (size_t i = 0; i < buckets; i++) {
+        cache->exact_buckets[i] = -1;
+        cache->begin_buckets[i] = -1;
+        cache->end_buckets[i] = -1;
+    }
+    for (size_t i = 0; i < capacity; i++)
+        cache->entries[i].lru_next = (i + 1 < capacity) ? (int)i + 1 : -1;
+    cache->free_head = capacity > 0 ? 0 : -1;
+    cache->lru_head = -1;
+    cache->lru_tail = -1;
+
+    cache->stats.hits = 0;
+    cache->stats.partial = 0;
+    cache->stats.misses = 0;
+    cache->stats.evictions = 0;
+    return 0;
+}
+
+void CacheDestroy(struct RangeCache *cache) {
+    pthread_mutex_destroy(&cache->mutex);
+    free(cache->entries);
+    free(cache->exact_buckets);
+    free(cache->begin_buckets);
+    free(cache->end_buckets);
+    cache->entries = NULL;
+    cache->exact_buckets = NULL;
+    cache->begin_buckets = NULL;
+    cache->end_buckets = NULL;
+}
+
+uint64_t CacheCover(struct RangeCache *cache, const struct ModContext *ctx,
+                    uint64_t begin, uint64_t end, uint64_t *rest_begin,
+                    uint64_t *rest_end) {
+    uint64_t mod = ctx->mod;
+    uint64_t product = 1 % mod;
+    bool covered = false;
+    bool found_any = false;
+
+    pthread_mutex_lock(&cache->mutex);
+
+    int idx = FindExact(cache, begin, end, mod);
+    if (idx >= 0) {
+        Touch(cache, idx);
+        cache->stats.hits++;
+        product = cache->entries[idx].value;
+        pthread_mutex_unlock(&cache->mutex);
+        *rest_begin = 1;
+        *rest_end = 0;
+        return product;
+    }
+
+    // Куски с начала диапазона
+    uint64_t low = begin;
+    while ((idx = FindLongestFrom(cache, mod, low, end)) >= 0) {
+        const struct CacheEntry *e = &cache->entries[idx];
+        product = ModMul(ctx, product, e->value);
+        found_any = true;
+        Touch(cache, idx);
+        if (e->end == end) {
+            covered = true;
+            break;
+        }
+        low = e->end + 1;
+    }
+
+    // Куски с конца диапазона
+    uint64_t high = end;
+    while (!covered && (idx = FindLongestTo(cache, mod, high, low)) >= 0) {
+        const struct CacheEntry *e = &cache->entries[idx];
+        product = ModMul(ctx, product, e->value);
+        found_any = true;
+        Touch(cache, idx);
+        if (e->begin == low) {
+            covered = true;
+            break;
+        }
+        high = e->begin - 1;
+    }
+
+    if (covered)
+        cache->stats.hits++;
+    else if (found_any)
+        cache->stats.partial++;
+    else
+        cache->stats.misses++;
+    pthread_mutex_unlock(&cache->mutex);
+
+    if (covered) {
+        *rest_begin = 1;
+        *rest_end = 0;
+    } else {
+        *rest_begin = low;
+        *rest_end = high;
+    }
+    return product;
+}
+
+void CacheInsert(struct RangeCache *cache, uint64_t begin, uint64_t end,
+                 uint64_t mod, uint64_t value) {
+    if (cache->capacity == 0)
+        return;
+
+    pthread_mutex_lock(&cache->mutex);
+
+    int idx = FindExact(cache, begin, end, mod);
+    if (idx >= 0) {
+        cache->entries[idx].value = value;
+        Touch(cache, idx);
+        pthread_mutex_unlock(&cache->mutex);
+        return;
+    }
+
+    if (cache->free_head >= 0) {
+        idx = cache->free_head;
+        cache->free_head = cache->entries[idx].lru_next;
+        cache->size++;
+    } else {
+        idx = cache->lru_tail;
+        Unlink(cache, idx);
+        cache->stats.evictions++;
+    }
+
+    struct CacheEntry *e = &cache->entries[idx];
+    e->begin = begin;
+    e->end = end;
+    e->mod = mod;
+    e->value = value;
+
+    size_t exact = ExactBucket(cache, begin, end, mod);
+    size_t by_begin = EdgeBucket(cache, mod, begin);
+    size_t by_end = EdgeBucket(cache, mod, end);
+    e->next_exact = cache->exact_buckets[exact];
+    cache->exact_buckets[exact] = idx;
+    e->next_begin = cache->begin_buckets[by_begin];
+    cache->begin_buckets[by_begin] = idx;
+    e->next_end = cache->end_buckets[by_end];
+    cache->end_buckets[by_end] = idx;
+    LruPushFront(cache, idx);
+
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+void CacheGetStats(struct RangeCache *cache, struct CacheStats *stats) {
+    pthread_mutex_lock(&cache->mutex);
+    *stats = cache->stats;
+    stats->size = cache->size;
+    stats->capacity = cache->capacity;
+    pthread_mutex_unlock(&cache->mutex);
+}
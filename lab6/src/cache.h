@@ -0,0 +1,72 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "multmodulo.h"
+
+// Диапазоны короче этого не кэшируются: посчитать их дешевле поиска
+#define CACHE_MIN_NUMBERS 1024
+
+struct CacheEntry {
+    uint64_t begin;
+    uint64_t end;
+    uint64_t mod;
+    uint64_t value;
+
+    // Индексы в массиве записей, -1 - конец списка
+    int lru_prev;
+    int lru_next;
+    int next_exact;  // цепочка по (begin, end, mod)
+    int next_begin;  // цепочка по (mod, begin)
+    int next_end;    // цепочка по (mod, end)
+};
+
+struct CacheStats {
+    uint64_t hits;      // запрос целиком найден в кэше
+    uint64_t partial;   // часть запроса собрана из сохраненных кусков
+    uint64_t misses;    // ничего не нашлось
+    uint64_t evictions;
+    size_t size;
+    size_t capacity;
+};
+
+// Ограниченный потокобезопасный LRU-кэш произведений диапазонов.
+// Все записи выделяются при создании, вставка не выделяет память.
+struct RangeCache {
+    pthread_mutex_t mutex;
+    struct CacheEntry *entries;
+    size_t capacity;
+    size_t size;
+
+    int *exact_buckets;
+    int *begin_buckets;
+    int *end_buckets;
+    size_t buckets_mask;
+
+    int lru_head;  // самая свежая запись
+    int lru_tail;  // кандидат на вытеснение
+    int free_head; // список свободных записей через lru_next
+
+    struct CacheStats stats;
+};
+
+int CacheInit(struct RangeCache *cache, size_t capacity);
+void CacheDestroy(struct RangeCache *cache);
+
+// Собирает begin..end из сохраненных кусков: самые длинные куски,
+// начинающиеся в begin, и куски, заканчивающиеся в end. Возвращает их
+// произведение, а непокрытую середину пишет в [*rest_begin, *rest_end]
+// (пусто, если *rest_begin > *rest_end).
+uint64_t CacheCover(struct RangeCache *cache, const struct ModContext *ctx,
+                    uint64_t begin, uint64_t end, uint64_t *rest_begin,
+                    uint64_t *rest_end);
+
+void CacheInsert(struct RangeCache *cache, uint64_t begin, uint64_t end,
+                 uint64_t mod, uint64_t value);
+
+void CacheGetStats(struct RangeCache *cache, struct CacheStats *stats);
+
+#endif
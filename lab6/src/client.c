@@ -3,31 +3,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <pthread.h>
-#include <arpa/inet.h>
 
 #include <errno.h>
 #include <getopt.h>
-#include <netdb.h>
-#include <netinet/in.h>
-#include <netinet/ip.h>
-#include <sys/socket.h>
-#include <sys/types.h>
 
+#include "fanout.h"
 #include "multmodulo.h"
-
-struct Server {
-    char ip[255];
-    int port;
-};
-
-struct ThreadArgs {
-    struct Server server;
-    uint64_t begin;
-    uint64_t end;
-    uint64_t mod;
-    uint64_t result;
-};
+#include "planner.h"
+#include "protocol.h"
 
 bool ConvertStringToUI64(const char *str, uint64_t *val) {
     char *end = NULL;
@@ -42,72 +25,53 @@ bool ConvertStringToUI64(const char *str, uint64_t *val) {
     return true;
 }
 
-void *ThreadServer(void *args) {
-    struct ThreadArgs *targs = (struct ThreadArgs *)args;
-    
-    struct hostent *hostname = gethostbyname(targs->server.ip);
-    if (hostname == NULL) {
-        fprintf(stderr, "gethostbyname failed with %s\n", targs->server.ip);
-        targs->result = 1;
-        return NULL;
-    }
-
-    struct sockaddr_in server;
-    server.sin_family = AF_INET;
-    server.sin_port = htons(targs->server.port);
-    
-    // Исправление: используем h_addr_list вместо h_addr
-    if (hostname->h_addr_list[0] != NULL) {
-        memcpy(&server.sin_addr.s_addr, hostname->h_addr_list[0], hostname->h_length);
-    } else {
-        fprintf(stderr, "No address found for %s\n", targs->server.ip);
-        targs->result = 1;
-        return NULL;
-    }
-
-    int sck = socket(AF_INET, SOCK_STREAM, 0);
-    if (sck < 0) {
-        fprintf(stderr, "Socket creation failed!\n");
-        targs->result = 1;
-        return NULL;
-    }
+// Запрашивает у сервера кадр статистики и печатает его
+bool QueryStats(const struct Server *server, int timeout_ms) {
+    int sck = FanoutConnect(server, timeout_ms);
+    if (sck < 0)
+        return false;
 
-    if (connect(sck, (struct sockaddr *)&server, sizeof(server)) < 0) {
-        fprintf(stderr, "Connection failed to %s:%d\n", 
-                targs->server.ip, targs->server.port);
-        close(sck);
-        targs->result = 1;
-        return NULL;
+    char buffer[PROTO_HEADER_SIZE + PROTO_STATS_SIZE];
+    struct ProtoHeader header;
+    ProtoEncodeHeader(buffer, PROTO_STATS_REQUEST, 0);
+    bool ok = SendAll(sck, buffer, PROTO_HEADER_SIZE) > 0 &&
+              RecvAll(sck, buffer, PROTO_HEADER_SIZE) > 0;
+    if (ok) {
+        ProtoDecodeHeader(buffer, &header);
+        // Более новый сервер может прислать больше полей, чем известно
+        ok = ProtoIsHeader(buffer) &&
+             header.type == PROTO_STATS_RESPONSE &&
+             header.count >= PROTO_STATS_FIELDS &&
+             header.count <= PROTO_MAX_COUNT;
     }
-
-    char task[sizeof(uint64_t) * 3];
-    memcpy(task, &targs->begin, sizeof(uint64_t));
-    memcpy(task + sizeof(uint64_t), &targs->end, sizeof(uint64_t));
-    memcpy(task + 2 * sizeof(uint64_t), &targs->mod, sizeof(uint64_t));
-
-    if (send(sck, task, sizeof(task), 0) < 0) {
-        fprintf(stderr, "Send failed to %s:%d\n", 
-                targs->server.ip, targs->server.port);
-        close(sck);
-        targs->result = 1;
-        return NULL;
+    struct ProtoStats stats;
+    if (ok) {
+        size_t size = (size_t)header.count * sizeof(uint64_t);
+        char *fields = malloc(size);
+        ok = fields != NULL && RecvAll(sck, fields, size) > 0;
+        if (ok)
+            ProtoDecodeStats(fields, header.count, &stats);
+        free(fields);
     }
-
-    char response[sizeof(uint64_t)];
-    if (recv(sck, response, sizeof(response), 0) < 0) {
-        fprintf(stderr, "Receive failed from %s:%d\n", 
-                targs->server.ip, targs->server.port);
-        close(sck);
-        targs->result = 1;
-        return NULL;
+    close(sck);
+    if (!ok) {
+        fprintf(stderr, "Stats request failed with %s:%d\n", server->ip,
+                server->port);
+        return false;
     }
 
-    uint64_t answer = 0;
-    memcpy(&answer, response, sizeof(uint64_t));
-    targs->result = answer;
-
-    close(sck);
-    return NULL;
+    printf("Server %s:%d: uptime %.1fs, requests=%lu errors=%lu\n",
+           server->ip, server->port, stats.uptime_us / 1e6, stats.requests,
+           stats.errors);
+    printf("  connections active=%lu total=%lu, bytes in=%lu out=%lu\n",
+           stats.connections_active, stats.connections_total, stats.bytes_in,
+           stats.bytes_out);
+    printf("  latency p50=%luus p99=%luus max=%luus\n", stats.latency_p50_us,
+           stats.latency_p99_us, stats.latency_max_us);
+    printf("  compute p50=%luus p99=%luus, queue wait p50=%luus p99=%luus\n",
+           stats.compute_p50_us, stats.compute_p99_us,
+           stats.queue_wait_p50_us, stats.queue_wait_p99_us);
+    return true;
 }
 
 int main(int argc, char **argv) {
@@ -115,6 +79,14 @@ int main(int argc, char **argv) {
     uint64_t mod = 0;
     char servers_path[255] = {'\0'};
     bool k_set = false, mod_set = false, servers_set = false;
+    int protocol = 2;
+    uint32_t chunks = 1;
+    bool dynamic = false;
+    int inflight = 2;
+    uint64_t min_chunk = 1000;
+    int timeout_ms = 0;
+    double hedge_percentile = 0;
+    bool query_stats = false;
 
     while (true) {
         int current_optind = optind ? optind : 1;
@@ -123,6 +95,14 @@ int main(int argc, char **argv) {
             {"k", required_argument, 0, 0},
             {"mod", required_argument, 0, 0},
             {"servers", required_argument, 0, 0},
+            {"protocol", required_argument, 0, 0},
+            {"chunks", required_argument, 0, 0},
+            {"schedule", required_argument, 0, 0},
+            {"inflight", required_argument, 0, 0},
+            {"min-chunk", required_argument, 0, 0},
+            {"timeout", required_argument, 0, 0},
+            {"hedge", required_argument, 0, 0},
+            {"stats", no_argument, 0, 0},
             {0, 0, 0, 0}
         };
 
@@ -154,6 +134,65 @@ int main(int argc, char **argv) {
                         servers_path[strlen(optarg)] = '\0';
                         servers_set = true;
                         break;
+                    case 3:
+                        protocol = atoi(optarg);
+                        if (protocol != 1 && protocol != 2) {
+                            fprintf(stderr, "protocol must be 1 or 2\n");
+                            return 1;
+                        }
+                        break;
+                    case 4: {
+                        uint64_t value = 0;
+                        if (!ConvertStringToUI64(optarg, &value) ||
+                            value == 0 || value > PROTO_MAX_COUNT) {
+                            fprintf(stderr, "chunks must be in [1, %d]\n",
+                                    PROTO_MAX_COUNT);
+                            return 1;
+                        }
+                        chunks = (uint32_t)value;
+                    } break;
+                    case 5:
+                        if (strcmp(optarg, "static") == 0) {
+                            dynamic = false;
+                        } else if (strcmp(optarg, "dynamic") == 0) {
+                            dynamic = true;
+                        } else {
+                            fprintf(stderr,
+                                    "schedule must be static or dynamic\n");
+                            return 1;
+                        }
+                        break;
+                    case 6:
+                        inflight = atoi(optarg);
+                        if (inflight <= 0) {
+                            fprintf(stderr, "inflight must be positive\n");
+                            return 1;
+                        }
+                        break;
+                    case 7:
+                        if (!ConvertStringToUI64(optarg, &min_chunk) ||
+                            min_chunk == 0) {
+                            fprintf(stderr, "min-chunk must be positive\n");
+                            return 1;
+                        }
+                        break;
+                    case 8:
+                        timeout_ms = atoi(optarg);
+                        if (timeout_ms < 0) {
+                            fprintf(stderr, "timeout must be non-negative\n");
+                            return 1;
+                        }
+                        break;
+                    case 9:
+                        hedge_percentile = atof(optarg);
+                        if (hedge_percentile < 0 || hedge_percentile >= 100) {
+                            fprintf(stderr, "hedge must be in [0, 100)\n");
+                            return 1;
+                        }
+                        break;
+                    case 10:
+                        query_stats = true;
+                        break;
                     default:
                         printf("Index %d is out of options\n", option_index);
                 }
@@ -166,9 +205,15 @@ int main(int argc, char **argv) {
         }
     }
 
-    if (!k_set || !mod_set || !servers_set) {
-        fprintf(stderr, "Using: %s --k 1000 --mod 5 --servers /path/to/file\n",
-                argv[0]);
+    // С --stats k и mod не нужны: опрашиваются только счетчики серверов
+    if (!servers_set || (!query_stats && (!k_set || !mod_set))) {
+        fprintf(stderr,
+                "Using: %s --k 1000 --mod 5 --servers /path/to/file "
+                "[--protocol 1|2] [--chunks 1] [--schedule static|dynamic] "
+                "[--inflight 2] [--min-chunk 1000] [--timeout MS] "
+                "[--hedge PERCENTILE]\n"
+                "       %s --stats --servers /path/to/file\n",
+                argv[0], argv[0]);
         return 1;
     }
 
@@ -178,24 +223,42 @@ int main(int argc, char **argv) {
         return 1;
     }
 
-    struct Server servers[100];
+    // Список серверов не ограничен по размеру
+    struct Server *servers = NULL;
     int servers_count = 0;
-    char line[255];
+    int servers_cap = 0;
+    char *line = NULL;
+    size_t line_cap = 0;
 
-    while (fgets(line, sizeof(line), servers_file) && servers_count < 100) {
-        line[strcspn(line, "\n")] = 0;
+    while (getline(&line, &line_cap, servers_file) > 0) {
+        line[strcspn(line, "\r\n")] = 0;
+        if (line[0] == '\0')
+            continue;
         
-        char *colon = strchr(line, ':');
+        char *colon = strrchr(line, ':');
         if (colon == NULL) {
             fprintf(stderr, "Invalid server format: %s\n", line);
             continue;
         }
         
+        if (servers_count == servers_cap) {
+            servers_cap = servers_cap ? servers_cap * 2 : 16;
+            struct Server *grown =
+                realloc(servers, servers_cap * sizeof(struct Server));
+            if (grown == NULL) {
+                fprintf(stderr, "Out of memory for servers list\n");
+                return 1;
+            }
+            servers = grown;
+        }
+
         *colon = '\0';
         strncpy(servers[servers_count].ip, line, 254);
+        servers[servers_count].ip[254] = '\0';
         servers[servers_count].port = atoi(colon + 1);
         servers_count++;
     }
+    free(line);
     fclose(servers_file);
 
     if (servers_count == 0) {
@@ -203,47 +266,104 @@ int main(int argc, char **argv) {
         return 1;
     }
 
-    pthread_t threads[servers_count];
-    struct ThreadArgs thread_args[servers_count];
-    
-    uint64_t numbers_per_server = k / servers_count;
-    uint64_t remainder = k % servers_count;
-    uint64_t current_start = 1;
+    if (query_stats) {
+        bool all_ok = true;
+        for (int i = 0; i < servers_count; i++)
+            all_ok = QueryStats(&servers[i], timeout_ms) && all_ok;
+        free(servers);
+        return all_ok ? 0 : 1;
+    }
 
-    for (int i = 0; i < servers_count; i++) {
-        thread_args[i].server = servers[i];
-        thread_args[i].begin = current_start;
-        
-        thread_args[i].end = current_start + numbers_per_server - 1;
-        if ((uint64_t)i < remainder) {  // Приведение типов для сравнения
-            thread_args[i].end++;
-        }
-        
-        if (thread_args[i].end > k) {
-            thread_args[i].end = k;
+    if (dynamic && protocol != 2) {
+        fprintf(stderr, "Dynamic schedule needs protocol 2\n");
+        return 1;
+    }
+
+    struct ModContext ctx;
+    ModContextInit(&ctx, mod);
+
+    // Дешевые случаи (k >= mod, делимость, теорема Вильсона) решаются до
+    // обращения к серверам; им раздаются только куски плана
+    struct FactPlan plan;
+    FactPlanInit(&plan, &ctx, 1, k);
+
+    struct FanoutOptions opts;
+    opts.ctx = &plan.ctx;
+    opts.protocol = protocol;
+    opts.chunks = chunks;
+    opts.dynamic = dynamic;
+    opts.inflight = inflight;
+    opts.min_chunk = min_chunk;
+    opts.timeout_ms = timeout_ms;
+    opts.hedge_percentile = hedge_percentile;
+
+    struct FanoutServerStats *stats =
+        calloc(servers_count, sizeof(struct FanoutServerStats));
+    struct FanoutServerStats *range_stats =
+        calloc(servers_count, sizeof(struct FanoutServerStats));
+    if (stats == NULL || range_stats == NULL) {
+        fprintf(stderr, "Out of memory for servers list\n");
+        return 1;
+    }
+
+    uint64_t product = 1 % plan.ctx.mod;
+    struct FanoutTotals totals = {0, 0, 0, 0};
+    int err = 0;
+    for (int r = 0; r < plan.ranges_count && err == 0; r++) {
+        if (plan.begin[r] > plan.end[r])
+            continue;
+        opts.begin = plan.begin[r];
+        opts.end = plan.end[r];
+
+        // Отказавший сервер не получает следующих диапазонов
+        for (int i = 0; i < servers_count; i++) {
+            range_stats[i].chunks_done = 0;
+            range_stats[i].numbers_done = 0;
+            range_stats[i].failed = stats[i].failed;
         }
-        
-        thread_args[i].mod = mod;
-        thread_args[i].result = 1;
-        
-        current_start = thread_args[i].end + 1;
-        
-        if (pthread_create(&threads[i], NULL, ThreadServer, 
-                           (void *)&thread_args[i]) != 0) {
-            fprintf(stderr, "Failed to create thread for server %d\n", i);
-            thread_args[i].result = 1;
+
+        uint64_t range_result = 0;
+        struct FanoutTotals range_totals;
+        err = RunFanout(servers, servers_count, &opts, &range_result,
+                        range_stats, &range_totals);
+        product = ModMul(&plan.ctx, product, range_result);
+
+        for (int i = 0; i < servers_count; i++) {
+            stats[i].chunks_done += range_stats[i].chunks_done;
+            stats[i].numbers_done += range_stats[i].numbers_done;
+            stats[i].failed = stats[i].failed || range_stats[i].failed;
         }
+        totals.reassigned += range_totals.reassigned;
+        totals.hedged += range_totals.hedged;
+        totals.hedge_wins += range_totals.hedge_wins;
+        totals.paths |= range_totals.paths;
     }
+    uint64_t final_result = FactPlanFinish(&plan, product);
 
-    for (int i = 0; i < servers_count; i++) {
-        pthread_join(threads[i], NULL);
+    bool any_failed = false;
+    for (int i = 0; i < servers_count; i++)
+        any_failed = any_failed || stats[i].failed;
+    if ((dynamic || any_failed) && !plan.ready) {
+        for (int i = 0; i < servers_count; i++)
+            printf("Server %s:%d: %lu chunks, %lu numbers%s\n",
+                   servers[i].ip, servers[i].port, stats[i].chunks_done,
+                   stats[i].numbers_done, stats[i].failed ? " (failed)" : "");
     }
+    if (totals.reassigned > 0 || totals.hedged > 0)
+        printf("Reassigned %lu chunks, hedged %lu (%lu won)\n",
+               totals.reassigned, totals.hedged, totals.hedge_wins);
+    free(stats);
+    free(range_stats);
+    free(servers);
 
-    uint64_t final_result = 1;
-    for (int i = 0; i < servers_count; i++) {
-        final_result = MultModulo(final_result, thread_args[i].result, mod);
+    if (err != 0) {
+        fprintf(stderr, "Some servers failed, result is incomplete\n");
+        return 1;
     }
 
+    char path[64];
+    FactPathFormat(plan.path | totals.paths, path, sizeof(path));
+    printf("Path: %s\n", path);
     printf("Result: %lu\n", final_result);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,217 @@
+#include "compute.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int RangeRequestInit(struct RangeRequest *req, int threads_count) {
+    req->partial = malloc(sizeof(uint64_t) * threads_count);
+    if (req->partial == NULL)
+        return -1;
+    req->tasks = 0;
+    req->cache = NULL;
+    req->owner = NULL;
+    req->next = NULL;
+    return 0;
+}
+
+void RangeRequestDestroy(struct RangeRequest *req) {
+    free(req->partial);
+    req->partial = NULL;
+}
+
+// Запоминает результат запроса и, если он собирался из кусков, отдельно
+// посчитанную середину
+static void StoreInCache(struct RangeRequest *req, uint64_t rest_value) {
+    if (req->cache == NULL)
+        return;
+    CacheInsert(req->cache, req->begin, req->end, req->ctx.mod, req->result);
+    if ((req->rest_begin != req->begin || req->rest_end != req->end) &&
+        req->rest_end - req->rest_begin + 1 >= CACHE_MIN_NUMBERS)
+        CacheInsert(req->cache, req->rest_begin, req->rest_end, req->ctx.mod,
+                    rest_value);
+}
+
+// Делит tasks задач между кусками плана пропорционально их длине; каждый
+// непустой кусок получает хотя бы одну задачу. Возвращает сумму долей.
+static int SplitPlan(const struct FactPlan *plan, uint64_t range,
+                     uint64_t tasks, uint64_t *shares) {
+    uint64_t tasks_left = tasks;
+    uint64_t range_left = range;
+    int total = 0;
+
+    for (int r = 0; r < plan->ranges_count; r++) {
+        shares[r] = 0;
+        if (plan->begin[r] > plan->end[r])
+            continue;
+        uint64_t numbers = plan->end[r] - plan->begin[r] + 1;
+        range_left -= numbers;
+        uint64_t reserve = range_left > 0 ? 1 : 0;
+        uint64_t share = reserve == 0
+                             ? tasks_left
+                             : (uint64_t)((double)tasks * numbers / range + 0.5);
+        if (share > tasks_left - reserve)
+            share = tasks_left - reserve;
+        if (share == 0)
+            share = 1;
+        if (share > numbers)
+            share = numbers;
+        tasks_left -= share;
+        shares[r] = share;
+        total += (int)share;
+    }
+    return total;
+}
+
+static void SubmitPlan(struct WorkerPool *pool, struct RangeRequest *req,
+                       const uint64_t *shares) {
+    const struct FactPlan *plan = &req->plan;
+    int submitted = 0;
+
+    for (int r = 0; r < plan->ranges_count; r++) {
+        if (shares[r] == 0)
+            continue;
+        uint64_t numbers = plan->end[r] - plan->begin[r] + 1;
+        uint64_t numbers_per_task = numbers / shares[r];
+        uint64_t remainder = numbers % shares[r];
+        uint64_t current = plan->begin[r];
+
+        for (uint64_t i = 0; i < shares[r]; i++) {
+            struct PoolTask task;
+            task.begin = current;
+            task.end = current + numbers_per_task - 1;
+            if (i < remainder)
+                task.end++;
+            task.plan = plan;
+            task.result = &req->partial[submitted++];
+            task.batch = &req->batch;
+            current = task.end + 1;
+
+            req->path |= FactUseSublinear(plan, task.end - task.begin + 1)
+                             ? FACT_PATH_SUBLINEAR
+                             : FACT_PATH_LINEAR;
+            PoolSubmit(pool, &task);
+        }
+    }
+}
+
+bool RangeRequestStart(const struct ComputeEngine *engine,
+                       struct RangeRequest *req, PoolBatchCallback on_done) {
+    struct WorkerPool *pool = engine->pool;
+    const struct ModContext *ctx = &req->ctx;
+    uint64_t begin = req->begin;
+    uint64_t end = req->end;
+
+    req->tasks = 0;
+    req->cache = NULL;
+    req->cached = 1 % ctx->mod;
+    req->path = 0;
+    if (begin > end) {
+        req->result = 1 % ctx->mod;
+        req->path = FACT_PATH_LINEAR;
+        return true;
+    }
+    if (end - begin >= ctx->mod - 1) {
+        req->result = 0;
+        req->path = FACT_PATH_ZERO;
+        return true;
+    }
+
+    if (engine->cache != NULL && end - begin + 1 >= CACHE_MIN_NUMBERS) {
+        req->cache = engine->cache;
+        req->cached = CacheCover(engine->cache, ctx, begin, end, &begin, &end);
+        if (begin != req->begin || end != req->end)
+            req->path |= FACT_PATH_CACHED;
+        if (begin > end) {
+            req->result = req->cached;
+            req->cache = NULL;
+            return true;
+        }
+    }
+    req->rest_begin = begin;
+    req->rest_end = end;
+
+    // Дешевые случаи и выбор модуля для кусков
+    struct FactPlan *plan = &req->plan;
+    FactPlanInit(plan, ctx, begin, end);
+    req->path |= plan->path;
+    if (plan->ready) {
+        req->result = ModMul(ctx, req->cached, plan->value);
+        StoreInCache(req, plan->value);
+        return true;
+    }
+
+    uint64_t range = 0;
+    for (int r = 0; r < plan->ranges_count; r++) {
+        if (plan->begin[r] <= plan->end[r])
+            range += plan->end[r] - plan->begin[r] + 1;
+    }
+    uint64_t tasks = (range + MIN_TASK_NUMBERS - 1) / MIN_TASK_NUMBERS;
+    if (tasks > (uint64_t)pool->threads_count)
+        tasks = pool->threads_count;
+    if (tasks <= 1) {
+        uint64_t started = MetricsNow();
+        uint64_t product = 1 % plan->ctx.mod;
+        for (int r = 0; r < plan->ranges_count; r++)
+            product = ModMul(&plan->ctx, product,
+                             FactRangeProduct(plan, plan->begin[r],
+                                              plan->end[r]));
+        HistRecord(&engine->metrics->compute, MetricsNow() - started);
+        uint64_t rest = FactPlanFinish(plan, product);
+        req->path |= FACT_PATH_LINEAR;
+        req->result = ModMul(ctx, req->cached, rest);
+        StoreInCache(req, rest);
+        return true;
+    }
+
+    uint64_t shares[2];
+    req->tasks = SplitPlan(plan, range, tasks, shares);
+    PoolBatchInit(&req->batch, req->tasks, on_done, req);
+    SubmitPlan(pool, req, shares);
+    return false;
+}
+
+void RangeRequestFinish(struct RangeRequest *req) {
+    PoolBatchDestroy(&req->batch);
+
+    const struct FactPlan *plan = &req->plan;
+    uint64_t product = 1 % plan->ctx.mod;
+    for (int i = 0; i < req->tasks; i++)
+        product = ModMul(&plan->ctx, product, req->partial[i]);
+    uint64_t rest = FactPlanFinish(plan, product);
+    req->result = ModMul(&req->ctx, req->cached, rest);
+    StoreInCache(req, rest);
+}
+
+uint64_t Factorial(const struct ComputeEngine *engine,
+                   const struct ModContext *ctx, uint64_t begin, uint64_t end,
+                   uint32_t *path) {
+    uint64_t partial[engine->pool->threads_count];
+    struct RangeRequest req;
+    req.ctx = *ctx;
+    req.begin = begin;
+    req.end = end;
+    req.partial = partial;
+
+    if (!RangeRequestStart(engine, &req, NULL)) {
+        PoolBatchWait(&req.batch);
+        RangeRequestFinish(&req);
+    }
+    if (path != NULL)
+        *path = req.path;
+    return req.result;
+}
+
+void EngineFillStats(const struct ComputeEngine *engine,
+                     struct ProtoStats *stats) {
+    const struct ServerMetrics *pool_metrics = engine->pool->metrics;
+    if (pool_metrics == NULL || pool_metrics == engine->metrics) {
+        MetricsFillStats(engine->metrics, stats);
+        return;
+    }
+    struct ServerMetrics merged;
+    memset(&merged, 0, sizeof(merged));
+    MetricsMerge(&merged, engine->metrics);
+    MetricsMerge(&merged, pool_metrics);
+    merged.started_ns = engine->metrics->started_ns;
+    MetricsFillStats(&merged, stats);
+}
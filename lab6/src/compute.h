@@ -0,0 +1,76 @@
+#ifndef COMPUTE_H
+#define COMPUTE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cache.h"
+#include "metrics.h"
+#include "multmodulo.h"
+#include "planner.h"
+#include "pool.h"
+
+// Диапазоны короче этого считаются в вызывающем потоке без передачи в пул
+#define MIN_TASK_NUMBERS 4096
+
+// Все, что нужно для вычисления запросов: пул и необязательный кэш
+// (в режиме --shards у каждого шарда свой движок с общими пулом и кэшем)
+struct ComputeEngine {
+    struct WorkerPool *pool;
+    struct RangeCache *cache;       // NULL, если кэш выключен
+    struct ServerMetrics *metrics;  // обязателен: счетчики и кадр статистики
+    bool log_requests;              // печатать строку на каждую задачу
+};
+
+// Один запрос (begin, end, mod), разбитый на задачи для пула
+struct RangeRequest {
+    struct ModContext ctx;
+    uint64_t begin;
+    uint64_t end;
+    uint64_t result;
+
+    // Часть запроса, найденная в кэше, и оставшийся для пула диапазон
+    uint64_t cached;
+    uint64_t rest_begin;
+    uint64_t rest_end;
+    struct RangeCache *cache;
+
+    // План для оставшегося диапазона и флаги FACT_PATH_* для ответа
+    struct FactPlan plan;
+    uint32_t path;
+
+    int tasks;
+    uint64_t *partial;  // pool->threads_count ячеек, выделяется один раз
+    struct PoolBatch batch;
+
+    uint64_t started_ns;  // время приема задачи для гистограммы задержки
+    uint64_t id;  // идентификатор запроса в протоколе версии 2
+    bool legacy;  // запрос пришел старым 24-байтным кадром
+    void *owner;  // данные вызывающего кода (например, соединение)
+    struct RangeRequest *next;
+};
+
+int RangeRequestInit(struct RangeRequest *req, int threads_count);
+void RangeRequestDestroy(struct RangeRequest *req);
+
+// Начинает вычисление. Возвращает true, если результат уже готов (короткий
+// диапазон или тривиальный случай), иначе on_done будет вызван рабочим
+// потоком, после чего нужно вызвать RangeRequestFinish.
+bool RangeRequestStart(const struct ComputeEngine *engine,
+                       struct RangeRequest *req, PoolBatchCallback on_done);
+
+// Собирает частичные произведения в req->result и сохраняет его в кэш
+void RangeRequestFinish(struct RangeRequest *req);
+
+// Кадр статистики соединения: счетчики engine->metrics вместе с
+// ожиданием и временем вычисления из общего пула, если у пула свои метрики
+void EngineFillStats(const struct ComputeEngine *engine,
+                     struct ProtoStats *stats);
+
+// Синхронное вычисление begin * ... * end mod ctx->mod на пуле; path -
+// NULL или флаги выбранного пути
+uint64_t Factorial(const struct ComputeEngine *engine,
+                   const struct ModContext *ctx, uint64_t begin, uint64_t end,
+                   uint32_t *path);
+
+#endif
@@ -0,0 +1,876 @@
+#define _GNU_SOURCE
+#include "fanout.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "protocol.h"
+#include "schedule.h"
+
+#define MAX_EVENTS 256
+#define IN_BUFFER_SIZE 4096
+
+// Период проверки сроков и хеджирования, мс
+#define TICK_MS 10
+
+// Сколько ответов нужно, чтобы перцентиль задержки имел смысл. Пока их
+// меньше (например, по куску на каждый из нескольких серверов), копию
+// получает только последний незавершенный кусок, и только когда он
+// считается дольше самого медленного из полученных ответов
+#define HEDGE_MIN_SAMPLES 5
+
+enum PeerState {
+    PEER_CONNECTING,
+    PEER_READY,
+    PEER_FAILED,
+    PEER_CLOSED
+};
+
+// Кусок диапазона; может считаться сразу на нескольких серверах
+struct Task {
+    uint64_t begin;
+    uint64_t end;
+    bool done;
+    int copies;         // сколько серверов считают его сейчас
+    double first_sent;  // время первой отправки, мс
+};
+
+// Кусок, выданный серверу; id в протоколе - индекс в массиве
+struct PendingRange {
+    size_t task;
+    double sent_at;
+    bool sent;
+    bool done;   // ответ получен или кусок отобран у сервера
+    bool hedge;  // это копия медленного куска
+};
+
+struct Peer {
+    const struct Server *server;
+    struct sockaddr_in addr;
+    int fd;
+    enum PeerState state;
+    uint32_t events;
+    double connect_started;
+
+    struct PendingRange *ranges;
+    size_t ranges_count;
+    size_t ranges_cap;
+    size_t first_open;  // все куски до этого индекса завершены
+    size_t first_unsent;
+    int outstanding;
+
+    char *out;
+    size_t out_len;
+    size_t out_sent;
+    size_t out_cap;
+
+    char in[IN_BUFFER_SIZE];
+    size_t in_len;
+    uint32_t reply_remaining;  // записи текущего кадра ответа
+
+    struct FanoutServerStats stats;
+};
+
+struct Fanout {
+    const struct FanoutOptions *opts;
+    struct RangeScheduler scheduler;
+    int epoll_fd;
+    int active;  // соединения в состоянии CONNECTING или READY
+
+    struct Peer *peers;
+    int peers_count;
+
+    struct Task *tasks;
+    size_t tasks_count;
+    size_t tasks_cap;
+    size_t tasks_done;
+
+    // Куски, оставшиеся без сервера после сбоя
+    size_t *orphans;
+    size_t orphans_count;
+    size_t orphans_cap;
+
+    // Задержки полученных ответов для перцентиля хеджирования, мс
+    double *latencies;
+    size_t latencies_count;
+    size_t latencies_cap;
+
+    uint64_t total;
+    struct FanoutTotals totals;
+};
+
+static double NowMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// Увеличивает массив *items до вместимости не меньше count + 1
+static bool Grow(void **items, size_t *cap, size_t count, size_t item_size) {
+    if (count < *cap)
+        return true;
+    size_t new_cap = *cap ? *cap * 2 : 16;
+    void *p = realloc(*items, new_cap * item_size);
+    if (p == NULL)
+        return false;
+    *items = p;
+    *cap = new_cap;
+    return true;
+}
+
+// Кэш разрешения имен: каждый хост из списка разрешается один раз
+struct HostEntry {
+    const char *host;
+    struct in_addr addr;
+    bool ok;
+};
+
+struct HostCache {
+    struct HostEntry *entries;
+    size_t mask;
+};
+
+static uint64_t HashString(const char *s) {
+    uint64_t h = 1469598103934665603ULL;
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static int HostCacheInit(struct HostCache *cache, int servers_count) {
+    size_t size = 16;
+    while (size < (size_t)servers_count * 2)
+        size *= 2;
+    cache->entries = calloc(size, sizeof(struct HostEntry));
+    cache->mask = size - 1;
+    return cache->entries == NULL ? -1 : 0;
+}
+
+static bool HostCacheResolve(struct HostCache *cache, const char *host,
+                             struct in_addr *addr) {
+    size_t i = HashString(host) & cache->mask;
+    while (cache->entries[i].host != NULL) {
+        if (strcmp(cache->entries[i].host, host) == 0) {
+            *addr = cache->entries[i].addr;
+            return cache->entries[i].ok;
+        }
+        i = (i + 1) & cache->mask;
+    }
+
+    struct HostEntry *entry = &cache->entries[i];
+    entry->host = host;
+    entry->ok = FanoutResolve(host, &entry->addr);
+    *addr = entry->addr;
+    return entry->ok;
+}
+
+bool FanoutResolve(const char *host, struct in_addr *addr) {
+    // getaddrinfo потокобезопасен, в отличие от gethostbyname
+    struct addrinfo hints;
+    struct addrinfo *info = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, NULL, &hints, &info) != 0 || info == NULL) {
+        fprintf(stderr, "No address found for %s\n", host);
+        return false;
+    }
+    *addr = ((struct sockaddr_in *)info->ai_addr)->sin_addr;
+    freeaddrinfo(info);
+    return true;
+}
+
+int FanoutConnect(const struct Server *server, int timeout_ms) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(server->port);
+    if (!FanoutResolve(server->ip, &addr.sin_addr))
+        return -1;
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Socket creation failed for %s:%d\n", server->ip,
+                server->port);
+        return -1;
+    }
+
+    // Неблокирующий connect, чтобы недоступный сервер не держал клиента
+    // дольше timeout_ms
+    int err = connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+    if (err < 0 && errno == EINPROGRESS) {
+        struct pollfd pfd = {.fd = fd, .events = POLLOUT};
+        int ready;
+        do {
+            ready = poll(&pfd, 1, timeout_ms > 0 ? timeout_ms : -1);
+        } while (ready < 0 && errno == EINTR);
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (ready == 1 &&
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0 &&
+            error == 0)
+            err = 0;
+    }
+    if (err < 0) {
+        fprintf(stderr, "Connection failed to %s:%d\n", server->ip,
+                server->port);
+        close(fd);
+        return -1;
+    }
+
+    // Дальше обмен блокирующий, но не дольше timeout_ms на операцию
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    if (timeout_ms > 0) {
+        struct timeval tv;
+        tv.tv_sec = timeout_ms / 1000;
+        tv.tv_usec = (timeout_ms % 1000) * 1000;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    }
+    return fd;
+}
+
+// Тысячи соединений упираются в мягкий лимит дескрипторов
+static void RaiseFileLimit(int needed) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0)
+        return;
+    if (limit.rlim_cur >= (rlim_t)needed)
+        return;
+    limit.rlim_cur = (limit.rlim_max == RLIM_INFINITY ||
+                      limit.rlim_max >= (rlim_t)needed)
+                         ? (rlim_t)needed
+                         : limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+}
+
+static void SetInterest(struct Fanout *fan, struct Peer *peer,
+                        uint32_t events) {
+    if (peer->events == events)
+        return;
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = peer;
+    epoll_ctl(fan->epoll_fd, EPOLL_CTL_MOD, peer->fd, &ev);
+    peer->events = events;
+}
+
+static bool Reserve(char **buf, size_t *cap, size_t needed) {
+    if (needed <= *cap)
+        return true;
+    size_t new_cap = *cap ? *cap * 2 : 256;
+    while (new_cap < needed)
+        new_cap *= 2;
+    char *p = realloc(*buf, new_cap);
+    if (p == NULL)
+        return false;
+    *buf = p;
+    *cap = new_cap;
+    return true;
+}
+
+static bool NewTask(struct Fanout *fan, uint64_t begin, uint64_t end,
+                    size_t *index) {
+    if (!Grow((void **)&fan->tasks, &fan->tasks_cap, fan->tasks_count,
+              sizeof(struct Task)))
+        return false;
+    struct Task *task = &fan->tasks[fan->tasks_count];
+    task->begin = begin;
+    task->end = end;
+    task->done = false;
+    task->copies = 0;
+    task->first_sent = 0;
+    *index = fan->tasks_count++;
+    return true;
+}
+
+// Закрепляет кусок за сервером; отправляется он в EncodeUnsent
+static bool AssignTask(struct Fanout *fan, struct Peer *peer, size_t task,
+                       bool hedge) {
+    if (!Grow((void **)&peer->ranges, &peer->ranges_cap, peer->ranges_count,
+              sizeof(struct PendingRange)))
+        return false;
+    struct PendingRange *r = &peer->ranges[peer->ranges_count++];
+    r->task = task;
+    r->sent_at = 0;
+    r->sent = false;
+    r->done = false;
+    r->hedge = hedge;
+    peer->outstanding++;
+    fan->tasks[task].copies++;
+    return true;
+}
+
+// Кладет в выходной буфер кадр со всеми еще не отправленными кусками
+static bool EncodeUnsent(struct Fanout *fan, struct Peer *peer) {
+    size_t first = peer->first_unsent;
+    size_t count = peer->ranges_count - first;
+    if (count == 0 || peer->state != PEER_READY)
+        return true;
+
+    if (peer->out_sent == peer->out_len) {
+        peer->out_len = 0;
+        peer->out_sent = 0;
+    }
+
+    uint64_t mod = fan->opts->ctx->mod;
+    size_t size = fan->opts->protocol == 1
+                      ? count * LEGACY_FRAME_SIZE
+                      : PROTO_HEADER_SIZE + count * PROTO_TASK_SIZE;
+    if (!Reserve(&peer->out, &peer->out_cap, peer->out_len + size))
+        return false;
+    char *p = peer->out + peer->out_len;
+    if (fan->opts->protocol == 2) {
+        ProtoEncodeHeader(p, PROTO_REQUEST, (uint32_t)count);
+        p += PROTO_HEADER_SIZE;
+    }
+
+    double now = NowMs();
+    for (size_t i = first; i < peer->ranges_count; i++) {
+        struct PendingRange *r = &peer->ranges[i];
+        struct Task *task = &fan->tasks[r->task];
+        r->sent = true;
+        r->sent_at = now;
+        if (task->first_sent == 0)
+            task->first_sent = now;
+
+        if (fan->opts->protocol == 1) {
+            memcpy(p, &task->begin, sizeof(uint64_t));
+            memcpy(p + sizeof(uint64_t), &task->end, sizeof(uint64_t));
+            memcpy(p + 2 * sizeof(uint64_t), &mod, sizeof(uint64_t));
+            p += LEGACY_FRAME_SIZE;
+        } else {
+            struct ProtoTask wire;
+            wire.id = i;
+            wire.begin = task->begin;
+            wire.end = task->end;
+            wire.mod = mod;
+            ProtoEncodeTask(p, &wire);
+            p += PROTO_TASK_SIZE;
+        }
+    }
+    peer->out_len += size;
+    peer->first_unsent = peer->ranges_count;
+    return true;
+}
+
+static int PeerLimit(const struct Fanout *fan) {
+    // Старые кадры без id, поэтому по ним держим не больше одного куска
+    return fan->opts->protocol == 1 ? 1 : fan->opts->inflight;
+}
+
+// Выдает серверу осиротевшие куски, а в динамическом режиме - новые из
+// планировщика, пока не достигнут лимит
+static bool IssueWork(struct Fanout *fan, struct Peer *peer) {
+    if (peer->state != PEER_READY && peer->state != PEER_CONNECTING)
+        return true;
+
+    while (peer->outstanding < PeerLimit(fan)) {
+        if (fan->orphans_count > 0) {
+            size_t task = fan->orphans[--fan->orphans_count];
+            if (fan->tasks[task].done || fan->tasks[task].copies > 0)
+                continue;
+            if (!AssignTask(fan, peer, task, false))
+                return false;
+            fan->totals.reassigned++;
+            continue;
+        }
+
+        uint64_t begin, end;
+        size_t task;
+        if (!fan->opts->dynamic ||
+            !SchedulerNext(&fan->scheduler, &begin, &end))
+            break;
+        if (!NewTask(fan, begin, end, &task) ||
+            !AssignTask(fan, peer, task, false))
+            return false;
+    }
+
+    return EncodeUnsent(fan, peer);
+}
+
+static void Flush(struct Fanout *fan, struct Peer *peer);
+
+// Отбирает у сервера все незавершенные куски и отдает их остальным
+static void FailPeer(struct Fanout *fan, struct Peer *peer,
+                     const char *reason) {
+    if (peer->state == PEER_FAILED || peer->state == PEER_CLOSED)
+        return;
+
+    fprintf(stderr, "%s %s:%d\n", reason, peer->server->ip,
+            peer->server->port);
+    if (peer->fd >= 0) {
+        epoll_ctl(fan->epoll_fd, EPOLL_CTL_DEL, peer->fd, NULL);
+        close(peer->fd);
+        peer->fd = -1;
+    }
+    if (peer->state == PEER_CONNECTING || peer->state == PEER_READY)
+        fan->active--;
+    peer->state = PEER_FAILED;
+    peer->stats.failed = true;
+
+    for (size_t i = peer->first_open; i < peer->ranges_count; i++) {
+        struct PendingRange *r = &peer->ranges[i];
+        if (r->done)
+            continue;
+        r->done = true;
+        struct Task *task = &fan->tasks[r->task];
+        task->copies--;
+        if (!task->done && task->copies == 0 &&
+            Grow((void **)&fan->orphans, &fan->orphans_cap,
+                 fan->orphans_count, sizeof(size_t)))
+            fan->orphans[fan->orphans_count++] = r->task;
+    }
+    peer->outstanding = 0;
+
+    // Свободные сервера сразу забирают осиротевшие куски
+    for (int i = 0; i < fan->peers_count && fan->orphans_count > 0; i++) {
+        struct Peer *other = &fan->peers[i];
+        if (other->state != PEER_READY)
+            continue;
+        if (!IssueWork(fan, other))
+            FailPeer(fan, other, "Out of memory for");
+        else
+            Flush(fan, other);
+    }
+}
+
+static void Flush(struct Fanout *fan, struct Peer *peer) {
+    if (peer->state != PEER_READY)
+        return;
+    while (peer->out_sent < peer->out_len) {
+        ssize_t sent = send(peer->fd, peer->out + peer->out_sent,
+                            peer->out_len - peer->out_sent, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            if (errno == EINTR)
+                continue;
+            FailPeer(fan, peer, "Send failed to");
+            return;
+        }
+        peer->out_sent += sent;
+    }
+    SetInterest(fan, peer,
+                EPOLLIN | (peer->out_sent < peer->out_len ? EPOLLOUT : 0));
+}
+
+static bool AcceptReply(struct Fanout *fan, struct Peer *peer, uint64_t id,
+                        uint64_t value, uint32_t info) {
+    if (id >= peer->ranges_count || !peer->ranges[id].sent ||
+        peer->ranges[id].done)
+        return false;
+
+    struct PendingRange *r = &peer->ranges[id];
+    struct Task *task = &fan->tasks[r->task];
+    r->done = true;
+    peer->outstanding--;
+    task->copies--;
+    while (peer->first_open < peer->ranges_count &&
+           peer->ranges[peer->first_open].done)
+        peer->first_open++;
+
+    // Ответ второй копии того же куска просто отбрасывается
+    if (task->done)
+        return true;
+    fan->totals.paths |= info;
+    task->done = true;
+    fan->tasks_done++;
+    peer->stats.chunks_done++;
+    peer->stats.numbers_done += task->end - task->begin + 1;
+    fan->total = ModMul(fan->opts->ctx, fan->total, value);
+    if (r->hedge)
+        fan->totals.hedge_wins++;
+
+    if (Grow((void **)&fan->latencies, &fan->latencies_cap,
+             fan->latencies_count, sizeof(double)))
+        fan->latencies[fan->latencies_count++] = NowMs() - r->sent_at;
+    return true;
+}
+
+static bool ParseReplies(struct Fanout *fan, struct Peer *peer) {
+    size_t offset = 0;
+    bool ok = true;
+
+    while (ok) {
+        const char *data = peer->in + offset;
+        size_t available = peer->in_len - offset;
+
+        if (fan->opts->protocol == 1) {
+            if (available < LEGACY_REPLY_SIZE)
+                break;
+            uint64_t value;
+            memcpy(&value, data, sizeof(value));
+            offset += LEGACY_REPLY_SIZE;
+            // Ответы на старые кадры идут по порядку отправки
+            ok = AcceptReply(fan, peer, peer->first_open, value, 0);
+            continue;
+        }
+
+        if (peer->reply_remaining > 0) {
+            if (available < PROTO_REPLY_SIZE)
+                break;
+            struct ProtoReply reply;
+            ProtoDecodeReply(data, &reply);
+            offset += PROTO_REPLY_SIZE;
+            peer->reply_remaining--;
+            if (reply.status != PROTO_OK) {
+                fprintf(stderr, "Bad reply %lu (status %u)\n", reply.id,
+                        reply.status);
+                ok = false;
+                break;
+            }
+            ok = AcceptReply(fan, peer, reply.id, reply.result, reply.info);
+            continue;
+        }
+
+        if (available < PROTO_HEADER_SIZE)
+            break;
+        struct ProtoHeader header;
+        ProtoDecodeHeader(data, &header);
+        if (!ProtoIsHeader(data) || header.type != PROTO_RESPONSE) {
+            ok = false;
+            break;
+        }
+        offset += PROTO_HEADER_SIZE;
+        peer->reply_remaining = header.count;
+    }
+
+    memmove(peer->in, peer->in + offset, peer->in_len - offset);
+    peer->in_len -= offset;
+    return ok;
+}
+
+static void HandleConnected(struct Fanout *fan, struct Peer *peer) {
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (getsockopt(peer->fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0 ||
+        error != 0) {
+        FailPeer(fan, peer, "Connection failed to");
+        return;
+    }
+
+    peer->state = PEER_READY;
+    if (!IssueWork(fan, peer)) {
+        FailPeer(fan, peer, "Out of memory for");
+        return;
+    }
+    Flush(fan, peer);
+}
+
+static void HandleReadable(struct Fanout *fan, struct Peer *peer) {
+    while (peer->in_len < IN_BUFFER_SIZE) {
+        ssize_t n = recv(peer->fd, peer->in + peer->in_len,
+                         IN_BUFFER_SIZE - peer->in_len, 0);
+        if (n == 0) {
+            FailPeer(fan, peer, "Connection closed by");
+            return;
+        }
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            if (errno == EINTR)
+                continue;
+            FailPeer(fan, peer, "Receive failed from");
+            return;
+        }
+        peer->in_len += n;
+        if (!ParseReplies(fan, peer)) {
+            FailPeer(fan, peer, "Wrong reply from");
+            return;
+        }
+    }
+
+    if (!IssueWork(fan, peer)) {
+        FailPeer(fan, peer, "Out of memory for");
+        return;
+    }
+    Flush(fan, peer);
+}
+
+static void StartConnect(struct Fanout *fan, struct Peer *peer) {
+    peer->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    peer->state = PEER_CONNECTING;
+    peer->connect_started = NowMs();
+    fan->active++;
+    if (peer->fd < 0) {
+        FailPeer(fan, peer, "Socket creation failed for");
+        return;
+    }
+
+    int err = connect(peer->fd, (struct sockaddr *)&peer->addr,
+                      sizeof(peer->addr));
+    if (err < 0 && errno != EINPROGRESS) {
+        FailPeer(fan, peer, "Connection failed to");
+        return;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLOUT;
+    ev.data.ptr = peer;
+    peer->events = EPOLLOUT;
+    epoll_ctl(fan->epoll_fd, EPOLL_CTL_ADD, peer->fd, &ev);
+}
+
+// Сервер, не ответивший на самый старый кусок (или не подключившийся)
+// за timeout_ms, считается сбойным
+static void CheckDeadlines(struct Fanout *fan, double now) {
+    double timeout = fan->opts->timeout_ms;
+    if (timeout <= 0)
+        return;
+
+    for (int i = 0; i < fan->peers_count; i++) {
+        struct Peer *peer = &fan->peers[i];
+        if (peer->state == PEER_CONNECTING) {
+            if (now - peer->connect_started > timeout)
+                FailPeer(fan, peer, "Connection timeout to");
+            continue;
+        }
+        if (peer->state != PEER_READY || peer->outstanding == 0)
+            continue;
+        const struct PendingRange *oldest = &peer->ranges[peer->first_open];
+        if (oldest->sent && now - oldest->sent_at > timeout)
+            FailPeer(fan, peer, "Deadline exceeded by");
+    }
+}
+
+static int CompareDouble(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Простаивающие сервера получают копии кусков, которые считаются дольше
+// заданного перцентиля задержки
+static void CheckHedges(struct Fanout *fan, double now) {
+    double percentile = fan->opts->hedge_percentile;
+    if (percentile <= 0 || fan->latencies_count == 0)
+        return;
+    bool few = fan->latencies_count < HEDGE_MIN_SAMPLES;
+    if (few && (fan->tasks_done + 1 != fan->tasks_count ||
+                (fan->opts->dynamic && !fan->scheduler.exhausted)))
+        return;
+
+    double *sorted = malloc(fan->latencies_count * sizeof(double));
+    if (sorted == NULL)
+        return;
+    memcpy(sorted, fan->latencies, fan->latencies_count * sizeof(double));
+    qsort(sorted, fan->latencies_count, sizeof(double), CompareDouble);
+    size_t rank = few ? fan->latencies_count - 1
+                      : (size_t)(percentile / 100.0 *
+                                 (fan->latencies_count - 1));
+    double delay = sorted[rank];
+    free(sorted);
+
+    for (int i = 0; i < fan->peers_count; i++) {
+        struct Peer *peer = &fan->peers[i];
+        if (peer->state != PEER_READY || peer->outstanding > 0)
+            continue;
+
+        // Самый давно отправленный кусок, у которого еще нет копии
+        size_t slowest = fan->tasks_count;
+        for (size_t t = 0; t < fan->tasks_count; t++) {
+            const struct Task *task = &fan->tasks[t];
+            if (task->done || task->copies != 1 || task->first_sent == 0 ||
+                now - task->first_sent <= delay)
+                continue;
+            if (slowest == fan->tasks_count ||
+                task->first_sent < fan->tasks[slowest].first_sent)
+                slowest = t;
+        }
+        if (slowest == fan->tasks_count)
+            return;
+
+        if (!AssignTask(fan, peer, slowest, true) ||
+            !EncodeUnsent(fan, peer)) {
+            FailPeer(fan, peer, "Out of memory for");
+            continue;
+        }
+        fan->totals.hedged++;
+        Flush(fan, peer);
+    }
+}
+
+static bool Complete(const struct Fanout *fan) {
+    return fan->tasks_done == fan->tasks_count &&
+           (!fan->opts->dynamic || fan->scheduler.exhausted);
+}
+
+int RunFanout(const struct Server *servers, int servers_count,
+              const struct FanoutOptions *opts, uint64_t *result,
+              struct FanoutServerStats *stats, struct FanoutTotals *totals) {
+    struct Fanout fan;
+    memset(&fan, 0, sizeof(fan));
+    fan.opts = opts;
+    fan.total = 1 % opts->ctx->mod;
+    fan.peers_count = servers_count;
+    fan.epoll_fd = epoll_create1(0);
+    if (fan.epoll_fd < 0) {
+        fprintf(stderr, "Can not create epoll instance\n");
+        return 1;
+    }
+    SchedulerInit(&fan.scheduler, opts->begin, opts->end, servers_count,
+                  opts->min_chunk);
+    RaiseFileLimit(servers_count + 64);
+
+    fan.peers = calloc(servers_count, sizeof(struct Peer));
+    struct HostCache hosts;
+    if (fan.peers == NULL || HostCacheInit(&hosts, servers_count) != 0) {
+        fprintf(stderr, "Out of memory for %d servers\n", servers_count);
+        free(fan.peers);
+        close(fan.epoll_fd);
+        return 1;
+    }
+
+    // Сервера, отказавшие на прошлых диапазонах, не подключаются снова
+    int live_count = 0;
+    for (int i = 0; i < servers_count; i++) {
+        struct Peer *peer = &fan.peers[i];
+        peer->server = &servers[i];
+        peer->fd = -1;
+        if (stats != NULL && stats[i].failed) {
+            peer->state = PEER_FAILED;
+            peer->stats.failed = true;
+        } else {
+            live_count++;
+        }
+    }
+    if (live_count == 0) {
+        fprintf(stderr, "No live servers left\n");
+        free(fan.peers);
+        free(hosts.entries);
+        SchedulerDestroy(&fan.scheduler);
+        close(fan.epoll_fd);
+        return 1;
+    }
+
+    uint64_t numbers = opts->end - opts->begin + 1;
+    uint64_t numbers_per_server = numbers / live_count;
+    uint64_t remainder = numbers % live_count;
+    uint64_t current_start = opts->begin;
+    uint64_t live_index = 0;
+    bool ok = true;
+
+    for (int i = 0; i < servers_count && ok; i++) {
+        struct Peer *peer = &fan.peers[i];
+        if (peer->state == PEER_FAILED)
+            continue;
+        peer->state = PEER_CONNECTING;
+        fan.active++;
+
+        // В статическом режиме доля сервера закрепляется за ним сразу
+        // и уйдет одним кадром после подключения
+        uint64_t share_begin = current_start;
+        uint64_t share_end = current_start + numbers_per_server - 1;
+        if (live_index++ < remainder)
+            share_end++;
+        current_start = share_end + 1;
+
+        if (!opts->dynamic && share_begin <= share_end) {
+            uint64_t range = share_end - share_begin + 1;
+            uint64_t chunks = opts->protocol == 1 ? 1 : opts->chunks;
+            if (chunks > range)
+                chunks = range;
+            uint64_t per_chunk = range / chunks;
+            uint64_t rest = range % chunks;
+            uint64_t current = share_begin;
+            for (uint64_t c = 0; c < chunks && ok; c++) {
+                uint64_t end = current + per_chunk - 1;
+                if (c < rest)
+                    end++;
+                size_t task;
+                ok = NewTask(&fan, current, end, &task) &&
+                     AssignTask(&fan, peer, task, false);
+                current = end + 1;
+            }
+        }
+    }
+
+    for (int i = 0; i < servers_count && ok; i++) {
+        struct Peer *peer = &fan.peers[i];
+        if (peer->state == PEER_FAILED)
+            continue;
+        fan.active--;
+        peer->addr.sin_family = AF_INET;
+        peer->addr.sin_port = htons(servers[i].port);
+        if (!HostCacheResolve(&hosts, servers[i].ip, &peer->addr.sin_addr)) {
+            peer->state = PEER_READY;
+            fan.active++;
+            FailPeer(&fan, peer, "Can not resolve");
+            continue;
+        }
+        StartConnect(&fan, peer);
+    }
+
+    bool use_ticks = opts->timeout_ms > 0 || opts->hedge_percentile > 0;
+    struct epoll_event events[MAX_EVENTS];
+    while (ok && !Complete(&fan) && fan.active > 0) {
+        int ready = epoll_wait(fan.epoll_fd, events, MAX_EVENTS,
+                               use_ticks ? TICK_MS : -1);
+        if (ready < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "epoll_wait failed\n");
+            break;
+        }
+
+        for (int i = 0; i < ready; i++) {
+            struct Peer *peer = (struct Peer *)events[i].data.ptr;
+            if (peer->state == PEER_CONNECTING) {
+                HandleConnected(&fan, peer);
+                continue;
+            }
+            if (peer->state != PEER_READY)
+                continue;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                HandleReadable(&fan, peer);
+            if (peer->state == PEER_READY && (events[i].events & EPOLLOUT))
+                Flush(&fan, peer);
+        }
+
+        if (use_ticks) {
+            double now = NowMs();
+            CheckDeadlines(&fan, now);
+            CheckHedges(&fan, now);
+        }
+    }
+
+    bool complete = ok && Complete(&fan);
+    for (int i = 0; i < servers_count; i++) {
+        if (fan.peers[i].fd >= 0)
+            close(fan.peers[i].fd);
+        if (stats != NULL)
+            stats[i] = fan.peers[i].stats;
+        free(fan.peers[i].ranges);
+        free(fan.peers[i].out);
+    }
+    if (totals != NULL)
+        *totals = fan.totals;
+
+    free(fan.peers);
+    free(fan.tasks);
+    free(fan.orphans);
+    free(fan.latencies);
+    free(hosts.entries);
+    SchedulerDestroy(&fan.scheduler);
+    close(fan.epoll_fd);
+
+    *result = fan.total;
+    return complete ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+#ifndef FANOUT_H
+#define FANOUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <netinet/in.h>
+
+#include "multmodulo.h"
+
+struct Server {
+    char ip[255];
+    int port;
+};
+
+struct FanoutOptions {
+    uint64_t begin;  // диапазон [begin, end], begin <= end
+    uint64_t end;
+    const struct ModContext *ctx;
+    int protocol;        // 1 - старый кадр, 2 - пакет задач с id
+    uint32_t chunks;     // на сколько задач делить долю сервера (static)
+    bool dynamic;        // куски раздаются из общего планировщика
+    int inflight;        // лимит кусков в работе на сервер (dynamic)
+    uint64_t min_chunk;  // минимальный кусок планировщика (dynamic)
+
+    // Срок ответа на кусок (и на установку соединения) в мс, 0 - без срока.
+    // Сервер, не уложившийся в срок, считается сбойным, его куски
+    // передаются другим серверам.
+    int timeout_ms;
+    // Хеджирование: если кусок считается дольше этого перцентиля уже
+    // полученных ответов, его копия уходит простаивающему серверу и
+    // берется первый ответ. 0 - выключено.
+    double hedge_percentile;
+};
+
+// Итоги по одному серверу
+struct FanoutServerStats {
+    uint64_t chunks_done;   // куски, ответ на которые вошел в результат
+    uint64_t numbers_done;  // числа в этих кусках
+    bool failed;
+};
+
+// Итоги повторных отправок
+struct FanoutTotals {
+    uint64_t reassigned;  // куски, переданные другому серверу после сбоя
+    uint64_t hedged;      // отправленные копии медленных кусков
+    uint64_t hedge_wins;  // копии, ответившие раньше оригинала
+    uint32_t paths;       // флаги FACT_PATH_* из ответов серверов
+};
+
+// Разрешает имя через getaddrinfo (только IPv4); так же разрешаются
+// адреса в RunFanout. При ошибке печатает сообщение и возвращает false.
+bool FanoutResolve(const char *host, struct in_addr *addr);
+
+// Соединяется с сервером неблокирующим connect не дольше timeout_ms
+// (0 - без срока) и возвращает блокирующий сокет, у которого прием и
+// отправка ограничены тем же сроком, или -1.
+int FanoutConnect(const struct Server *server, int timeout_ms);
+
+// Раздает [begin, end] серверам из одного потока: адреса разрешаются один раз,
+// соединения устанавливаются неблокирующим connect, весь обмен идет
+// через один epoll. stats - массив на servers_count элементов или NULL;
+// сервер с stats[i].failed на входе считается сбойным сразу и не получает
+// работы, так что отказ переносится между вызовами. totals - NULL или
+// структура для итогов. Возвращает 0, если посчитан весь диапазон.
+int RunFanout(const struct Server *servers, int servers_count,
+              const struct FanoutOptions *opts, uint64_t *result,
+              struct FanoutServerStats *stats, struct FanoutTotals *totals);
+
+#endif
@@ -0,0 +1,576 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <getopt.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include "metrics.h"
+#include "protocol.h"
+
+#define MAX_CONNECTIONS 1024
+#define MAX_MODS 16
+#define MAX_PIPELINE 1024
+
+// Ответ дольше этого считается потерянным, и прогон завершается с ошибкой
+#define RECV_TIMEOUT_SEC 10
+
+// Начала диапазонов выбираются случайно из [1, BEGIN_SPREAD], чтобы
+// запросы не попадали в кэш сервера
+#define BEGIN_SPREAD 1000000000ULL
+
+enum OutputFormat { FORMAT_TEXT, FORMAT_CSV, FORMAT_JSON };
+
+struct LoadConfig {
+    struct sockaddr_in addr;
+    int connections;
+    bool connect_each;   // новое соединение на каждый запрос
+    double rate;         // запросов в секунду на все соединения, 0 - closed loop
+    int pipeline;        // запросов в полете на соединение в closed loop
+    uint64_t range_min;  // чисел в одном запросе
+    uint64_t range_max;
+    uint64_t mods[MAX_MODS];
+    int mods_count;
+    uint64_t seed;
+
+    // Окна по монотонным часам: разогрев [start, measure), замер
+    // [measure, end); задержка засчитывается по времени отправки
+    uint64_t start_ns;
+    uint64_t measure_ns;
+    uint64_t end_ns;
+};
+
+struct LoadConnection {
+    const struct LoadConfig *config;
+    int index;
+    int fd;              // -1, если сейчас не открыто
+    pthread_t sender;
+    pthread_t receiver;
+    uint64_t rng;
+
+    uint64_t sent;       // open loop: пишет отправитель, читает приемник
+    bool sender_done;
+    uint64_t received;
+    uint64_t measured;   // ответы на запросы, отправленные в окне замера
+    uint64_t errors;     // ответы с ненулевым статусом
+    bool failed;         // обрыв или ответ не по протоколу
+    struct FineHistogram hist;  // своя у каждого соединения, сводится после прогона
+};
+
+static uint64_t NowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void SleepUntil(uint64_t deadline_ns) {
+    struct timespec ts;
+    ts.tv_sec = deadline_ns / 1000000000ULL;
+    ts.tv_nsec = deadline_ns % 1000000000ULL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+static uint64_t SplitMix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Отправляет один запрос; id - запланированное время отправки, по нему
+// считается задержка ответа
+static bool SendRequest(struct LoadConnection *conn, uint64_t id) {
+    const struct LoadConfig *config = conn->config;
+    uint64_t span = config->range_max - config->range_min + 1;
+
+    struct ProtoTask task;
+    task.id = id;
+    task.begin = 1 + SplitMix64(&conn->rng) % BEGIN_SPREAD;
+    task.end = task.begin + config->range_min + SplitMix64(&conn->rng) % span - 1;
+    task.mod = config->mods[SplitMix64(&conn->rng) % config->mods_count];
+
+    char buffer[PROTO_HEADER_SIZE + PROTO_TASK_SIZE];
+    ProtoEncodeHeader(buffer, PROTO_REQUEST, 1);
+    ProtoEncodeTask(buffer + PROTO_HEADER_SIZE, &task);
+    return SendAll(conn->fd, buffer, sizeof(buffer)) > 0;
+}
+
+// Принимает один ответ и учитывает его задержку
+static bool ReceiveReply(struct LoadConnection *conn) {
+    const struct LoadConfig *config = conn->config;
+    char buffer[PROTO_HEADER_SIZE + PROTO_REPLY_SIZE];
+    if (RecvAll(conn->fd, buffer, sizeof(buffer)) <= 0) {
+        fprintf(stderr, "Connection %d: reply read failed\n", conn->index);
+        return false;
+    }
+    uint64_t now = NowNs();
+
+    struct ProtoHeader header;
+    ProtoDecodeHeader(buffer, &header);
+    if (!ProtoIsHeader(buffer) || header.type != PROTO_RESPONSE ||
+        header.count != 1) {
+        fprintf(stderr, "Connection %d: unexpected reply\n", conn->index);
+        return false;
+    }
+    struct ProtoReply reply;
+    ProtoDecodeReply(buffer + PROTO_HEADER_SIZE, &reply);
+
+    conn->received++;
+    if (reply.status != PROTO_OK)
+        conn->errors++;
+    if (reply.id >= config->measure_ns && reply.id < config->end_ns) {
+        conn->measured++;
+        FineHistRecord(&conn->hist, now > reply.id ? now - reply.id : 0);
+    }
+    return true;
+}
+
+// Closed loop: pipeline запросов в полете, новый уходит после ответа
+void *ThreadClosedLoop(void *arg) {
+    struct LoadConnection *conn = (struct LoadConnection *)arg;
+    const struct LoadConfig *config = conn->config;
+    int outstanding = 0;
+
+    SleepUntil(config->start_ns);
+    for (int i = 0; i < config->pipeline; i++) {
+        if (!SendRequest(conn, NowNs())) {
+            conn->failed = true;
+            return NULL;
+        }
+        outstanding++;
+    }
+    while (outstanding > 0) {
+        if (!ReceiveReply(conn)) {
+            conn->failed = true;
+            return NULL;
+        }
+        outstanding--;
+        uint64_t now = NowNs();
+        if (now < config->end_ns) {
+            if (!SendRequest(conn, now)) {
+                conn->failed = true;
+                return NULL;
+            }
+            outstanding++;
+        }
+    }
+    return NULL;
+}
+
+// Open loop: запросы уходят по расписанию независимо от ответов. Задержка
+// считается от запланированного момента, поэтому отставание отправителя
+// от расписания тоже попадает в гистограмму (без coordinated omission).
+void *ThreadOpenSender(void *arg) {
+    struct LoadConnection *conn = (struct LoadConnection *)arg;
+    const struct LoadConfig *config = conn->config;
+    double interval = 1e9 * config->connections / config->rate;
+    double offset = 1e9 * conn->index / config->rate;
+
+    for (uint64_t i = 0;; i++) {
+        uint64_t scheduled = config->start_ns + (uint64_t)(offset + i * interval);
+        if (scheduled >= config->end_ns)
+            break;
+        SleepUntil(scheduled);
+        if (!SendRequest(conn, scheduled)) {
+            conn->failed = true;
+            break;
+        }
+        __atomic_store_n(&conn->sent, conn->sent + 1, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&conn->sender_done, true, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+void *ThreadOpenReceiver(void *arg) {
+    struct LoadConnection *conn = (struct LoadConnection *)arg;
+    while (true) {
+        bool done = __atomic_load_n(&conn->sender_done, __ATOMIC_ACQUIRE);
+        uint64_t sent = __atomic_load_n(&conn->sent, __ATOMIC_ACQUIRE);
+        if (conn->received >= sent) {
+            if (done)
+                break;
+            // Все ответы получены: ждем данных с таймаутом, чтобы заметить
+            // конец расписания, но проснуться сразу по приходу ответа
+            struct pollfd pfd = {conn->fd, POLLIN, 0};
+            poll(&pfd, 1, 10);
+            if (!(pfd.revents & POLLIN))
+                continue;
+        }
+        if (!ReceiveReply(conn)) {
+            conn->failed = true;
+            break;
+        }
+    }
+    return NULL;
+}
+
+static int Connect(const struct LoadConfig *config) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Socket creation failed!\n");
+        return -1;
+    }
+    if (connect(fd, (const struct sockaddr *)&config->addr,
+                sizeof(config->addr)) < 0) {
+        fprintf(stderr, "Connection failed\n");
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct timeval timeout = {RECV_TIMEOUT_SEC, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+// Соединение на запрос: каждый клиент открывает соединение, отправляет
+// один запрос, ждет ответа и закрывает его. Пропускная способность
+// равна скорости установки соединений (connect и accept сервера), а
+// задержка включает connect
+void *ThreadConnectLoop(void *arg) {
+    struct LoadConnection *conn = (struct LoadConnection *)arg;
+    const struct LoadConfig *config = conn->config;
+
+    SleepUntil(config->start_ns);
+    while (true) {
+        uint64_t started = NowNs();
+        if (started >= config->end_ns)
+            break;
+        conn->fd = Connect(config);
+        if (conn->fd < 0) {
+            conn->failed = true;
+            return NULL;
+        }
+        bool ok = SendRequest(conn, started) && ReceiveReply(conn);
+        close(conn->fd);
+        conn->fd = -1;
+        if (!ok) {
+            conn->failed = true;
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+static bool ParseServer(const char *text, struct sockaddr_in *addr) {
+    char host[255];
+    const char *colon = strrchr(text, ':');
+    if (colon == NULL || colon == text || (size_t)(colon - text) >= sizeof(host))
+        return false;
+    memcpy(host, text, colon - text);
+    host[colon - text] = '\0';
+    int port = atoi(colon + 1);
+    if (port <= 0 || port > 65535)
+        return false;
+
+    struct addrinfo hints;
+    struct addrinfo *info = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, NULL, &hints, &info) != 0 || info == NULL) {
+        fprintf(stderr, "No address found for %s\n", host);
+        return false;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons((uint16_t)port);
+    addr->sin_addr = ((struct sockaddr_in *)info->ai_addr)->sin_addr;
+    freeaddrinfo(info);
+    return true;
+}
+
+// "min" или "min:max"
+static bool ParseRange(const char *text, uint64_t *min, uint64_t *max) {
+    char *end = NULL;
+    *min = strtoull(text, &end, 10);
+    *max = *min;
+    if (*end == ':')
+        *max = strtoull(end + 1, &end, 10);
+    return *end == '\0' && *min > 0 && *max >= *min;
+}
+
+// Модули через запятую
+static bool ParseMods(const char *text, uint64_t *mods, int *count) {
+    *count = 0;
+    const char *p = text;
+    while (*p != '\0') {
+        char *end = NULL;
+        uint64_t mod = strtoull(p, &end, 10);
+        if (end == p || mod == 0 || *count == MAX_MODS)
+            return false;
+        mods[(*count)++] = mod;
+        if (*end == ',')
+            end++;
+        else if (*end != '\0')
+            return false;
+        p = end;
+    }
+    return *count > 0;
+}
+
+static void PrintReport(enum OutputFormat format, const struct LoadConfig *config,
+                        double duration, uint64_t requests, uint64_t errors,
+                        const struct FineHistogram *hist) {
+    const char *mode = config->connect_each ? "connect"
+                       : config->rate > 0   ? "open"
+                                            : "closed";
+    double throughput = requests / duration;
+    double mean = hist->count ? hist->sum / 1e3 / hist->count : 0.0;
+    double p50 = FineHistPercentile(hist, 0.5) / 1e3;
+    double p90 = FineHistPercentile(hist, 0.9) / 1e3;
+    double p99 = FineHistPercentile(hist, 0.99) / 1e3;
+    double p999 = FineHistPercentile(hist, 0.999) / 1e3;
+    double max = hist->max / 1e3;
+
+    switch (format) {
+        case FORMAT_CSV:
+            printf("mode,connections,rate,pipeline,range_min,range_max,"
+                   "duration_s,requests,errors,throughput,mean_us,p50_us,"
+                   "p90_us,p99_us,p999_us,max_us\n");
+            printf("%s,%d,%.1f,%d,%lu,%lu,%.3f,%lu,%lu,%.1f,%.1f,%.1f,%.1f,"
+                   "%.1f,%.1f,%.1f\n",
+                   mode, config->connections, config->rate, config->pipeline,
+                   config->range_min, config->range_max, duration, requests,
+                   errors, throughput, mean, p50, p90, p99, p999, max);
+            break;
+        case FORMAT_JSON:
+            printf("{\"mode\": \"%s\", \"connections\": %d, \"rate\": %.1f, "
+                   "\"pipeline\": %d, \"range_min\": %lu, \"range_max\": %lu, "
+                   "\"duration_s\": %.3f, \"requests\": %lu, \"errors\": %lu, "
+                   "\"throughput\": %.1f, \"latency_us\": {\"mean\": %.1f, "
+                   "\"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, "
+                   "\"p999\": %.1f, \"max\": %.1f}}\n",
+                   mode, config->connections, config->rate, config->pipeline,
+                   config->range_min, config->range_max, duration, requests,
+                   errors, throughput, mean, p50, p90, p99, p999, max);
+            break;
+        default:
+            if (config->connect_each)
+                printf("Mode: new connection per request, %d clients\n",
+                       config->connections);
+            else if (config->rate > 0)
+                printf("Mode: open loop at %.1f req/s, %d connections\n",
+                       config->rate, config->connections);
+            else
+                printf("Mode: closed loop, %d connections x %d in flight\n",
+                       config->connections, config->pipeline);
+            printf("Range: %lu..%lu numbers, %d moduli\n", config->range_min,
+                   config->range_max, config->mods_count);
+            printf("Requests: %lu in %.1fs (%.1f/s), errors %lu\n", requests,
+                   duration, throughput, errors);
+            printf("Latency: mean=%.1fus p50=%.1fus p90=%.1fus p99=%.1fus "
+                   "p99.9=%.1fus max=%.1fus\n",
+                   mean, p50, p90, p99, p999, max);
+    }
+}
+
+int main(int argc, char **argv) {
+    struct LoadConfig config;
+    memset(&config, 0, sizeof(config));
+    config.connections = 1;
+    config.pipeline = 1;
+    config.range_min = config.range_max = 1000;
+    config.mods[0] = 1000000007;
+    config.mods_count = 1;
+    config.seed = 1;
+    double warmup = 1;
+    double duration = 5;
+    enum OutputFormat format = FORMAT_TEXT;
+    bool server_set = false;
+
+    while (true) {
+        static struct option options[] = {
+            {"server", required_argument, 0, 0},
+            {"connections", required_argument, 0, 0},
+            {"rate", required_argument, 0, 0},
+            {"pipeline", required_argument, 0, 0},
+            {"range", required_argument, 0, 0},
+            {"mod", required_argument, 0, 0},
+            {"warmup", required_argument, 0, 0},
+            {"duration", required_argument, 0, 0},
+            {"format", required_argument, 0, 0},
+            {"seed", required_argument, 0, 0},
+            {"connect", no_argument, 0, 0},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        int c = getopt_long(argc, argv, "", options, &option_index);
+
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 0: {
+                switch (option_index) {
+                    case 0:
+                        if (!ParseServer(optarg, &config.addr)) {
+                            fprintf(stderr, "server must be host:port\n");
+                            return 1;
+                        }
+                        server_set = true;
+                        break;
+                    case 1:
+                        config.connections = atoi(optarg);
+                        if (config.connections <= 0 ||
+                            config.connections > MAX_CONNECTIONS) {
+                            fprintf(stderr, "connections must be from 1 to %d\n",
+                                    MAX_CONNECTIONS);
+                            return 1;
+                        }
+                        break;
+                    case 2:
+                        config.rate = atof(optarg);
+                        if (config.rate < 0) {
+                            fprintf(stderr, "rate must be non-negative\n");
+                            return 1;
+                        }
+                        break;
+                    case 3:
+                        config.pipeline = atoi(optarg);
+                        if (config.pipeline <= 0 || config.pipeline > MAX_PIPELINE) {
+                            fprintf(stderr, "pipeline must be from 1 to %d\n",
+                                    MAX_PIPELINE);
+                            return 1;
+                        }
+                        break;
+                    case 4:
+                        if (!ParseRange(optarg, &config.range_min,
+                                        &config.range_max)) {
+                            fprintf(stderr, "range must be min or min:max\n");
+                            return 1;
+                        }
+                        break;
+                    case 5:
+                        if (!ParseMods(optarg, config.mods, &config.mods_count)) {
+                            fprintf(stderr, "mod must be a list of positive "
+                                    "numbers (up to %d)\n", MAX_MODS);
+                            return 1;
+                        }
+                        break;
+                    case 6:
+                        warmup = atof(optarg);
+                        break;
+                    case 7:
+                        duration = atof(optarg);
+                        break;
+                    case 8:
+                        if (strcmp(optarg, "text") == 0) {
+                            format = FORMAT_TEXT;
+                        } else if (strcmp(optarg, "csv") == 0) {
+                            format = FORMAT_CSV;
+                        } else if (strcmp(optarg, "json") == 0) {
+                            format = FORMAT_JSON;
+                        } else {
+                            fprintf(stderr, "format must be text, csv or json\n");
+                            return 1;
+                        }
+                        break;
+                    case 9:
+                        config.seed = strtoull(optarg, NULL, 10);
+                        break;
+                    case 10:
+                        config.connect_each = true;
+                        break;
+                    default:
+                        printf("Index %d is out of options\n", option_index);
+                }
+            } break;
+            case '?':
+                printf("Unknown argument\n");
+                break;
+            default:
+                fprintf(stderr, "getopt returned character code 0%o?\n", c);
+        }
+    }
+
+    if (!server_set || warmup < 0 || duration <= 0) {
+        fprintf(stderr,
+                "Using: %s --server 127.0.0.1:20001 [--connections 1] "
+                "[--rate 0 | --pipeline 1 | --connect] [--range 1000[:100000]] "
+                "[--mod 1000000007[,998244353]] [--warmup 1] [--duration 5] "
+                "[--format text|csv|json] [--seed 1]\n",
+                argv[0]);
+        return 1;
+    }
+    if (config.connect_each && config.rate > 0) {
+        fprintf(stderr, "connect works only in closed loop\n");
+        return 1;
+    }
+
+    struct LoadConnection *conns =
+        calloc(config.connections, sizeof(struct LoadConnection));
+    if (conns == NULL) {
+        fprintf(stderr, "Can not allocate connections\n");
+        return 1;
+    }
+    for (int i = 0; i < config.connections; i++) {
+        conns[i].config = &config;
+        conns[i].index = i;
+        conns[i].rng = config.seed * 0x100000001B3ULL + i;
+        conns[i].fd = -1;
+        if (config.connect_each)
+            continue;
+        conns[i].fd = Connect(&config);
+        if (conns[i].fd < 0)
+            return 1;
+    }
+
+    // Все соединения открыты заранее, чтобы установка не попала в замер
+    // (кроме --connect, где замеряется именно она)
+    config.start_ns = NowNs() + 10000000ULL;
+    config.measure_ns = config.start_ns + (uint64_t)(warmup * 1e9);
+    config.end_ns = config.measure_ns + (uint64_t)(duration * 1e9);
+
+    for (int i = 0; i < config.connections; i++) {
+        int err;
+        if (config.connect_each) {
+            err = pthread_create(&conns[i].sender, NULL, ThreadConnectLoop,
+                                 &conns[i]);
+        } else if (config.rate > 0) {
+            err = pthread_create(&conns[i].sender, NULL, ThreadOpenSender,
+                                 &conns[i]) ||
+                  pthread_create(&conns[i].receiver, NULL, ThreadOpenReceiver,
+                                 &conns[i]);
+        } else {
+            err = pthread_create(&conns[i].sender, NULL, ThreadClosedLoop,
+                                 &conns[i]);
+        }
+        if (err) {
+            fprintf(stderr, "Error: pthread_create failed!\n");
+            return 1;
+        }
+    }
+
+    static struct FineHistogram total;
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    bool failed = false;
+    for (int i = 0; i < config.connections; i++) {
+        pthread_join(conns[i].sender, NULL);
+        if (config.rate > 0)
+            pthread_join(conns[i].receiver, NULL);
+        if (conns[i].fd >= 0)
+            close(conns[i].fd);
+        FineHistMerge(&total, &conns[i].hist);
+        requests += conns[i].measured;
+        errors += conns[i].errors;
+        failed = failed || conns[i].failed;
+    }
+    free(conns);
+
+    PrintReport(format, &config, duration, requests, errors, &total);
+    return failed ? 1 : 0;
+}
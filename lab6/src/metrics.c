@@ -0,0 +1,167 @@
+#include "metrics.h"
+
+#include <string.h>
+#include <time.h>
+
+uint64_t MetricsNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void MetricsInit(struct ServerMetrics *metrics) {
+    memset(metrics, 0, sizeof(*metrics));
+    metrics->started_ns = MetricsNow();
+}
+
+int HistBucketIndex(uint64_t value, int sub_bits) {
+    if (value < (1u << sub_bits))
+        return (int)value;
+    int msb = 63 - __builtin_clzll(value);
+    int sub = (int)(value >> (msb - sub_bits)) & ((1 << sub_bits) - 1);
+    return ((msb - sub_bits + 1) << sub_bits) + sub;
+}
+
+uint64_t HistBucketUpper(int index, int sub_bits) {
+    if (index < (1 << sub_bits))
+        return (uint64_t)index;
+    int msb = (index >> sub_bits) + sub_bits - 1;
+    uint64_t sub = (uint64_t)(index & ((1 << sub_bits) - 1));
+    int shift = msb - sub_bits;
+    uint64_t lower = (((uint64_t)1 << sub_bits) + sub) << shift;
+    return lower + (((uint64_t)1 << shift) - 1);
+}
+
+// Перцентиль по корзинам любой точности; total и max уже прочитаны
+static uint64_t CountsPercentile(const uint64_t *counts, int sub_bits,
+                                 uint64_t total, uint64_t max, double q) {
+    if (total == 0)
+        return 0;
+
+    uint64_t rank = (uint64_t)(q * total);
+    if (rank >= total)
+        rank = total - 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < (64 << sub_bits); i++) {
+        seen += MetricsLoad(&counts[i]);
+        if (seen > rank) {
+            // Верхняя граница корзины не может превышать наблюдаемый максимум
+            uint64_t upper = HistBucketUpper(i, sub_bits);
+            return upper < max ? upper : max;
+        }
+    }
+    return max;
+}
+
+void HistRecord(struct Histogram *hist, uint64_t value) {
+    MetricsAdd(&hist->counts[HistBucketIndex(value, HIST_SUB_BITS)], 1);
+    MetricsAdd(&hist->count, 1);
+    MetricsAdd(&hist->sum, value);
+
+    uint64_t max = MetricsLoad(&hist->max);
+    while (value > max &&
+           !__atomic_compare_exchange_n(&hist->max, &max, value, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+uint64_t HistPercentile(const struct Histogram *hist, double q) {
+    return CountsPercentile(hist->counts, HIST_SUB_BITS,
+                            MetricsLoad(&hist->count),
+                            MetricsLoad(&hist->max), q);
+}
+
+void FineHistRecord(struct FineHistogram *hist, uint64_t value) {
+    hist->counts[HistBucketIndex(value, HIST_FINE_SUB_BITS)]++;
+    hist->count++;
+    hist->sum += value;
+    if (value > hist->max)
+        hist->max = value;
+}
+
+void FineHistMerge(struct FineHistogram *total,
+                   const struct FineHistogram *part) {
+    for (int i = 0; i < HIST_FINE_BUCKETS; i++)
+        total->counts[i] += part->counts[i];
+    total->count += part->count;
+    total->sum += part->sum;
+    if (part->max > total->max)
+        total->max = part->max;
+}
+
+uint64_t FineHistPercentile(const struct FineHistogram *hist, double q) {
+    return CountsPercentile(hist->counts, HIST_FINE_SUB_BITS, hist->count,
+                            hist->max, q);
+}
+
+static void HistMerge(struct Histogram *total, const struct Histogram *part) {
+    for (int i = 0; i < HIST_BUCKETS; i++)
+        total->counts[i] += MetricsLoad(&part->counts[i]);
+    total->count += MetricsLoad(&part->count);
+    total->sum += MetricsLoad(&part->sum);
+    uint64_t max = MetricsLoad(&part->max);
+    if (max > total->max)
+        total->max = max;
+}
+
+void MetricsMerge(struct ServerMetrics *total, const struct ServerMetrics *part) {
+    if (total->started_ns == 0 || part->started_ns < total->started_ns)
+        total->started_ns = part->started_ns;
+    total->requests += MetricsLoad(&part->requests);
+    total->errors += MetricsLoad(&part->errors);
+    total->bytes_in += MetricsLoad(&part->bytes_in);
+    total->bytes_out += MetricsLoad(&part->bytes_out);
+    total->connections_active += MetricsLoad(&part->connections_active);
+    total->connections_total += MetricsLoad(&part->connections_total);
+    HistMerge(&total->latency, &part->latency);
+    HistMerge(&total->compute, &part->compute);
+    HistMerge(&total->queue_wait, &part->queue_wait);
+}
+
+void MetricsFillStats(const struct ServerMetrics *metrics,
+                      struct ProtoStats *stats) {
+    stats->uptime_us = (MetricsNow() - metrics->started_ns) / 1000;
+    stats->requests = MetricsLoad(&metrics->requests);
+    stats->errors = MetricsLoad(&metrics->errors);
+    stats->bytes_in = MetricsLoad(&metrics->bytes_in);
+    stats->bytes_out = MetricsLoad(&metrics->bytes_out);
+    stats->connections_active = MetricsLoad(&metrics->connections_active);
+    stats->connections_total = MetricsLoad(&metrics->connections_total);
+    stats->latency_p50_us = HistPercentile(&metrics->latency, 0.5) / 1000;
+    stats->latency_p99_us = HistPercentile(&metrics->latency, 0.99) / 1000;
+    stats->latency_max_us = MetricsLoad(&metrics->latency.max) / 1000;
+    stats->compute_p50_us = HistPercentile(&metrics->compute, 0.5) / 1000;
+    stats->compute_p99_us = HistPercentile(&metrics->compute, 0.99) / 1000;
+    stats->queue_wait_p50_us = HistPercentile(&metrics->queue_wait, 0.5) / 1000;
+    stats->queue_wait_p99_us =
+        HistPercentile(&metrics->queue_wait, 0.99) / 1000;
+}
+
+static void PrintHistogram(FILE *out, const char *name,
+                           const struct Histogram *hist) {
+    uint64_t count = MetricsLoad(&hist->count);
+    uint64_t sum = MetricsLoad(&hist->sum);
+    fprintf(out,
+            "%s: count=%lu mean=%.1fus p50=%.1fus p90=%.1fus p99=%.1fus "
+            "max=%.1fus\n",
+            name, count, count ? sum / 1000.0 / count : 0.0,
+            HistPercentile(hist, 0.5) / 1000.0,
+            HistPercentile(hist, 0.9) / 1000.0,
+            HistPercentile(hist, 0.99) / 1000.0,
+            MetricsLoad(&hist->max) / 1000.0);
+}
+
+void MetricsPrint(const struct ServerMetrics *metrics, FILE *out) {
+    double uptime = (MetricsNow() - metrics->started_ns) / 1e9;
+    uint64_t requests = MetricsLoad(&metrics->requests);
+    fprintf(out, "Uptime: %.1fs, requests=%lu (%.1f/s) errors=%lu\n", uptime,
+            requests, uptime > 0 ? requests / uptime : 0.0,
+            MetricsLoad(&metrics->errors));
+    fprintf(out, "Connections: active=%lu total=%lu, bytes in=%lu out=%lu\n",
+            MetricsLoad(&metrics->connections_active),
+            MetricsLoad(&metrics->connections_total),
+            MetricsLoad(&metrics->bytes_in), MetricsLoad(&metrics->bytes_out));
+    PrintHistogram(out, "Latency", &metrics->latency);
+    PrintHistogram(out, "Compute", &metrics->compute);
+    PrintHistogram(out, "Queue wait", &metrics->queue_wait);
+}
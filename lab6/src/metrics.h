@@ -0,0 +1,94 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "protocol.h"
+
+// Гистограмма длительностей в наносекундах: по четыре корзины на каждую
+// степень двойки, поэтому перцентиль завышается не больше чем на 25%.
+// Запись - несколько атомарных сложений без блокировок.
+#define HIST_SUB_BITS 2
+#define HIST_BUCKETS (64 << HIST_SUB_BITS)
+
+struct Histogram {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+};
+
+// Точная гистограмма для генератора нагрузки: 2^7 корзин на степень
+// двойки, ошибка перцентиля меньше 1%. Пишется одним потоком без
+// атомарных операций, сводится через FineHistMerge.
+#define HIST_FINE_SUB_BITS 7
+#define HIST_FINE_BUCKETS (64 << HIST_FINE_SUB_BITS)
+
+struct FineHistogram {
+    uint64_t counts[HIST_FINE_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+};
+
+// Счетчики сервера. Пишутся циклом событий и рабочими потоками через
+// атомарные операции с relaxed-порядком, читаются потоком отчетов и при
+// ответе на кадр статистики; согласованный срез не гарантируется.
+struct ServerMetrics {
+    uint64_t started_ns;
+    uint64_t requests;            // отвеченные задачи
+    uint64_t errors;              // задачи с ошибкой (нулевой модуль)
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t connections_active;
+    uint64_t connections_total;
+
+    struct Histogram latency;     // от приема задачи до готового ответа
+    struct Histogram compute;     // вычисление одного куска в потоке
+    struct Histogram queue_wait;  // ожидание куска в очереди пула
+};
+
+static inline void MetricsAdd(uint64_t *counter, uint64_t value) {
+    __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+static inline void MetricsSub(uint64_t *counter, uint64_t value) {
+    __atomic_fetch_sub(counter, value, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t MetricsLoad(const uint64_t *counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+// Монотонное время в наносекундах
+uint64_t MetricsNow(void);
+
+void MetricsInit(struct ServerMetrics *metrics);
+
+// Корзина значения и ее верхняя граница при 2^sub_bits корзинах на
+// каждую степень двойки
+int HistBucketIndex(uint64_t value, int sub_bits);
+uint64_t HistBucketUpper(int index, int sub_bits);
+
+void HistRecord(struct Histogram *hist, uint64_t value);
+
+// Верхняя граница корзины, в которую попадает доля q (0..1) значений
+uint64_t HistPercentile(const struct Histogram *hist, double q);
+
+void FineHistRecord(struct FineHistogram *hist, uint64_t value);
+void FineHistMerge(struct FineHistogram *total,
+                   const struct FineHistogram *part);
+uint64_t FineHistPercentile(const struct FineHistogram *hist, double q);
+
+// Прибавляет счетчики и гистограммы part к total (total не читается
+// другими потоками); started_ns - наиболее раннее из двух
+void MetricsMerge(struct ServerMetrics *total, const struct ServerMetrics *part);
+
+// Срез для кадра статистики; длительности в микросекундах
+void MetricsFillStats(const struct ServerMetrics *metrics,
+                      struct ProtoStats *stats);
+
+void MetricsPrint(const struct ServerMetrics *metrics, FILE *out);
+
+#endif
@@ -0,0 +1,172 @@
+#include "modsimd.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define MOD_SIMD_X86 1
+#include <immintrin.h>
+#else
+#define MOD_SIMD_X86 0
+#endif
+
+// Короче этого диапазон не окупает сборку цепочек и ModPow поправки
+#define SIMD_MIN_COUNT 256
+
+#define AVX2_VECTORS 8   // по 4 цепочки в векторе
+#define IFMA_VECTORS 4   // по 8 цепочек в векторе
+
+// -mod^(-1) mod 2^64 методом Ньютона, mod нечетный
+static uint64_t NegInverse(uint64_t mod) {
+    uint64_t inv = mod;
+    for (int i = 0; i < 5; i++)
+        inv *= 2 - mod * inv;
+    return 0 - inv;
+}
+
+// Сборка цепочек: каждая содержит произведение своих чисел, умноженное на
+// R^(-steps); общий множитель R^(-steps * lanes) снимается одним ModPow
+static uint64_t CombineLanes(const struct ModContext *ctx, const uint64_t *acc,
+                             int lanes, uint64_t r_mod, uint64_t steps) {
+    uint64_t result = ModPow(ctx, r_mod, steps * lanes);
+    for (int j = 0; j < lanes; j++)
+        result = ModMul(ctx, result, acc[j]);
+    return result;
+}
+
+#if MOD_SIMD_X86
+
+// Монтгомери по R = 2^32 в 64-битных элементах: a * b < 2^64, сумма
+// t + m * mod может переполнить 64 бита, поэтому складываются старшие
+// половины и перенос младших (он равен 1, если младшая половина t не 0)
+__attribute__((target("avx2"))) static inline __m256i
+MontMul32x4(__m256i a, __m256i b, __m256i mod, __m256i ninv) {
+    const __m256i low_mask = _mm256_set1_epi64x(0xffffffffLL);
+    const __m256i one = _mm256_set1_epi64x(1);
+    __m256i t = _mm256_mul_epu32(a, b);
+    __m256i m = _mm256_mul_epu32(t, ninv);
+    __m256i mm = _mm256_mul_epu32(m, mod);
+    __m256i zero_low =
+        _mm256_cmpeq_epi64(_mm256_and_si256(t, low_mask), _mm256_setzero_si256());
+    __m256i u = _mm256_add_epi64(_mm256_srli_epi64(t, 32),
+                                 _mm256_srli_epi64(mm, 32));
+    u = _mm256_add_epi64(u, _mm256_andnot_si256(zero_low, one));
+    // u < 2 * mod < 2^33, знаковое сравнение корректно
+    __m256i below = _mm256_cmpgt_epi64(mod, u);
+    return _mm256_sub_epi64(u, _mm256_andnot_si256(below, mod));
+}
+
+__attribute__((target("avx2"))) static uint64_t
+ProductAvx2(const struct ModContext *ctx, uint64_t x, uint64_t count,
+            uint64_t *done) {
+    const int lanes = 4 * AVX2_VECTORS;
+    uint64_t steps = count / lanes;
+    __m256i mod = _mm256_set1_epi64x((long long)ctx->mod);
+    __m256i ninv = _mm256_set1_epi64x((long long)(uint32_t)NegInverse(ctx->mod));
+    __m256i stride = _mm256_set1_epi64x(lanes);
+    __m256i acc[AVX2_VECTORS], xs[AVX2_VECTORS];
+    for (int v = 0; v < AVX2_VECTORS; v++) {
+        uint64_t b = x + 4 * v;
+        acc[v] = _mm256_set1_epi64x(1);
+        xs[v] = _mm256_set_epi64x(b + 3, b + 2, b + 1, b);
+    }
+
+    for (uint64_t s = 0; s < steps; s++) {
+        for (int v = 0; v < AVX2_VECTORS; v++) {
+            acc[v] = MontMul32x4(acc[v], xs[v], mod, ninv);
+            xs[v] = _mm256_add_epi64(xs[v], stride);
+        }
+    }
+
+    uint64_t lanes_acc[4 * AVX2_VECTORS];
+    for (int v = 0; v < AVX2_VECTORS; v++)
+        _mm256_storeu_si256((__m256i *)&lanes_acc[4 * v], acc[v]);
+    *done = steps * lanes;
+    return CombineLanes(ctx, lanes_acc, lanes, (1ULL << 32) % ctx->mod,
+                        steps);
+}
+
+// Монтгомери по R = 2^52 на vpmadd52: младшие и старшие 52 бита
+// произведения, перенос младших частей как в 32-битном варианте
+__attribute__((target("avx512f,avx512ifma"))) static inline __m512i
+MontMul52x8(__m512i a, __m512i b, __m512i mod, __m512i ninv) {
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i lo = _mm512_madd52lo_epu64(zero, a, b);
+    __m512i hi = _mm512_madd52hi_epu64(zero, a, b);
+    __m512i m = _mm512_madd52lo_epu64(zero, lo, ninv);
+    __m512i u = _mm512_madd52hi_epu64(hi, m, mod);
+    __mmask8 carry = _mm512_test_epi64_mask(lo, lo);
+    u = _mm512_mask_add_epi64(u, carry, u, _mm512_set1_epi64(1));
+    __mmask8 over = _mm512_cmpge_epu64_mask(u, mod);
+    return _mm512_mask_sub_epi64(u, over, u, mod);
+}
+
+__attribute__((target("avx512f,avx512ifma"))) static uint64_t
+ProductIfma(const struct ModContext *ctx, uint64_t x, uint64_t count,
+            uint64_t *done) {
+    const int lanes = 8 * IFMA_VECTORS;
+    uint64_t steps = count / lanes;
+    __m512i mod = _mm512_set1_epi64((long long)ctx->mod);
+    __m512i ninv = _mm512_set1_epi64(
+        (long long)(NegInverse(ctx->mod) & ((1ULL << 52) - 1)));
+    __m512i stride = _mm512_set1_epi64(lanes);
+    __m512i acc[IFMA_VECTORS], xs[IFMA_VECTORS];
+    for (int v = 0; v < IFMA_VECTORS; v++) {
+        uint64_t b = x + 8 * v;
+        acc[v] = _mm512_set1_epi64(1);
+        xs[v] = _mm512_set_epi64(b + 7, b + 6, b + 5, b + 4, b + 3, b + 2,
+                                 b + 1, b);
+    }
+
+    for (uint64_t s = 0; s < steps; s++) {
+        for (int v = 0; v < IFMA_VECTORS; v++) {
+            acc[v] = MontMul52x8(acc[v], xs[v], mod, ninv);
+            xs[v] = _mm512_add_epi64(xs[v], stride);
+        }
+    }
+
+    uint64_t lanes_acc[8 * IFMA_VECTORS];
+    for (int v = 0; v < IFMA_VECTORS; v++)
+        _mm512_storeu_si512(&lanes_acc[8 * v], acc[v]);
+    *done = steps * lanes;
+    return CombineLanes(ctx, lanes_acc, lanes, (1ULL << 52) % ctx->mod,
+                        steps);
+}
+
+#endif
+
+bool ModSimdAvailable(enum ModKernel kernel, uint64_t mod) {
+#if MOD_SIMD_X86
+    // Монтгомери требует нечетного модуля; mod > 1, чтобы 1 была вычетом
+    if (mod % 2 == 0 || mod == 1)
+        return false;
+    switch (kernel) {
+        case MOD_KERNEL_AVX2:
+            return mod < (1ULL << 32) && __builtin_cpu_supports("avx2");
+        case MOD_KERNEL_IFMA:
+            return mod < (1ULL << 52) && __builtin_cpu_supports("avx512f") &&
+                   __builtin_cpu_supports("avx512ifma");
+        default:
+            return false;
+    }
+#else
+    (void)kernel;
+    (void)mod;
+    return false;
+#endif
+}
+
+uint64_t ModSimdProduct(enum ModKernel kernel, const struct ModContext *ctx,
+                        uint64_t x, uint64_t count, uint64_t *done) {
+    *done = 0;
+#if MOD_SIMD_X86
+    if (count >= SIMD_MIN_COUNT && ModSimdAvailable(kernel, ctx->mod)) {
+        if (kernel == MOD_KERNEL_IFMA)
+            return ProductIfma(ctx, x, count, done);
+        if (kernel == MOD_KERNEL_AVX2)
+            return ProductAvx2(ctx, x, count, done);
+    }
+#else
+    (void)kernel;
+    (void)x;
+    (void)count;
+#endif
+    return 1 % ctx->mod;
+}
@@ -0,0 +1,22 @@
+#ifndef MODSIMD_H
+#define MODSIMD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "multmodulo.h"
+
+// Векторные ядра ModRangeProductKernel. Код собирается без -mavx*:
+// функции помечены атрибутом target, а выбор делается по cpuid во время
+// работы, поэтому бинарник запускается и на процессорах без AVX2.
+
+// Процессор поддерживает ядро, и оно подходит модулю
+bool ModSimdAvailable(enum ModKernel kernel, uint64_t mod);
+
+// Произведение первых *done из count чисел x, x + 1, ... (x > 0,
+// x + count <= mod) по модулю ctx->mod; остаток досчитывает вызывающий.
+// *done кратно числу цепочек ядра и может быть 0 для коротких диапазонов.
+uint64_t ModSimdProduct(enum ModKernel kernel, const struct ModContext *ctx,
+                        uint64_t x, uint64_t count, uint64_t *done);
+
+#endif
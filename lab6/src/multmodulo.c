@@ -1,13 +1,318 @@
 #include "multmodulo.h"
 
+#include "modsimd.h"
+
+// Полное 128-битное произведение a * b в виде (hi, lo)
+static inline void Mul64(uint64_t a, uint64_t b, uint64_t *hi, uint64_t *lo) {
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 p = (unsigned __int128)a * b;
+    *hi = (uint64_t)(p >> 64);
+    *lo = (uint64_t)p;
+#else
+    // Переносимый вариант: умножение по 32-битным половинам
+    uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+    uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+    uint64_t ll = a_lo * b_lo;
+    uint64_t lh = a_lo * b_hi;
+    uint64_t hl = a_hi * b_lo;
+    uint64_t hh = a_hi * b_hi;
+    uint64_t mid = (ll >> 32) + (uint32_t)lh + (uint32_t)hl;
+    *lo = (mid << 32) | (uint32_t)ll;
+    *hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+#endif
+}
+
+static inline uint64_t MulHi64(uint64_t a, uint64_t b) {
+    uint64_t hi, lo;
+    Mul64(a, b, &hi, &lo);
+    return hi;
+}
+
+// (a + b) mod mod без переполнения, a, b < mod
+static inline uint64_t AddMod(uint64_t a, uint64_t b, uint64_t mod) {
+    return (a >= mod - b) ? a - (mod - b) : a + b;
+}
+
+static inline uint64_t BarrettReduce(const struct ModContext *ctx, uint64_t x) {
+    uint64_t q = MulHi64(x, ctx->barrett_mu);
+    uint64_t r = x - q * ctx->mod;
+    // mu занижено не более чем на единицу, поэтому хватает двух вычитаний
+    if (r >= ctx->mod)
+        r -= ctx->mod;
+    if (r >= ctx->mod)
+        r -= ctx->mod;
+    return r;
+}
+
+// REDC: (hi * 2^64 + lo) * 2^(-64) mod mod, при условии hi < mod
+static inline uint64_t MontReduce(const struct ModContext *ctx, uint64_t hi,
+                                  uint64_t lo) {
+    uint64_t m = lo * ctx->mont_inv;
+    uint64_t mh = MulHi64(m, ctx->mod);
+    // Младшие слова lo и m * mod совпадают, поэтому вычитаем только старшие
+    return (hi >= mh) ? hi - mh : hi - mh + ctx->mod;
+}
+
+static inline uint64_t MontMul(const struct ModContext *ctx, uint64_t a,
+                               uint64_t b) {
+    uint64_t hi, lo;
+    Mul64(a, b, &hi, &lo);
+    return MontReduce(ctx, hi, lo);
+}
+
+static inline uint64_t WideMul(const struct ModContext *ctx, uint64_t a,
+                               uint64_t b) {
+#ifdef __SIZEOF_INT128__
+    return (uint64_t)((unsigned __int128)a * b % ctx->mod);
+#else
+    return MultModulo(a, b, ctx->mod);
+#endif
+}
+
+void ModContextInit(struct ModContext *ctx, uint64_t mod) {
+    ctx->mod = mod;
+    ctx->barrett_mu = 0;
+    ctx->mont_inv = 0;
+    ctx->mont_r = 0;
+    ctx->mont_r2 = 0;
+
+    if (mod <= UINT32_MAX) {
+        ctx->kind = MOD_KIND_BARRETT;
+        ctx->barrett_mu = UINT64_MAX / mod;
+        return;
+    }
+
+    if (mod % 2 == 0) {
+        ctx->kind = MOD_KIND_WIDE;
+        return;
+    }
+
+    ctx->kind = MOD_KIND_MONTGOMERY;
+
+    // Обратный по модулю 2^64 методом Ньютона: каждая итерация удваивает
+    // число верных бит, а mod * mod == 1 (mod 8) дает первые три бита
+    uint64_t inv = mod;
+    for (int i = 0; i < 5; i++)
+        inv *= 2 - mod * inv;
+    ctx->mont_inv = inv;
+
+    // 2^64 mod mod == (2^64 - mod) mod mod
+    ctx->mont_r = (0 - mod) % mod;
+
+    // 2^128 mod mod: 64 удвоения 2^64 mod mod
+    uint64_t r2 = ctx->mont_r;
+    for (int i = 0; i < 64; i++)
+        r2 = AddMod(r2, r2, mod);
+    ctx->mont_r2 = r2;
+}
+
+uint64_t ModMul(const struct ModContext *ctx, uint64_t a, uint64_t b) {
+    if (a >= ctx->mod)
+        a %= ctx->mod;
+    if (b >= ctx->mod)
+        b %= ctx->mod;
+
+    switch (ctx->kind) {
+        case MOD_KIND_BARRETT:
+            return BarrettReduce(ctx, a * b);
+        case MOD_KIND_MONTGOMERY:
+            // a * b * 2^(-64), затем домножение на 2^128 и еще одна редукция
+            return MontMul(ctx, MontMul(ctx, a, b), ctx->mont_r2);
+        case MOD_KIND_WIDE:
+        default:
+            return WideMul(ctx, a, b);
+    }
+}
+
+uint64_t ModPow(const struct ModContext *ctx, uint64_t base, uint64_t exp) {
+    uint64_t result = 1 % ctx->mod;
+    base %= ctx->mod;
+    while (exp > 0) {
+        if (exp & 1)
+            result = ModMul(ctx, result, base);
+        base = ModMul(ctx, base, base);
+        exp >>= 1;
+    }
+    return result;
+}
+
+uint64_t ModInverse(const struct ModContext *ctx, uint64_t a) {
+    uint64_t mod = ctx->mod;
+    uint64_t r0 = mod, r1 = a % mod;
+    // Коэффициенты при a хранятся сразу по модулю, чтобы не уйти в знаковые
+    uint64_t t0 = 0, t1 = 1 % mod;
+    while (r1 != 0) {
+        uint64_t q = r0 / r1;
+        uint64_t r = r0 - q * r1;
+        r0 = r1;
+        r1 = r;
+        uint64_t qt = ModMul(ctx, q, t1);
+        uint64_t t = (t0 >= qt) ? t0 - qt : t0 + (mod - qt);
+        t0 = t1;
+        t1 = t;
+    }
+    return r0 == 1 ? t0 : 0;
+}
+
+// Одна цепочка зависимых умножений: каждое ждет предыдущее
+static uint64_t RangeProductSerial(const struct ModContext *ctx, uint64_t begin,
+                                   uint64_t end) {
+    uint64_t mod = ctx->mod;
+    if (begin > end)
+        return 1 % mod;
+    // Среди mod подряд идущих чисел обязательно есть кратное mod
+    if (end - begin >= mod - 1)
+        return 0;
+
+    uint64_t count = end - begin + 1;
+    uint64_t x = begin % mod;
+    uint64_t acc = 1 % mod;
+
+    switch (ctx->kind) {
+        case MOD_KIND_BARRETT:
+            for (uint64_t n = 0; n < count; n++) {
+                if (x == 0)
+                    return 0;
+                acc = BarrettReduce(ctx, acc * x);
+                if (++x == mod)
+                    x = 0;
+            }
+            return acc;
+        case MOD_KIND_MONTGOMERY:
+            // Каждый шаг дает лишний множитель 2^(-64), итоговое
+            // произведение исправляется одним умножением на 2^(64 * count)
+            for (uint64_t n = 0; n < count; n++) {
+                if (x == 0)
+                    return 0;
+                acc = MontMul(ctx, acc, x);
+                if (++x == mod)
+                    x = 0;
+            }
+            return ModMul(ctx, acc, ModPow(ctx, ctx->mont_r, count));
+        case MOD_KIND_WIDE:
+        default:
+            for (uint64_t n = 0; n < count; n++) {
+                if (x == 0)
+                    return 0;
+                acc = WideMul(ctx, acc, x);
+                if (++x == mod)
+                    x = 0;
+            }
+            return acc;
+    }
+}
+
+// Произведение count > 0 чисел x, x + 1, ... без кратных mod (x > 0,
+// x + count <= mod) в MOD_LANES независимых цепочках: соседние
+// умножения не ждут друг друга и выполняются конвейером
+#define DEFINE_LANES_PRODUCT(name, mul)                                      \
+    static uint64_t name(const struct ModContext *ctx, uint64_t x,           \
+                         uint64_t count) {                                   \
+        uint64_t acc[MOD_LANES];                                             \
+        for (int j = 0; j < MOD_LANES; j++)                                  \
+            acc[j] = 1 % ctx->mod;                                           \
+        uint64_t n = 0;                                                      \
+        for (; n + MOD_LANES <= count; n += MOD_LANES, x += MOD_LANES) {     \
+            for (int j = 0; j < MOD_LANES; j++)                              \
+                acc[j] = mul(ctx, acc[j], x + j);                            \
+        }                                                                    \
+        for (; n < count; n++, x++)                                          \
+            acc[0] = mul(ctx, acc[0], x);                                    \
+        for (int j = 1; j < MOD_LANES; j++)                                  \
+            acc[0] = mul(ctx, acc[0], acc[j]);                               \
+        return acc[0];                                                       \
+    }
+
+static inline uint64_t BarrettMul(const struct ModContext *ctx, uint64_t a,
+                                  uint64_t b) {
+    return BarrettReduce(ctx, a * b);
+}
+
+DEFINE_LANES_PRODUCT(LanesBarrett, BarrettMul)
+DEFINE_LANES_PRODUCT(LanesMontgomery, MontMul)
+DEFINE_LANES_PRODUCT(LanesWide, WideMul)
+
+static uint64_t LanesProduct(const struct ModContext *ctx, uint64_t x,
+                             uint64_t count) {
+    switch (ctx->kind) {
+        case MOD_KIND_BARRETT:
+            return LanesBarrett(ctx, x, count);
+        case MOD_KIND_MONTGOMERY: {
+            // count умножений и MOD_LANES - 1 при сборке цепочек, каждое
+            // дает лишний множитель 2^(-64)
+            uint64_t acc = LanesMontgomery(ctx, x, count);
+            return ModMul(ctx, acc,
+                          ModPow(ctx, ctx->mont_r, count + MOD_LANES - 1));
+        }
+        case MOD_KIND_WIDE:
+        default:
+            return LanesWide(ctx, x, count);
+    }
+}
+
+bool ModKernelAvailable(const struct ModContext *ctx, enum ModKernel kernel) {
+    switch (kernel) {
+        case MOD_KERNEL_SERIAL:
+        case MOD_KERNEL_SCALAR:
+            return true;
+        default:
+            return ModSimdAvailable(kernel, ctx->mod);
+    }
+}
+
+enum ModKernel ModKernelBest(const struct ModContext *ctx) {
+    if (ModKernelAvailable(ctx, MOD_KERNEL_IFMA))
+        return MOD_KERNEL_IFMA;
+    if (ModKernelAvailable(ctx, MOD_KERNEL_AVX2))
+        return MOD_KERNEL_AVX2;
+    return MOD_KERNEL_SCALAR;
+}
+
+const char *ModKernelName(enum ModKernel kernel) {
+    static const char *kNames[] = {"serial", "scalar", "avx2", "ifma"};
+    return kNames[kernel];
+}
+
+uint64_t ModRangeProductKernel(const struct ModContext *ctx, uint64_t begin,
+                               uint64_t end, enum ModKernel kernel) {
+    if (kernel == MOD_KERNEL_SERIAL)
+        return RangeProductSerial(ctx, begin, end);
+
+    uint64_t mod = ctx->mod;
+    if (begin > end)
+        return 1 % mod;
+    // Среди mod подряд идущих чисел обязательно есть кратное mod; иначе
+    // кратное есть, только если вычеты пересекают mod
+    uint64_t count = end - begin + 1;
+    uint64_t x = begin % mod;
+    if (end - begin >= mod - 1 || x == 0 || count > mod - x)
+        return 0;
+
+    uint64_t acc = 1 % mod;
+    if (kernel != MOD_KERNEL_SCALAR && ModKernelAvailable(ctx, kernel)) {
+        uint64_t done = 0;
+        acc = ModSimdProduct(kernel, ctx, x, count, &done);
+        x += done;
+        count -= done;
+    }
+    if (count > 0)
+        acc = ModMul(ctx, acc, LanesProduct(ctx, x, count));
+    return acc;
+}
+
+uint64_t ModRangeProduct(const struct ModContext *ctx, uint64_t begin,
+                         uint64_t end) {
+    return ModRangeProductKernel(ctx, begin, end, ModKernelBest(ctx));
+}
+
 uint64_t MultModulo(uint64_t a, uint64_t b, uint64_t mod) {
     uint64_t result = 0;
     a = a % mod;
     while (b > 0) {
         if (b % 2 == 1)
-            result = (result + a) % mod;
-        a = (a * 2) % mod;
+            result = AddMod(result, a, mod);
+        a = AddMod(a, a, mod);
         b /= 2;
     }
     return result % mod;
-}
\ No newline at end of file
+}
@@ -1,8 +1,68 @@
 #ifndef MULTMODULO_H
 #define MULTMODULO_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
+// Способ редукции, выбранный для конкретного модуля
+enum ModKind {
+    MOD_KIND_BARRETT,    // mod < 2^32: произведение помещается в 64 бита
+    MOD_KIND_MONTGOMERY, // нечетный mod >= 2^32
+    MOD_KIND_WIDE        // четный mod >= 2^32: 128-битное деление
+};
+
+// Ядро произведения диапазона. Все, кроме SERIAL, ведут несколько
+// независимых цепочек умножений, чтобы задержка одного умножения не
+// ограничивала пропускную способность.
+enum ModKernel {
+    MOD_KERNEL_SERIAL,  // одна цепочка, эталон
+    MOD_KERNEL_SCALAR,  // MOD_LANES скалярных цепочек, любой модуль
+    MOD_KERNEL_AVX2,    // Монтгомери по 2^32, 32 цепочки; нечетный mod < 2^32
+    MOD_KERNEL_IFMA     // AVX-512 IFMA, Монтгомери по 2^52, 32 цепочки;
+                        // нечетный mod < 2^52
+};
+
+#define MOD_LANES 4
+
+// Контекст модульной арифметики: константы считаются один раз на запрос.
+// mod должен быть положительным.
+struct ModContext {
+    uint64_t mod;
+    enum ModKind kind;
+    uint64_t barrett_mu;  // floor((2^64 - 1) / mod) для Barrett
+    uint64_t mont_inv;    // mod^(-1) mod 2^64 для Montgomery
+    uint64_t mont_r;      // 2^64 mod mod
+    uint64_t mont_r2;     // 2^128 mod mod
+};
+
+void ModContextInit(struct ModContext *ctx, uint64_t mod);
+
+// a * b mod ctx->mod для произвольных a, b
+uint64_t ModMul(const struct ModContext *ctx, uint64_t a, uint64_t b);
+
+// base^exp mod ctx->mod
+uint64_t ModPow(const struct ModContext *ctx, uint64_t base, uint64_t exp);
+
+// a^(-1) mod ctx->mod расширенным алгоритмом Евклида (модуль не обязан
+// быть простым); 0, если a и модуль не взаимно просты
+uint64_t ModInverse(const struct ModContext *ctx, uint64_t a);
+
+// begin * (begin + 1) * ... * end mod ctx->mod (1, если begin > end)
+// лучшим ядром, доступным для модуля и процессора
+uint64_t ModRangeProduct(const struct ModContext *ctx, uint64_t begin,
+                         uint64_t end);
+
+// То же выбранным ядром; недоступное ядро заменяется скалярным
+uint64_t ModRangeProductKernel(const struct ModContext *ctx, uint64_t begin,
+                               uint64_t end, enum ModKernel kernel);
+
+// Векторное ядро поддерживается процессором (cpuid) и подходит модулю
+bool ModKernelAvailable(const struct ModContext *ctx, enum ModKernel kernel);
+enum ModKernel ModKernelBest(const struct ModContext *ctx);
+const char *ModKernelName(enum ModKernel kernel);
+
+// Исходный алгоритм "удвоения и сложения", оставлен как переносимый
+// вариант и эталон для бенчмарка
 uint64_t MultModulo(uint64_t a, uint64_t b, uint64_t mod);
 
-#endif
\ No newline at end of file
+#endif
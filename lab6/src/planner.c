@@ -0,0 +1,305 @@
+#include "planner.h"
+
+#include <stdio.h>
+
+#include "sublinear.h"
+
+// 64-битное число имеет не больше 15 различных простых делителей
+#define MAX_FACTORS 16
+
+struct Factorization {
+    int count;
+    uint64_t primes[MAX_FACTORS];
+    int exps[MAX_FACTORS];
+};
+
+static uint64_t Gcd(uint64_t a, uint64_t b) {
+    while (b != 0) {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Детерминированный Миллер-Рабин: этих оснований достаточно для n < 2^64
+static bool IsPrime(uint64_t n) {
+    static const uint64_t kBases[] = {2, 325, 9375, 28178, 450775, 9780504,
+                                      1795265022};
+    if (n < 2)
+        return false;
+    for (uint64_t p = 2; p < 64; p++) {
+        if (n % p == 0)
+            return n == p;
+    }
+
+    struct ModContext ctx;
+    ModContextInit(&ctx, n);
+    uint64_t d = n - 1;
+    int s = 0;
+    while (d % 2 == 0) {
+        d /= 2;
+        s++;
+    }
+
+    for (size_t i = 0; i < sizeof(kBases) / sizeof(kBases[0]); i++) {
+        uint64_t a = kBases[i] % n;
+        if (a == 0)
+            continue;
+        uint64_t x = ModPow(&ctx, a, d);
+        if (x == 1 || x == n - 1)
+            continue;
+        bool composite = true;
+        for (int r = 1; r < s && composite; r++) {
+            x = ModMul(&ctx, x, x);
+            if (x == n - 1)
+                composite = false;
+        }
+        if (composite)
+            return false;
+    }
+    return true;
+}
+
+// Шаг последовательности Полларда y -> y^2 + c mod n без переполнения
+static uint64_t RhoStep(const struct ModContext *ctx, uint64_t y, uint64_t c) {
+    uint64_t sq = ModMul(ctx, y, y);
+    return (sq >= ctx->mod - c) ? sq - (ctx->mod - c) : sq + c;
+}
+
+// Нетривиальный делитель составного нечетного n методом Полларда-Брента
+static uint64_t FindDivisor(uint64_t n) {
+    struct ModContext ctx;
+    ModContextInit(&ctx, n);
+
+    for (uint64_t c = 1;; c++) {
+        uint64_t y = 2, x = 2, saved = 2, q = 1, g = 1;
+        uint64_t r = 1;
+        while (g == 1) {
+            x = y;
+            for (uint64_t i = 0; i < r; i++)
+                y = RhoStep(&ctx, y, c);
+            // gcd накопленного произведения разностей раз в 128 шагов
+            for (uint64_t k = 0; k < r && g == 1; k += 128) {
+                saved = y;
+                for (uint64_t i = 0; i < 128 && i < r - k; i++) {
+                    y = RhoStep(&ctx, y, c);
+                    q = ModMul(&ctx, q, x > y ? x - y : y - x);
+                }
+                g = Gcd(q, n);
+            }
+            r *= 2;
+        }
+        if (g == n) {
+            // Пакет проскочил делитель: повтор по одному шагу
+            do {
+                saved = RhoStep(&ctx, saved, c);
+                g = Gcd(x > saved ? x - saved : saved - x, n);
+            } while (g == 1);
+        }
+        if (g != n)
+            return g;
+    }
+}
+
+static void AddFactor(struct Factorization *f, uint64_t p) {
+    for (int i = 0; i < f->count; i++) {
+        if (f->primes[i] == p) {
+            f->exps[i]++;
+            return;
+        }
+    }
+    f->primes[f->count] = p;
+    f->exps[f->count] = 1;
+    f->count++;
+}
+
+static void FactorRest(struct Factorization *f, uint64_t n) {
+    if (n == 1)
+        return;
+    if (IsPrime(n)) {
+        AddFactor(f, n);
+        return;
+    }
+    uint64_t d = FindDivisor(n);
+    FactorRest(f, d);
+    FactorRest(f, n / d);
+}
+
+static void Factorize(uint64_t n, struct Factorization *f) {
+    f->count = 0;
+    for (uint64_t p = 2; p < 1000 && p * p <= n; p++) {
+        while (n % p == 0) {
+            AddFactor(f, p);
+            n /= p;
+        }
+    }
+    FactorRest(f, n);
+}
+
+// Показатель p в n! по формуле Лежандра
+static uint64_t Legendre(uint64_t n, uint64_t p) {
+    uint64_t v = 0;
+    uint64_t q = p;
+    while (q <= n) {
+        v += n / q;
+        if (q > n / p)
+            break;
+        q *= p;
+    }
+    return v;
+}
+
+static void SetReady(struct FactPlan *plan, uint64_t value, uint32_t path) {
+    plan->ready = true;
+    plan->value = value;
+    plan->path |= path;
+    plan->ranges_count = 0;
+}
+
+void FactPlanInit(struct FactPlan *plan, const struct ModContext *ctx,
+                  uint64_t begin, uint64_t end) {
+    uint64_t mod = ctx->mod;
+    plan->path = 0;
+    plan->ready = false;
+    plan->value = 0;
+    plan->ctx = *ctx;
+    plan->prime = false;
+    plan->ranges_count = 1;
+    plan->begin[0] = begin;
+    plan->end[0] = end;
+    plan->invert = false;
+    plan->lift = 1;
+
+    if (begin > end) {
+        SetReady(plan, 1 % mod, FACT_PATH_LINEAR);
+        return;
+    }
+    if (end - begin >= mod - 1 || begin == 0) {
+        SetReady(plan, 0, FACT_PATH_ZERO);
+        return;
+    }
+    uint64_t numbers = end - begin + 1;
+    if (numbers < FACT_PLAN_MIN_NUMBERS)
+        return;
+
+    struct Factorization f;
+    Factorize(mod, &f);
+
+    // Степени простых, целиком делящие произведение, отделяются в lift
+    uint64_t rest = mod;
+    int uncovered = 0;
+    uint64_t last_prime = 0;
+    int last_exp = 0;
+    for (int i = 0; i < f.count; i++) {
+        uint64_t p = f.primes[i];
+        uint64_t v = Legendre(end, p) - Legendre(begin - 1, p);
+        if (v >= (uint64_t)f.exps[i]) {
+            for (int e = 0; e < f.exps[i]; e++)
+                rest /= p;
+        } else {
+            uncovered++;
+            last_prime = p;
+            last_exp = f.exps[i];
+        }
+    }
+
+    if (rest == 1) {
+        SetReady(plan, 0, FACT_PATH_ZERO);
+        return;
+    }
+    if (rest != mod) {
+        plan->path |= FACT_PATH_REDUCED;
+        plan->lift = mod / rest;
+        ModContextInit(&plan->ctx, rest);
+    }
+    if (uncovered != 1 || last_exp != 1)
+        return;
+
+    // Модуль p простой и не делит ни один множитель, поэтому диапазон в
+    // вычетах [s, s + n - 1] лежит внутри [1, p - 1]
+    uint64_t p = last_prime;
+    uint64_t s = begin % p;
+    plan->prime = true;
+    plan->begin[0] = s;
+    plan->end[0] = s + numbers - 1;
+    if (numbers > (p - 1) / 2) {
+        plan->path |= FACT_PATH_WILSON;
+        plan->invert = true;
+        plan->ranges_count = 2;
+        plan->begin[0] = s + numbers;
+        plan->end[0] = p - 1;
+        plan->begin[1] = 1;
+        plan->end[1] = s - 1;
+    }
+}
+
+uint64_t FactPlanFinish(const struct FactPlan *plan, uint64_t product) {
+    if (plan->ready)
+        return plan->value;
+
+    const struct ModContext *ctx = &plan->ctx;
+    uint64_t x = product;
+    if (plan->invert) {
+        // s * ... * (s + n - 1) * (дополнение) = (p - 1)! = -1
+        uint64_t inv = ModPow(ctx, x, ctx->mod - 2);
+        x = (ctx->mod - inv) % ctx->mod;
+    }
+    if (plan->lift == 1)
+        return x;
+
+    // Ответ t * lift с t * lift = x (mod B), где B = ctx->mod
+    uint64_t t = ModMul(ctx, x, ModInverse(ctx, plan->lift % ctx->mod));
+    return t * plan->lift;
+}
+
+bool FactUseSublinear(const struct FactPlan *plan, uint64_t numbers) {
+    return SUBLINEAR_SUPPORTED && plan->prime &&
+           numbers >= SUBLINEAR_MIN_NUMBERS;
+}
+
+uint64_t FactRangeProduct(const struct FactPlan *plan, uint64_t begin,
+                          uint64_t end) {
+    if (begin <= end && FactUseSublinear(plan, end - begin + 1))
+        return SublinearRangeProduct(&plan->ctx, begin, end);
+    return ModRangeProduct(&plan->ctx, begin, end);
+}
+
+uint64_t FactCompute(const struct ModContext *ctx, uint64_t begin,
+                     uint64_t end, uint32_t *path) {
+    struct FactPlan plan;
+    FactPlanInit(&plan, ctx, begin, end);
+
+    uint64_t product = 1 % plan.ctx.mod;
+    for (int i = 0; i < plan.ranges_count; i++) {
+        if (plan.begin[i] > plan.end[i])
+            continue;
+        uint64_t numbers = plan.end[i] - plan.begin[i] + 1;
+        plan.path |= FactUseSublinear(&plan, numbers) ? FACT_PATH_SUBLINEAR
+                                                      : FACT_PATH_LINEAR;
+        product = ModMul(&plan.ctx, product,
+                         FactRangeProduct(&plan, plan.begin[i], plan.end[i]));
+    }
+
+    if (path != NULL)
+        *path = plan.path;
+    return FactPlanFinish(&plan, product);
+}
+
+void FactPathFormat(uint32_t path, char *buffer, size_t size) {
+    static const char *kNames[] = {"linear", "zero", "wilson", "reduced",
+                                   "sublinear", "cached"};
+    size_t used = 0;
+    buffer[0] = '\0';
+    for (size_t i = 0; i < sizeof(kNames) / sizeof(kNames[0]); i++) {
+        if (!(path & (1u << i)))
+            continue;
+        int n = snprintf(buffer + used, size - used, "%s%s",
+                         used > 0 ? "+" : "", kNames[i]);
+        if (n < 0 || (size_t)n >= size - used)
+            break;
+        used += n;
+    }
+    if (used == 0)
+        snprintf(buffer, size, "none");
+}
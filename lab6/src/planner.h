@@ -0,0 +1,65 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "multmodulo.h"
+
+// Пути вычисления произведения; сервер возвращает их сумму (ИЛИ) в поле
+// info ответа, клиент печатает
+enum FactPath {
+    FACT_PATH_LINEAR = 1 << 0,     // прямое перемножение
+    FACT_PATH_ZERO = 1 << 1,       // произведение делится на модуль
+    FACT_PATH_WILSON = 1 << 2,     // через дополнение: (p - 1)! = -1 mod p
+    FACT_PATH_REDUCED = 1 << 3,    // модуль сокращен на делящие ответ p^e
+    FACT_PATH_SUBLINEAR = 1 << 4,  // сдвиг точек интерполяции
+    FACT_PATH_CACHED = 1 << 5      // часть диапазона взята из кэша
+};
+
+// Короткие диапазоны считаются напрямую: разложение модуля дороже
+#define FACT_PLAN_MIN_NUMBERS (1ULL << 20)
+
+// План вычисления begin * ... * end mod m. Произведение кусков ranges
+// по модулю ctx.mod (делитель m) передается в FactPlanFinish.
+struct FactPlan {
+    uint32_t path;
+    bool ready;     // ответ известен без вычислений
+    uint64_t value;
+
+    struct ModContext ctx;
+    bool prime;     // ctx.mod простое: куски можно считать сублинейно
+    int ranges_count;
+    uint64_t begin[2];
+    uint64_t end[2];
+
+    bool invert;    // куски - дополнение до p - 1 чисел по теореме Вильсона
+    uint64_t lift;  // m = lift * ctx.mod, а ответ делится на lift
+};
+
+// Проверяет дешевые случаи: длина диапазона не меньше m, кратное m среди
+// множителей, m = A * B с A, делящим произведение (тогда считается по
+// модулю B и поднимается по китайской теореме), простой B с диапазоном
+// длиннее (B - 1) / 2 (считается короткое дополнение)
+void FactPlanInit(struct FactPlan *plan, const struct ModContext *ctx,
+                  uint64_t begin, uint64_t end);
+
+// Ответ по модулю m из произведения кусков плана по модулю plan->ctx.mod
+uint64_t FactPlanFinish(const struct FactPlan *plan, uint64_t product);
+
+// true, если кусок из numbers чисел выгоднее считать сублинейно
+bool FactUseSublinear(const struct FactPlan *plan, uint64_t numbers);
+
+// Произведение одного куска плана выбранным ядром
+uint64_t FactRangeProduct(const struct FactPlan *plan, uint64_t begin,
+                          uint64_t end);
+
+// Синхронное вычисление в одном потоке; path - NULL или флаги FACT_PATH_*
+uint64_t FactCompute(const struct ModContext *ctx, uint64_t begin,
+                     uint64_t end, uint32_t *path);
+
+// Имена флагов через "+", например "reduced+sublinear"
+void FactPathFormat(uint32_t path, char *buffer, size_t size);
+
+#endif
@@ -0,0 +1,133 @@
+#include "pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static void *PoolWorker(void *arg) {
+    struct WorkerPool *pool = (struct WorkerPool *)arg;
+
+    while (true) {
+        pthread_mutex_lock(&pool->mutex);
+        while (pool->count == 0 && !pool->stopping)
+            pthread_cond_wait(&pool->not_empty, &pool->mutex);
+        if (pool->count == 0 && pool->stopping) {
+            pthread_mutex_unlock(&pool->mutex);
+            break;
+        }
+
+        struct PoolTask task = pool->queue[pool->head];
+        pool->head = (pool->head + 1) % pool->capacity;
+        pool->count--;
+        pthread_cond_signal(&pool->not_full);
+        pthread_mutex_unlock(&pool->mutex);
+
+        struct ServerMetrics *metrics = pool->metrics;
+        uint64_t started = 0;
+        if (metrics != NULL) {
+            started = MetricsNow();
+            HistRecord(&metrics->queue_wait, started - task.submitted_ns);
+        }
+
+        *task.result = FactRangeProduct(task.plan, task.begin, task.end);
+
+        if (metrics != NULL)
+            HistRecord(&metrics->compute, MetricsNow() - started);
+
+        // После разблокировки ожидающий поток может уничтожить группу,
+        // поэтому колбэк читается заранее
+        struct PoolBatch *batch = task.batch;
+        pthread_mutex_lock(&batch->mutex);
+        PoolBatchCallback on_done = batch->on_done;
+        bool finished = --batch->pending == 0;
+        if (finished && on_done == NULL)
+            pthread_cond_signal(&batch->done);
+        pthread_mutex_unlock(&batch->mutex);
+
+        if (finished && on_done != NULL)
+            on_done(batch);
+    }
+
+    return NULL;
+}
+
+int PoolInit(struct WorkerPool *pool, int threads_count, int capacity) {
+    pool->threads_count = 0;
+    pool->capacity = capacity;
+    pool->head = 0;
+    pool->count = 0;
+    pool->stopping = false;
+    pool->metrics = NULL;
+
+    pool->threads = malloc(sizeof(pthread_t) * threads_count);
+    pool->queue = malloc(sizeof(struct PoolTask) * capacity);
+    if (pool->threads == NULL || pool->queue == NULL) {
+        free(pool->threads);
+        free(pool->queue);
+        return -1;
+    }
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->not_empty, NULL);
+    pthread_cond_init(&pool->not_full, NULL);
+
+    for (int i = 0; i < threads_count; i++) {
+        if (pthread_create(&pool->threads[i], NULL, PoolWorker, pool)) {
+            fprintf(stderr, "Error: pthread_create failed!\n");
+            PoolDestroy(pool);
+            return -1;
+        }
+        pool->threads_count++;
+    }
+
+    return 0;
+}
+
+void PoolDestroy(struct WorkerPool *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->not_empty);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (int i = 0; i < pool->threads_count; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->not_empty);
+    pthread_cond_destroy(&pool->not_full);
+    free(pool->threads);
+    free(pool->queue);
+}
+
+void PoolBatchInit(struct PoolBatch *batch, int pending,
+                   PoolBatchCallback on_done, void *arg) {
+    pthread_mutex_init(&batch->mutex, NULL);
+    pthread_cond_init(&batch->done, NULL);
+    batch->pending = pending;
+    batch->on_done = on_done;
+    batch->arg = arg;
+}
+
+void PoolBatchDestroy(struct PoolBatch *batch) {
+    pthread_mutex_destroy(&batch->mutex);
+    pthread_cond_destroy(&batch->done);
+}
+
+void PoolSubmit(struct WorkerPool *pool, const struct PoolTask *task) {
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->count == pool->capacity)
+        pthread_cond_wait(&pool->not_full, &pool->mutex);
+    struct PoolTask *slot =
+        &pool->queue[(pool->head + pool->count) % pool->capacity];
+    *slot = *task;
+    slot->submitted_ns = pool->metrics != NULL ? MetricsNow() : 0;
+    pool->count++;
+    pthread_cond_signal(&pool->not_empty);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void PoolBatchWait(struct PoolBatch *batch) {
+    pthread_mutex_lock(&batch->mutex);
+    while (batch->pending > 0)
+        pthread_cond_wait(&batch->done, &batch->mutex);
+    pthread_mutex_unlock(&batch->mutex);
+}
@@ -0,0 +1,73 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "metrics.h"
+#include "planner.h"
+
+struct PoolBatch;
+
+// Вызывается рабочим потоком, выполнившим последнюю задачу группы
+typedef void (*PoolBatchCallback)(struct PoolBatch *batch);
+
+// Группа задач одного запроса. Если on_done не задан, отправитель ждет
+// в PoolBatchWait, пока pending не станет 0.
+struct PoolBatch {
+    pthread_mutex_t mutex;
+    pthread_cond_t done;
+    int pending;
+    PoolBatchCallback on_done;
+    void *arg;
+};
+
+// Задача для рабочего потока: произведение куска [begin, end] плана
+// (ядро и модуль выбирает план).
+// Результат пишется в *result, память задач и результатов принадлежит
+// отправителю, пул ничего не выделяет на запрос.
+struct PoolTask {
+    uint64_t begin;
+    uint64_t end;
+    const struct FactPlan *plan;
+    uint64_t *result;
+    struct PoolBatch *batch;
+    uint64_t submitted_ns;  // заполняет PoolSubmit, если метрики включены
+};
+
+// Долгоживущий пул рабочих потоков с ограниченной кольцевой очередью
+struct WorkerPool {
+    pthread_t *threads;
+    int threads_count;
+
+    struct PoolTask *queue;
+    int capacity;
+    int head;
+    int count;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    bool stopping;
+
+    // Ожидание в очереди и время вычисления кусков; NULL - без метрик.
+    // Задается после PoolInit до первой задачи.
+    struct ServerMetrics *metrics;
+};
+
+int PoolInit(struct WorkerPool *pool, int threads_count, int capacity);
+void PoolDestroy(struct WorkerPool *pool);
+
+// pending задается заранее, чтобы группа не завершилась посреди отправки
+void PoolBatchInit(struct PoolBatch *batch, int pending,
+                   PoolBatchCallback on_done, void *arg);
+void PoolBatchDestroy(struct PoolBatch *batch);
+
+// Ставит задачу в очередь (блокируется, если очередь заполнена)
+void PoolSubmit(struct WorkerPool *pool, const struct PoolTask *task);
+
+// Ждет завершения всех задач группы
+void PoolBatchWait(struct PoolBatch *batch);
+
+#endif
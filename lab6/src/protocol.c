@@ -0,0 +1,147 @@
+#include "protocol.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+
+bool ProtoIsHeader(const void *buf) {
+    struct ProtoHeader header;
+    ProtoDecodeHeader(buf, &header);
+    return header.magic == PROTO_MAGIC && header.version == PROTO_VERSION;
+}
+
+void ProtoEncodeHeader(void *buf, enum ProtoType type, uint32_t count) {
+    char *p = (char *)buf;
+    uint32_t magic = PROTO_MAGIC;
+    uint16_t version = PROTO_VERSION;
+    uint16_t type16 = (uint16_t)type;
+    uint32_t reserved = 0;
+    memcpy(p, &magic, 4);
+    memcpy(p + 4, &version, 2);
+    memcpy(p + 6, &type16, 2);
+    memcpy(p + 8, &count, 4);
+    memcpy(p + 12, &reserved, 4);
+}
+
+void ProtoDecodeHeader(const void *buf, struct ProtoHeader *header) {
+    const char *p = (const char *)buf;
+    memcpy(&header->magic, p, 4);
+    memcpy(&header->version, p + 4, 2);
+    memcpy(&header->type, p + 6, 2);
+    memcpy(&header->count, p + 8, 4);
+    memcpy(&header->reserved, p + 12, 4);
+}
+
+void ProtoEncodeTask(void *buf, const struct ProtoTask *task) {
+    char *p = (char *)buf;
+    memcpy(p, &task->id, 8);
+    memcpy(p + 8, &task->begin, 8);
+    memcpy(p + 16, &task->end, 8);
+    memcpy(p + 24, &task->mod, 8);
+}
+
+void ProtoDecodeTask(const void *buf, struct ProtoTask *task) {
+    const char *p = (const char *)buf;
+    memcpy(&task->id, p, 8);
+    memcpy(&task->begin, p + 8, 8);
+    memcpy(&task->end, p + 16, 8);
+    memcpy(&task->mod, p + 24, 8);
+}
+
+void ProtoDecodeLegacy(const void *buf, struct ProtoTask *task) {
+    const char *p = (const char *)buf;
+    task->id = 0;
+    memcpy(&task->begin, p, 8);
+    memcpy(&task->end, p + 8, 8);
+    memcpy(&task->mod, p + 16, 8);
+}
+
+void ProtoEncodeReply(void *buf, const struct ProtoReply *reply) {
+    char *p = (char *)buf;
+    memcpy(p, &reply->id, 8);
+    memcpy(p + 8, &reply->result, 8);
+    memcpy(p + 16, &reply->status, 4);
+    memcpy(p + 20, &reply->info, 4);
+}
+
+void ProtoDecodeReply(const void *buf, struct ProtoReply *reply) {
+    const char *p = (const char *)buf;
+    memcpy(&reply->id, p, 8);
+    memcpy(&reply->result, p + 8, 8);
+    memcpy(&reply->status, p + 16, 4);
+    memcpy(&reply->info, p + 20, 4);
+}
+
+// Поля ProtoStats в порядке передачи
+static void StatsFields(struct ProtoStats *stats, uint64_t **fields) {
+    fields[0] = &stats->uptime_us;
+    fields[1] = &stats->requests;
+    fields[2] = &stats->errors;
+    fields[3] = &stats->bytes_in;
+    fields[4] = &stats->bytes_out;
+    fields[5] = &stats->connections_active;
+    fields[6] = &stats->connections_total;
+    fields[7] = &stats->latency_p50_us;
+    fields[8] = &stats->latency_p99_us;
+    fields[9] = &stats->latency_max_us;
+    fields[10] = &stats->compute_p50_us;
+    fields[11] = &stats->compute_p99_us;
+    fields[12] = &stats->queue_wait_p50_us;
+    fields[13] = &stats->queue_wait_p99_us;
+}
+
+void ProtoEncodeStats(void *buf, const struct ProtoStats *stats) {
+    struct ProtoStats copy = *stats;
+    uint64_t *fields[PROTO_STATS_FIELDS];
+    StatsFields(&copy, fields);
+    char *p = (char *)buf;
+    for (int i = 0; i < PROTO_STATS_FIELDS; i++)
+        memcpy(p + i * 8, fields[i], 8);
+}
+
+void ProtoDecodeStats(const void *buf, uint32_t count,
+                      struct ProtoStats *stats) {
+    uint64_t *fields[PROTO_STATS_FIELDS];
+    StatsFields(stats, fields);
+    const char *p = (const char *)buf;
+    for (uint32_t i = 0; i < PROTO_STATS_FIELDS; i++) {
+        if (i < count)
+            memcpy(fields[i], p + i * 8, 8);
+        else
+            *fields[i] = 0;
+    }
+}
+
+int SendAll(int fd, const void *buf, size_t size) {
+    const char *p = (const char *)buf;
+    size_t sent = 0;
+    while (sent < size) {
+        ssize_t n = send(fd, p + sent, size - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        sent += n;
+    }
+    return (int)size;
+}
+
+int RecvAll(int fd, void *buf, size_t size) {
+    char *p = (char *)buf;
+    size_t received = 0;
+    while (received < size) {
+        ssize_t n = recv(fd, p + received, size - received, 0);
+        if (n == 0)
+            return received == 0 ? 0 : -1;
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        received += n;
+    }
+    return (int)size;
+}
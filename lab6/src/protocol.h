@@ -0,0 +1,120 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Протокол обмена клиента и сервера. Все поля передаются в порядке байт
+// хоста, как и в исходном протоколе.
+//
+// Версия 1 (старая): клиент шлет 24 байта begin, end, mod и ждет 8 байт
+// результата. Сервер по-прежнему принимает такие кадры.
+//
+// Версия 2: кадр начинается с заголовка ProtoHeader, за которым идут count
+// записей. Клиент может отправить много задач одним кадром, сервер
+// отвечает на каждую по мере готовности, сопоставление идет по id.
+// Заголовок отличается от старого кадра первыми восемью байтами (magic,
+// version, type), которые не встречаются как begin на практике.
+//
+// Кадр PROTO_STATS_REQUEST без записей запрашивает счетчики сервера; ответ
+// PROTO_STATS_RESPONSE несет count 8-байтных полей ProtoStats. Новые поля
+// добавляются в конец, старый клиент читает известные и пропускает прочие.
+
+#define PROTO_MAGIC 0x32544346u  // "FCT2"
+#define PROTO_VERSION 2
+
+// Максимальное число записей в одном кадре
+#define PROTO_MAX_COUNT 65536
+
+#define LEGACY_FRAME_SIZE (sizeof(uint64_t) * 3)
+#define LEGACY_REPLY_SIZE sizeof(uint64_t)
+
+#define PROTO_HEADER_SIZE 16
+#define PROTO_TASK_SIZE 32
+#define PROTO_REPLY_SIZE 24
+
+#define PROTO_STATS_FIELDS 14
+#define PROTO_STATS_SIZE (PROTO_STATS_FIELDS * 8)
+
+enum ProtoType {
+    PROTO_REQUEST = 1,         // записи ProtoTask
+    PROTO_RESPONSE = 2,        // записи ProtoReply
+    PROTO_STATS_REQUEST = 3,   // без записей
+    PROTO_STATS_RESPONSE = 4   // count полей ProtoStats
+};
+
+enum ProtoStatus {
+    PROTO_OK = 0,
+    PROTO_BAD_MODULUS = 1
+};
+
+struct ProtoHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t type;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+struct ProtoTask {
+    uint64_t id;
+    uint64_t begin;
+    uint64_t end;
+    uint64_t mod;
+};
+
+struct ProtoReply {
+    uint64_t id;
+    uint64_t result;
+    uint32_t status;
+    uint32_t info;  // флаги пути вычисления FACT_PATH_* (planner.h)
+};
+
+// Счетчики сервера; длительности в микросекундах
+struct ProtoStats {
+    uint64_t uptime_us;
+    uint64_t requests;
+    uint64_t errors;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t connections_active;
+    uint64_t connections_total;
+    uint64_t latency_p50_us;
+    uint64_t latency_p99_us;
+    uint64_t latency_max_us;
+    uint64_t compute_p50_us;
+    uint64_t compute_p99_us;
+    uint64_t queue_wait_p50_us;
+    uint64_t queue_wait_p99_us;
+};
+
+// true, если буфер (не меньше PROTO_HEADER_SIZE байт) начинается с
+// заголовка версии 2, а не со старого кадра
+bool ProtoIsHeader(const void *buf);
+
+void ProtoEncodeHeader(void *buf, enum ProtoType type, uint32_t count);
+void ProtoDecodeHeader(const void *buf, struct ProtoHeader *header);
+
+void ProtoEncodeTask(void *buf, const struct ProtoTask *task);
+void ProtoDecodeTask(const void *buf, struct ProtoTask *task);
+
+// Старый кадр: begin, end, mod по 8 байт; id задачи нулевой
+void ProtoDecodeLegacy(const void *buf, struct ProtoTask *task);
+
+void ProtoEncodeReply(void *buf, const struct ProtoReply *reply);
+void ProtoDecodeReply(const void *buf, struct ProtoReply *reply);
+
+// PROTO_STATS_SIZE байт; при декодировании count - число полей в кадре,
+// недостающие поля обнуляются
+void ProtoEncodeStats(void *buf, const struct ProtoStats *stats);
+void ProtoDecodeStats(const void *buf, uint32_t count,
+                      struct ProtoStats *stats);
+
+// Отправляет/принимает ровно size байт на блокирующем сокете.
+// RecvAll возвращает size, 0 при закрытии соединения до первого байта
+// и -1 при ошибке или обрыве посреди кадра.
+int SendAll(int fd, const void *buf, size_t size);
+int RecvAll(int fd, void *buf, size_t size);
+
+#endif
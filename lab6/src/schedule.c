@@ -0,0 +1,41 @@
+#include "schedule.h"
+
+void SchedulerInit(struct RangeScheduler *sched, uint64_t begin, uint64_t end,
+                   int workers, uint64_t min_chunk) {
+    pthread_mutex_init(&sched->mutex, NULL);
+    sched->next = begin;
+    sched->end = end;
+    sched->exhausted = begin > end;
+    sched->min_chunk = min_chunk > 0 ? min_chunk : 1;
+    sched->workers = workers > 0 ? workers : 1;
+}
+
+void SchedulerDestroy(struct RangeScheduler *sched) {
+    pthread_mutex_destroy(&sched->mutex);
+}
+
+bool SchedulerNext(struct RangeScheduler *sched, uint64_t *begin,
+                   uint64_t *end) {
+    pthread_mutex_lock(&sched->mutex);
+    if (sched->exhausted) {
+        pthread_mutex_unlock(&sched->mutex);
+        return false;
+    }
+
+    uint64_t remaining = sched->end - sched->next + 1;
+    uint64_t chunk = remaining / (2 * (uint64_t)sched->workers);
+    if (chunk < sched->min_chunk)
+        chunk = sched->min_chunk;
+    if (chunk > remaining)
+        chunk = remaining;
+
+    *begin = sched->next;
+    *end = sched->next + chunk - 1;
+    if (*end == sched->end)
+        sched->exhausted = true;
+    else
+        sched->next = *end + 1;
+
+    pthread_mutex_unlock(&sched->mutex);
+    return true;
+}
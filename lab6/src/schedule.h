@@ -0,0 +1,28 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Динамическая раздача диапазона [begin, end] кусками. Размер куска
+// убывает вместе с остатком (guided): remaining / (2 * workers), но не
+// меньше min_chunk, чтобы к концу не оставался один длинный хвост.
+struct RangeScheduler {
+    pthread_mutex_t mutex;
+    uint64_t next;
+    uint64_t end;
+    bool exhausted;
+    uint64_t min_chunk;
+    int workers;
+};
+
+void SchedulerInit(struct RangeScheduler *sched, uint64_t begin, uint64_t end,
+                   int workers, uint64_t min_chunk);
+void SchedulerDestroy(struct RangeScheduler *sched);
+
+// Выдает следующий кусок; false, если раздавать больше нечего
+bool SchedulerNext(struct RangeScheduler *sched, uint64_t *begin,
+                   uint64_t *end);
+
+#endif
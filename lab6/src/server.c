@@ -1,4 +1,5 @@
 #include <limits.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -13,33 +14,309 @@
 
 #include <pthread.h>
 #include "multmodulo.h"
+#include "cache.h"
+#include "compute.h"
+#include "metrics.h"
+#include "pool.h"
+#include "protocol.h"
+#include "server_epoll.h"
+#include "server_uring.h"
+#include "session.h"
+#include "topology.h"
+
+// Размер очереди задач пула
+#define POOL_QUEUE_CAPACITY 1024
+
+// Число записей кэша произведений по умолчанию
+#define DEFAULT_CACHE_SIZE 4096
+
+// Наибольшее число шардов для --shards
+#define MAX_SHARDS 64
+
+// Сетевой цикл сервера
+enum IoBackend {
+    IO_BLOCKING,  // по одному соединению в принимающем потоке
+    IO_EPOLL,     // событийный цикл на epoll
+    IO_URING      // io_uring, если собран и разрешен ядром
+};
+
+static const char *kIoNames[] = {"blocking", "epoll", "uring"};
 
-struct FactorialArgs {
-    uint64_t begin;
-    uint64_t end;
-    uint64_t mod;
+// Шард: свой слушающий сокет на общем порту, свой цикл приема и свои
+// метрики; пул и кэш общие для всех шардов
+struct Shard {
+    int server_fd;
+    enum IoBackend io;
+    struct ServerMetrics metrics;
+    struct ComputeEngine engine;
+    pthread_t thread;
 };
 
-uint64_t Factorial(const struct FactorialArgs *args) {
-    uint64_t ans = 1;
-    
-    for (uint64_t i = args->begin; i <= args->end; i++) {
-        ans = MultModulo(ans, i, args->mod);
+static struct RangeCache *report_cache = NULL;
+static struct Shard *report_shards = NULL;
+static int report_shards_count = 0;
+static struct ServerMetrics *report_pool_metrics = NULL;
+static char report_affinity[128] = "none";
+
+// Печатает метрики и счетчики кэша по сигналу SIGUSR1. Сигнал заблокирован
+// во всех потоках и принимается только здесь через sigwait, поэтому
+// печатать можно без ограничений обработчиков сигналов.
+void *ThreadReporter(void *arg) {
+    sigset_t *set = (sigset_t *)arg;
+    static struct ServerMetrics total;
+    uint64_t last_ns = report_pool_metrics->started_ns;
+    uint64_t last_requests = 0;
+    while (true) {
+        int sig = 0;
+        if (sigwait(set, &sig) != 0)
+            continue;
+
+        // Сумма по шардам и пулу; у пула только ожидание и вычисление
+        memset(&total, 0, sizeof(total));
+        MetricsMerge(&total, report_pool_metrics);
+        for (int i = 0; i < report_shards_count; i++)
+            MetricsMerge(&total, &report_shards[i].metrics);
+
+        // Скорость с предыдущего отчета, остальное - за все время работы
+        uint64_t now = MetricsNow();
+        uint64_t requests = total.requests;
+        double interval = (now - last_ns) / 1e9;
+        MetricsPrint(&total, stdout);
+        for (int i = 0; report_shards_count > 1 && i < report_shards_count; i++) {
+            const struct ServerMetrics *m = &report_shards[i].metrics;
+            printf("Shard %d: requests=%lu connections active=%lu total=%lu, "
+                   "bytes in=%lu out=%lu\n",
+                   i, MetricsLoad(&m->requests),
+                   MetricsLoad(&m->connections_active),
+                   MetricsLoad(&m->connections_total),
+                   MetricsLoad(&m->bytes_in), MetricsLoad(&m->bytes_out));
+        }
+        printf("Affinity: %s\n", report_affinity);
+        printf("Since last report: %lu requests in %.1fs (%.1f/s)\n",
+               requests - last_requests, interval,
+               interval > 0 ? (requests - last_requests) / interval : 0.0);
+        last_ns = now;
+        last_requests = requests;
+
+        struct CacheStats stats;
+        if (report_cache == NULL) {
+            printf("Cache: disabled\n");
+        } else {
+            CacheGetStats(report_cache, &stats);
+            printf("Cache: hits=%lu partial=%lu misses=%lu evictions=%lu "
+                   "size=%zu/%zu\n",
+                   stats.hits, stats.partial, stats.misses, stats.evictions,
+                   stats.size, stats.capacity);
+        }
+        fflush(stdout);
+    }
+    return NULL;
+}
+
+// RecvAll и SendAll с учетом байт в метриках
+static int RecvCounted(const struct ComputeEngine *engine, int fd, void *buf,
+                       size_t size) {
+    int n = RecvAll(fd, buf, size);
+    if (n > 0)
+        MetricsAdd(&engine->metrics->bytes_in, n);
+    return n;
+}
+
+static int SendCounted(const struct ComputeEngine *engine, int fd,
+                       const void *buf, size_t size) {
+    int n = SendAll(fd, buf, size);
+    if (n > 0)
+        MetricsAdd(&engine->metrics->bytes_out, n);
+    return n;
+}
+
+// Считает одну задачу и готовит ответ; счетчики и журнал те же, что у
+// событийных циклов. Возвращает длину ответа в buffer
+// (SESSION_REPLY_SIZE байт), 0 - задача с нулевым модулем в старом кадре
+size_t ComputeTask(const struct ComputeEngine *engine,
+                   const struct ProtoTask *task, bool legacy, char *buffer) {
+    uint64_t started = MetricsNow();
+    if (engine->log_requests)
+        printf("Receive: %lu %lu %lu\n", task->begin, task->end, task->mod);
+
+    struct ProtoReply reply;
+    reply.id = task->id;
+    reply.result = 0;
+    reply.status = PROTO_OK;
+    reply.info = 0;
+    if (task->mod == 0) {
+        fprintf(stderr, "Client sent zero modulus\n");
+        reply.status = PROTO_BAD_MODULUS;
+    } else {
+        // Константы редукции считаются один раз на запрос
+        struct ModContext ctx;
+        ModContextInit(&ctx, task->mod);
+        reply.result = Factorial(engine, &ctx, task->begin, task->end,
+                                 &reply.info);
+    }
+    SessionRecordResult(engine, started, reply.result, reply.info,
+                        reply.status);
+
+    if (legacy && reply.status != PROTO_OK)
+        return 0;
+    return SessionEncodeReply(buffer, legacy, &reply);
+}
+
+// Кадр версии 2 в блокирующем режиме: задачи считаются по очереди,
+// каждый ответ уходит сразу после вычисления
+bool ServeBlockingFrame(int client_fd, const struct ComputeEngine *engine,
+                        const char *head) {
+    struct ProtoHeader header;
+    ProtoDecodeHeader(head, &header);
+    if (header.type == PROTO_STATS_REQUEST && header.count == 0) {
+        char buffer[PROTO_HEADER_SIZE + PROTO_STATS_SIZE];
+        SessionEncodeStats(engine, buffer);
+        return SendCounted(engine, client_fd, buffer, sizeof(buffer)) >= 0;
+    }
+    if (header.type != PROTO_REQUEST || header.count > PROTO_MAX_COUNT) {
+        fprintf(stderr, "Client send wrong data format\n");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header.count; i++) {
+        char buffer[SESSION_REPLY_SIZE];
+        if (RecvCounted(engine, client_fd, buffer, PROTO_TASK_SIZE) <= 0) {
+            fprintf(stderr, "Client read failed\n");
+            return false;
+        }
+
+        struct ProtoTask task;
+        ProtoDecodeTask(buffer, &task);
+        size_t size = ComputeTask(engine, &task, false, buffer);
+        if (SendCounted(engine, client_fd, buffer, size) < 0) {
+            fprintf(stderr, "Can't send data to client\n");
+            return false;
+        }
     }
-    
-    return ans;
+    return true;
 }
 
-void *ThreadFactorial(void *args) {
-    struct FactorialArgs *fargs = (struct FactorialArgs *)args;
-    uint64_t *result = malloc(sizeof(uint64_t));
-    *result = Factorial(fargs);
-    return (void *)result;
+// Исходный режим: соединения обслуживаются по одному в принимающем потоке
+int ServeBlocking(int server_fd, const struct ComputeEngine *engine) {
+    while (true) {
+        struct sockaddr_in client;
+        socklen_t client_len = sizeof(client);
+        int client_fd = accept(server_fd, (struct sockaddr *)&client, &client_len);
+
+        if (client_fd < 0) {
+            fprintf(stderr, "Could not establish new connection\n");
+            continue;
+        }
+        MetricsAdd(&engine->metrics->connections_total, 1);
+        MetricsAdd(&engine->metrics->connections_active, 1);
+
+        while (true) {
+            // Заголовок v2 короче старого кадра, поэтому сначала читаем его
+            char from_client[LEGACY_FRAME_SIZE];
+            int read_bytes = RecvCounted(engine, client_fd, from_client, PROTO_HEADER_SIZE);
+
+            if (read_bytes == 0)
+                break;
+            if (read_bytes < 0) {
+                fprintf(stderr, "Client read failed\n");
+                break;
+            }
+
+            if (ProtoIsHeader(from_client)) {
+                if (!ServeBlockingFrame(client_fd, engine, from_client))
+                    break;
+                continue;
+            }
+
+            if (RecvCounted(engine, client_fd, from_client + PROTO_HEADER_SIZE,
+                        LEGACY_FRAME_SIZE - PROTO_HEADER_SIZE) <= 0) {
+                fprintf(stderr, "Client send wrong data format\n");
+                break;
+            }
+
+            // На старый кадр с нулевым модулем ответить нечем
+            struct ProtoTask task;
+            ProtoDecodeLegacy(from_client, &task);
+            char buffer[SESSION_REPLY_SIZE];
+            size_t size = ComputeTask(engine, &task, true, buffer);
+            if (size == 0)
+                break;
+            if (SendCounted(engine, client_fd, buffer, size) < 0) {
+                fprintf(stderr, "Can't send data to client\n");
+                break;
+            }
+        }
+
+        shutdown(client_fd, SHUT_RDWR);
+        close(client_fd);
+        MetricsSub(&engine->metrics->connections_active, 1);
+    }
+
+    return 0;
+}
+
+// Слушающий сокет на port. С reuse_port несколько сокетов делят один порт,
+// и ядро распределяет входящие соединения между ними по хешу адресов.
+static int OpenListener(int port, bool reuse_port) {
+    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server_fd < 0) {
+        fprintf(stderr, "Can not create server socket!\n");
+        return -1;
+    }
+
+    struct sockaddr_in server;
+    server.sin_family = AF_INET;
+    server.sin_port = htons((uint16_t)port);
+    server.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    int opt_val = 1;
+    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt_val, sizeof(opt_val));
+    if (reuse_port && setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt_val,
+                                 sizeof(opt_val)) < 0) {
+        fprintf(stderr, "Can not set SO_REUSEPORT\n");
+        close(server_fd);
+        return -1;
+    }
+
+    if (bind(server_fd, (struct sockaddr *)&server, sizeof(server)) < 0) {
+        fprintf(stderr, "Can not bind to socket!\n");
+        close(server_fd);
+        return -1;
+    }
+
+    if (listen(server_fd, SOMAXCONN) < 0) {
+        fprintf(stderr, "Could not listen on socket\n");
+        close(server_fd);
+        return -1;
+    }
+    return server_fd;
+}
+
+static int ServeShard(struct Shard *shard) {
+    switch (shard->io) {
+        case IO_URING:
+            return ServeUring(shard->server_fd, &shard->engine);
+        case IO_EPOLL:
+            return ServeEpoll(shard->server_fd, &shard->engine);
+        default:
+            return ServeBlocking(shard->server_fd, &shard->engine);
+    }
+}
+
+void *ThreadShard(void *arg) {
+    if (ServeShard((struct Shard *)arg) != 0)
+        fprintf(stderr, "Shard stopped with error\n");
+    return NULL;
 }
 
 int main(int argc, char **argv) {
     int tnum = -1;
     int port = -1;
+    enum IoBackend io = IO_EPOLL;
+    int cache_size = DEFAULT_CACHE_SIZE;
+    bool log_requests = false;
+    enum AffinityPolicy affinity = AFFINITY_NONE;
+    int shards_count = 1;
 
     while (true) {
         int current_optind = optind ? optind : 1;
@@ -47,6 +324,11 @@ int main(int argc, char **argv) {
         static struct option options[] = {
             {"port", required_argument, 0, 0},
             {"tnum", required_argument, 0, 0},
+            {"io", required_argument, 0, 0},
+            {"cache", required_argument, 0, 0},
+            {"log", no_argument, 0, 0},
+            {"affinity", required_argument, 0, 0},
+            {"shards", required_argument, 0, 0},
             {0, 0, 0, 0}
         };
 
@@ -73,6 +355,44 @@ int main(int argc, char **argv) {
                             return 1;
                         }
                         break;
+                    case 2:
+                        if (strcmp(optarg, "epoll") == 0) {
+                            io = IO_EPOLL;
+                        } else if (strcmp(optarg, "blocking") == 0) {
+                            io = IO_BLOCKING;
+                        } else if (strcmp(optarg, "uring") == 0) {
+                            io = IO_URING;
+                        } else {
+                            fprintf(stderr, "io must be epoll, blocking "
+                                    "or uring\n");
+                            return 1;
+                        }
+                        break;
+                    case 3:
+                        cache_size = atoi(optarg);
+                        if (cache_size < 0) {
+                            fprintf(stderr, "Cache size must be non-negative\n");
+                            return 1;
+                        }
+                        break;
+                    case 4:
+                        log_requests = true;
+                        break;
+                    case 5:
+                        if (!AffinityParse(optarg, &affinity)) {
+                            fprintf(stderr, "affinity must be none, compact, "
+                                    "scatter or physical\n");
+                            return 1;
+                        }
+                        break;
+                    case 6:
+                        shards_count = atoi(optarg);
+                        if (shards_count <= 0 || shards_count > MAX_SHARDS) {
+                            fprintf(stderr, "Number of shards must be from 1 "
+                                    "to %d\n", MAX_SHARDS);
+                            return 1;
+                        }
+                        break;
                     default:
                         printf("Index %d is out of options\n", option_index);
                 }
@@ -86,128 +406,125 @@ int main(int argc, char **argv) {
     }
 
     if (port == -1 || tnum == -1) {
-        fprintf(stderr, "Using: %s --port 20001 --tnum 4\n", argv[0]);
+        fprintf(stderr, "Using: %s --port 20001 --tnum 4 [--io epoll|blocking|uring] "
+                "[--cache 4096] [--log] "
+                "[--affinity none|compact|scatter|physical] [--shards 1]\n",
+                argv[0]);
         return 1;
     }
 
-    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd < 0) {
-        fprintf(stderr, "Can not create server socket!");
-        return 1;
+    // Без поддержки в сборке или в ядре (seccomp, io_uring_disabled)
+    // сервер работает на epoll
+    if (io == IO_URING && !UringAvailable()) {
+        fprintf(stderr, "io_uring is not available, using epoll\n");
+        io = IO_EPOLL;
     }
 
-    struct sockaddr_in server;
-    server.sin_family = AF_INET;
-    server.sin_port = htons((uint16_t)port);
-    server.sin_addr.s_addr = htonl(INADDR_ANY);
-
-    int opt_val = 1;
-    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt_val, sizeof(opt_val));
-
-    int err = bind(server_fd, (struct sockaddr *)&server, sizeof(server));
-    if (err < 0) {
-        fprintf(stderr, "Can not bind to socket!");
+    // Каждый шард слушает свой сокет на том же порту; SO_REUSEPORT нужен
+    // только при нескольких шардах
+    struct Shard *shards = calloc(shards_count, sizeof(struct Shard));
+    if (shards == NULL) {
+        fprintf(stderr, "Can not allocate shards\n");
         return 1;
     }
+    for (int i = 0; i < shards_count; i++) {
+        shards[i].server_fd = OpenListener(port, shards_count > 1);
+        if (shards[i].server_fd < 0)
+            return 1;
+        shards[i].io = io;
+    }
 
-    err = listen(server_fd, 128);
-    if (err < 0) {
-        fprintf(stderr, "Could not listen on socket\n");
+    // Рабочие потоки создаются один раз и живут все время работы сервера
+    // SIGUSR1 блокируется до создания потоков, чтобы его принимал только
+    // поток отчетов
+    static sigset_t report_signals;
+    sigemptyset(&report_signals);
+    sigaddset(&report_signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &report_signals, NULL);
+
+    struct WorkerPool pool;
+    if (PoolInit(&pool, tnum, POOL_QUEUE_CAPACITY) != 0) {
+        fprintf(stderr, "Can not start worker pool\n");
         return 1;
     }
 
-    printf("Server listening at %d with %d threads\n", port, tnum);
-
-    while (true) {
-        struct sockaddr_in client;
-        socklen_t client_len = sizeof(client);
-        int client_fd = accept(server_fd, (struct sockaddr *)&client, &client_len);
-
-        if (client_fd < 0) {
-            fprintf(stderr, "Could not establish new connection\n");
-            continue;
+    // Рабочие потоки закрепляются по политике; цикл событий и поток
+    // отчетов остаются на усмотрение планировщика ОС
+    if (affinity != AFFINITY_NONE) {
+        struct CpuTopology topo;
+        int *order = NULL;
+        int order_count = 0;
+        if (TopologyLoad(&topo, TOPOLOGY_SYSFS) == 0) {
+            order = malloc(sizeof(int) * (topo.count > 0 ? topo.count : 1));
+            if (order != NULL)
+                order_count = TopologyOrder(&topo, affinity, order);
+            snprintf(report_affinity, sizeof(report_affinity),
+                     "%s (%d packages, %d cores, %d cpus)",
+                     AffinityName(affinity), topo.packages, topo.cores,
+                     topo.count);
+            TopologyFree(&topo);
         }
+        if (order_count == 0 ||
+            AffinityApply(pool.threads, pool.threads_count, order,
+                          order_count) != 0) {
+            fprintf(stderr, "Could not pin worker threads, using none\n");
+            snprintf(report_affinity, sizeof(report_affinity), "none");
+        }
+        free(order);
+    }
 
-        while (true) {
-            unsigned int buffer_size = sizeof(uint64_t) * 3;
-            char from_client[buffer_size];
-            int read_bytes = recv(client_fd, from_client, buffer_size, 0);
-
-            if (read_bytes == 0)
-                break;
-            if (read_bytes < 0) {
-                fprintf(stderr, "Client read failed\n");
-                break;
-            }
-            if (read_bytes < buffer_size) {
-                fprintf(stderr, "Client send wrong data format\n");
-                break;
-            }
-
-            pthread_t threads[tnum];
-            struct FactorialArgs args[tnum];
-
-            uint64_t begin = 0;
-            uint64_t end = 0;
-            uint64_t mod = 0;
-            memcpy(&begin, from_client, sizeof(uint64_t));
-            memcpy(&end, from_client + sizeof(uint64_t), sizeof(uint64_t));
-            memcpy(&mod, from_client + 2 * sizeof(uint64_t), sizeof(uint64_t));
-
-            fprintf(stdout, "Receive: %lu %lu %lu\n", begin, end, mod);
-
-            uint64_t range = end - begin + 1;
-            uint64_t numbers_per_thread = range / tnum;
-            uint64_t remainder = range % tnum;
-            uint64_t current = begin;
-
-            for (uint32_t i = 0; i < (uint32_t)tnum; i++) {  // Приведение типа
-                args[i].begin = current;
-                args[i].end = current + numbers_per_thread - 1;
-                
-                if (i < remainder) {
-                    args[i].end++;
-                }
-                
-                if (args[i].end > end) {
-                    args[i].end = end;
-                }
-                
-                args[i].mod = mod;
-                
-                current = args[i].end + 1;
-
-                if (pthread_create(&threads[i], NULL, ThreadFactorial,
-                                   (void *)&args[i])) {
-                    fprintf(stderr, "Error: pthread_create failed!\n");
-                    return 1;
-                }
-            }
+    // Ожидание в очереди и вычисление кусков пул пишет в свои метрики,
+    // остальное - каждый шард в свои
+    static struct ServerMetrics pool_metrics;
+    MetricsInit(&pool_metrics);
+    pool.metrics = &pool_metrics;
+
+    struct RangeCache cache;
+    struct RangeCache *shared_cache = NULL;
+    if (cache_size > 0) {
+        if (CacheInit(&cache, cache_size) != 0) {
+            fprintf(stderr, "Can not allocate cache\n");
+            return 1;
+        }
+        shared_cache = &cache;
+    }
 
-            uint64_t total = 1;
-            for (uint32_t i = 0; i < (uint32_t)tnum; i++) {  // Приведение типа
-                uint64_t *result = NULL;
-                pthread_join(threads[i], (void **)&result);
-                if (result != NULL) {
-                    total = MultModulo(total, *result, mod);
-                    free(result);
-                }
-            }
+    // Журнал по строке на задачу синхронно пишет в stdout из цикла событий,
+    // поэтому по умолчанию выключен; числа доступны через метрики
+    for (int i = 0; i < shards_count; i++) {
+        MetricsInit(&shards[i].metrics);
+        shards[i].engine.pool = &pool;
+        shards[i].engine.cache = shared_cache;
+        shards[i].engine.metrics = &shards[i].metrics;
+        shards[i].engine.log_requests = log_requests;
+    }
+    report_cache = shared_cache;
+    report_shards = shards;
+    report_shards_count = shards_count;
+    report_pool_metrics = &pool_metrics;
+
+    pthread_t reporter;
+    if (pthread_create(&reporter, NULL, ThreadReporter, &report_signals)) {
+        fprintf(stderr, "Error: pthread_create failed!\n");
+        return 1;
+    }
 
-            printf("Result computed: %lu\n", total);
+    printf("Server listening at %d with %d threads (%s), %d shards, "
+           "affinity %s\n", port, tnum, kIoNames[io],
+           shards_count, report_affinity);
+    fflush(stdout);
 
-            char buffer[sizeof(total)];
-            memcpy(buffer, &total, sizeof(total));
-            err = send(client_fd, buffer, sizeof(total), 0);
-            if (err < 0) {
-                fprintf(stderr, "Can't send data to client\n");
-                break;
-            }
+    // Шард 0 обслуживается главным потоком, остальные - своими
+    for (int i = 1; i < shards_count; i++) {
+        if (pthread_create(&shards[i].thread, NULL, ThreadShard, &shards[i])) {
+            fprintf(stderr, "Error: pthread_create failed!\n");
+            return 1;
         }
-
-        shutdown(client_fd, SHUT_RDWR);
-        close(client_fd);
     }
+    int err = ServeShard(&shards[0]);
 
-    return 0;
+    PoolDestroy(&pool);
+    if (shared_cache != NULL)
+        CacheDestroy(shared_cache);
+    return err ? 1 : 0;
 }
\ No newline at end of file
@@ -0,0 +1,277 @@
+#define _GNU_SOURCE
+#include "server_epoll.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#include "compute.h"
+#include "metrics.h"
+#include "session.h"
+
+#define MAX_EVENTS 64
+
+struct EpollServer;
+
+struct Connection {
+    struct Session session;  // первое поле: сессия приводится к соединению
+    int fd;
+    struct EpollServer *server;
+
+    char in[SESSION_IN_SIZE];
+
+    char *out;
+    size_t out_len;
+    size_t out_sent;
+    size_t out_cap;
+
+    uint32_t events;  // текущая подписка в epoll
+    bool released;    // сокет закрыт, память ждет освобождения
+    struct Connection *next_dead;
+};
+
+struct EpollServer {
+    int epoll_fd;
+    int server_fd;
+    struct SessionLoop loop;
+    struct Connection *dead;
+};
+
+// Метки для epoll_event.data.ptr, отличающие служебные дескрипторы
+static char listen_marker;
+static char event_marker;
+
+static void UpdateInterest(struct Connection *conn) {
+    if (conn->session.dead)
+        return;
+
+    uint32_t events = 0;
+    if (!conn->session.peer_eof && conn->session.in_len < SESSION_IN_SIZE)
+        events |= EPOLLIN;
+    if (conn->out_sent < conn->out_len)
+        events |= EPOLLOUT;
+    if (events == conn->events)
+        return;
+
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = conn;
+    epoll_ctl(conn->server->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+    conn->events = events;
+}
+
+// Память освобождается в конце итерации цикла, когда у соединения не
+// осталось запросов в пуле, чтобы не трогать ее из оставшихся событий
+// той же пачки
+static void ReleaseIfIdle(struct Connection *conn) {
+    if (!conn->session.dead || conn->released || conn->session.inflight > 0)
+        return;
+    conn->released = true;
+    conn->next_dead = conn->server->dead;
+    conn->server->dead = conn;
+}
+
+// Сокет закрывается сразу: запросы в пуле держат только память
+static void CloseConnection(struct Session *session) {
+    struct Connection *conn = (struct Connection *)session;
+    epoll_ctl(conn->server->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    shutdown(conn->fd, SHUT_RDWR);
+    close(conn->fd);
+    ReleaseIfIdle(conn);
+}
+
+static bool AppendOutput(struct Session *session, const void *data,
+                         size_t size) {
+    struct Connection *conn = (struct Connection *)session;
+    if (conn->out_sent == conn->out_len) {
+        conn->out_sent = 0;
+        conn->out_len = 0;
+    }
+    if (conn->out_len + size > conn->out_cap) {
+        size_t cap = conn->out_cap ? conn->out_cap * 2 : 64;
+        while (cap < conn->out_len + size)
+            cap *= 2;
+        char *out = realloc(conn->out, cap);
+        if (out == NULL)
+            return false;
+        conn->out = out;
+        conn->out_cap = cap;
+    }
+    memcpy(conn->out + conn->out_len, data, size);
+    conn->out_len += size;
+    return true;
+}
+
+static void FlushOutput(struct Connection *conn) {
+    while (!conn->session.dead && conn->out_sent < conn->out_len) {
+        ssize_t sent = send(conn->fd, conn->out + conn->out_sent,
+                            conn->out_len - conn->out_sent, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "Can't send data to client\n");
+            SessionClose(&conn->session);
+            return;
+        }
+        conn->out_sent += sent;
+        MetricsAdd(&conn->server->loop.engine->metrics->bytes_out, sent);
+    }
+}
+
+// После любого события соединения: досылка, закрытие, новая подписка
+static void Rearm(struct Session *session) {
+    struct Connection *conn = (struct Connection *)session;
+    FlushOutput(conn);
+    SessionFinishIfDrained(session, conn->out_sent == conn->out_len);
+    UpdateInterest(conn);
+    ReleaseIfIdle(conn);
+}
+
+static const struct SessionOps kEpollOps = {AppendOutput, CloseConnection,
+                                            Rearm};
+
+static void HandleReadable(struct Connection *conn) {
+    struct Session *session = &conn->session;
+    while (!session->peer_eof && session->in_len < SESSION_IN_SIZE) {
+        ssize_t read_bytes = recv(conn->fd, session->in + session->in_len,
+                                  SESSION_IN_SIZE - session->in_len, 0);
+        if (read_bytes == 0) {
+            session->peer_eof = true;
+            break;
+        }
+        if (read_bytes < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "Client read failed\n");
+            SessionClose(session);
+            return;
+        }
+        session->in_len += read_bytes;
+        MetricsAdd(&conn->server->loop.engine->metrics->bytes_in, read_bytes);
+    }
+
+    SessionProcessInput(session);
+    Rearm(session);
+}
+
+static void HandleCompleted(struct EpollServer *server) {
+    uint64_t value;
+    if (read(server->loop.event_fd, &value, sizeof(value)) < 0 &&
+        errno != EAGAIN)
+        fprintf(stderr, "Can't read event counter\n");
+    SessionHandleCompleted(&server->loop);
+}
+
+static void HandleAccept(struct EpollServer *server) {
+    while (true) {
+        int client_fd = accept4(server->server_fd, NULL, NULL, SOCK_NONBLOCK);
+        if (client_fd < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                fprintf(stderr, "Could not establish new connection\n");
+            return;
+        }
+
+        struct Connection *conn = calloc(1, sizeof(struct Connection));
+        if (conn == NULL) {
+            fprintf(stderr, "Out of memory for connection\n");
+            close(client_fd);
+            continue;
+        }
+        SessionInit(&conn->session, &server->loop, conn->in);
+        conn->fd = client_fd;
+        conn->server = server;
+        conn->events = EPOLLIN;
+        MetricsAdd(&server->loop.engine->metrics->connections_total, 1);
+        MetricsAdd(&server->loop.engine->metrics->connections_active, 1);
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = conn;
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) < 0) {
+            fprintf(stderr, "Can't watch client socket\n");
+            MetricsSub(&server->loop.engine->metrics->connections_active, 1);
+            close(client_fd);
+            free(conn);
+        }
+    }
+}
+
+static void FreeDeadConnections(struct EpollServer *server) {
+    while (server->dead != NULL) {
+        struct Connection *conn = server->dead;
+        server->dead = conn->next_dead;
+        free(conn->out);
+        free(conn);
+    }
+}
+
+int ServeEpoll(int server_fd, const struct ComputeEngine *engine) {
+    struct EpollServer server;
+    memset(&server, 0, sizeof(server));
+    server.server_fd = server_fd;
+
+    int flags = fcntl(server_fd, F_GETFL, 0);
+    fcntl(server_fd, F_SETFL, flags | O_NONBLOCK);
+
+    server.epoll_fd = epoll_create1(0);
+    int event_fd = eventfd(0, EFD_NONBLOCK);
+    if (server.epoll_fd < 0 || event_fd < 0) {
+        fprintf(stderr, "Can not create epoll instance\n");
+        return 1;
+    }
+    SessionLoopInit(&server.loop, engine, &kEpollOps, event_fd);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &listen_marker;
+    epoll_ctl(server.epoll_fd, EPOLL_CTL_ADD, server_fd, &ev);
+    ev.events = EPOLLIN;
+    ev.data.ptr = &event_marker;
+    epoll_ctl(server.epoll_fd, EPOLL_CTL_ADD, event_fd, &ev);
+
+    struct epoll_event events[MAX_EVENTS];
+    while (true) {
+        int ready = epoll_wait(server.epoll_fd, events, MAX_EVENTS, -1);
+        if (ready < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "epoll_wait failed\n");
+            return 1;
+        }
+
+        for (int i = 0; i < ready; i++) {
+            void *ptr = events[i].data.ptr;
+            if (ptr == &listen_marker) {
+                HandleAccept(&server);
+            } else if (ptr == &event_marker) {
+                HandleCompleted(&server);
+            } else {
+                struct Connection *conn = (struct Connection *)ptr;
+                if (conn->session.dead)
+                    continue;
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                    HandleReadable(conn);
+                if (events[i].events & EPOLLOUT)
+                    Rearm(&conn->session);
+            }
+        }
+
+        FreeDeadConnections(&server);
+    }
+
+    return 0;
+}
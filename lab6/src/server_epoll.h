@@ -0,0 +1,11 @@
+#ifndef SERVER_EPOLL_H
+#define SERVER_EPOLL_H
+
+#include "compute.h"
+
+// Событийный цикл на epoll: обслуживает много соединений одним потоком,
+// а вычисления передает в пул. engine->metrics обязателен. Возвращает
+// управление только при ошибке.
+int ServeEpoll(int server_fd, const struct ComputeEngine *engine);
+
+#endif
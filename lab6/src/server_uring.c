@@ -0,0 +1,519 @@
+#define _GNU_SOURCE
+#include "server_uring.h"
+
+#include <stdio.h>
+
+#ifdef HAVE_IO_URING
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include "metrics.h"
+#include "session.h"
+
+#define RING_ENTRIES 256
+
+// Сколько соединений принимают данные в зарегистрированные буферы;
+// остальные читают обычным recv в свою память
+#define FIXED_SLOTS 256
+
+// Тип операции в младших битах user_data указателя на соединение
+#define OP_RECV 1u
+#define OP_SEND 2u
+#define OP_MASK 3u
+
+// Кольца io_uring, отображенные в память процесса. liburing не нужен:
+// хватает трех системных вызовов и заголовка ядра.
+struct Uring {
+    int fd;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned sq_entries;
+    unsigned sq_local_tail;  // заполненные, но еще не опубликованные SQE
+    struct io_uring_sqe *sqes;
+
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ptr;
+    size_t sq_size;
+    void *cq_ptr;
+    size_t cq_size;
+    size_t sqes_size;
+};
+
+struct UringServer;
+
+// Прием в кольце отмечается session.in_busy: ядро пишет в буфер
+// сессии (зарегистрированный слот или своя память)
+struct Connection {
+    struct Session session;  // первое поле: сессия приводится к соединению
+    int fd;
+    struct UringServer *server;
+    int slot;       // номер слота приема, -1 - память из malloc
+
+    char *out;
+    char *out_retired;  // прежний out, который еще читает отправка в кольце
+    size_t out_len;
+    size_t out_sent;
+    size_t out_cap;
+
+    bool send_pending;  // в кольце есть отправка для соединения
+    bool released;      // дескриптор закрыт, память ждет освобождения
+    struct Connection *next_dead;
+};
+
+struct UringServer {
+    struct Uring ring;
+    uint64_t event_value;
+    int server_fd;
+    bool multishot;     // accept с IORING_ACCEPT_MULTISHOT (ядро 5.19+)
+    struct SessionLoop loop;
+
+    // Зарегистрированная область FIXED_SLOTS * SESSION_IN_SIZE байт
+    char *fixed;
+    int free_slots[FIXED_SLOTS];
+    int free_slots_count;
+
+    struct Connection *dead;
+};
+
+// Метки для user_data служебных операций
+static char accept_marker;
+static char event_marker;
+
+static int UringSetup(struct Uring *ring, unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(*ring));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 4;
+
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0)
+        return -1;
+
+    ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_size = params.cq_off.cqes +
+                    params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) {
+        if (ring->cq_size > ring->sq_size)
+            ring->sq_size = ring->cq_size;
+        ring->cq_size = ring->sq_size;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        close(ring->fd);
+        return -1;
+    }
+    ring->cq_ptr = single ? ring->sq_ptr
+                          : mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_POPULATE, ring->fd,
+                                 IORING_OFF_CQ_RING);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->cq_ptr == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        close(ring->fd);
+        return -1;
+    }
+
+    char *sq = ring->sq_ptr;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->sq_entries = params.sq_entries;
+    ring->sq_local_tail = *ring->sq_tail;
+
+    char *cq = ring->cq_ptr;
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return 0;
+}
+
+static void UringDestroy(struct Uring *ring) {
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ptr != ring->sq_ptr)
+        munmap(ring->cq_ptr, ring->cq_size);
+    munmap(ring->sq_ptr, ring->sq_size);
+    close(ring->fd);
+}
+
+// Публикует накопленные SQE и, если wait, ждет хотя бы одно завершение.
+// Все операции, подготовленные за проход по завершениям, уходят в ядро
+// одним вызовом.
+static int UringEnter(struct Uring *ring, bool wait) {
+    unsigned to_submit = ring->sq_local_tail - *ring->sq_tail;
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    while (true) {
+        long ret = syscall(__NR_io_uring_enter, ring->fd, to_submit,
+                           wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0,
+                           NULL, 0);
+        if (ret >= 0)
+            return 0;
+        if (errno == EINTR)
+            continue;
+        // Очередь завершений переполнена: сначала нужно ее разобрать
+        if (errno == EBUSY || errno == EAGAIN)
+            return 0;
+        return -1;
+    }
+}
+
+static struct io_uring_sqe *UringGetSqe(struct Uring *ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_local_tail - head == ring->sq_entries) {
+        UringEnter(ring, false);
+        head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        if (ring->sq_local_tail - head == ring->sq_entries)
+            return NULL;
+    }
+    unsigned index = ring->sq_local_tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    ring->sq_local_tail++;
+    return sqe;
+}
+
+static void SubmitAccept(struct UringServer *server) {
+    struct io_uring_sqe *sqe = UringGetSqe(&server->ring);
+    if (sqe == NULL) {
+        fprintf(stderr, "Submission queue is full\n");
+        return;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = server->server_fd;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    if (server->multishot)
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = (uintptr_t)&accept_marker;
+}
+
+static void SubmitEventRead(struct UringServer *server) {
+    struct io_uring_sqe *sqe = UringGetSqe(&server->ring);
+    if (sqe == NULL) {
+        fprintf(stderr, "Submission queue is full\n");
+        return;
+    }
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = server->loop.event_fd;
+    sqe->addr = (uintptr_t)&server->event_value;
+    sqe->len = sizeof(server->event_value);
+    sqe->user_data = (uintptr_t)&event_marker;
+}
+
+// Ставит в кольцо прием и отправку, которых соединению не хватает
+static void ArmConnection(struct Connection *conn) {
+    struct Uring *ring = &conn->server->ring;
+    struct Session *session = &conn->session;
+    if (session->dead)
+        return;
+
+    if (!session->in_busy && !session->peer_eof &&
+        session->in_len < SESSION_IN_SIZE) {
+        struct io_uring_sqe *sqe = UringGetSqe(ring);
+        if (sqe != NULL) {
+            // Зарегистрированный буфер избавляет ядро от отображения
+            // страниц на каждом приеме
+            sqe->opcode = conn->slot >= 0 ? IORING_OP_READ_FIXED : IORING_OP_RECV;
+            sqe->fd = conn->fd;
+            sqe->addr = (uintptr_t)(session->in + session->in_len);
+            sqe->len = SESSION_IN_SIZE - session->in_len;
+            sqe->buf_index = 0;
+            sqe->user_data = (uintptr_t)conn | OP_RECV;
+            session->in_busy = true;
+        }
+    }
+
+    if (!conn->send_pending && conn->out_sent < conn->out_len) {
+        struct io_uring_sqe *sqe = UringGetSqe(ring);
+        if (sqe != NULL) {
+            sqe->opcode = IORING_OP_SEND;
+            sqe->fd = conn->fd;
+            sqe->addr = (uintptr_t)(conn->out + conn->out_sent);
+            sqe->len = conn->out_len - conn->out_sent;
+            sqe->msg_flags = MSG_NOSIGNAL;
+            sqe->user_data = (uintptr_t)conn | OP_SEND;
+            conn->send_pending = true;
+        }
+    }
+}
+
+// Дескриптор закрывается только после завершения всех операций
+// соединения в кольце, иначе номер может достаться новому соединению
+static void ReleaseIfIdle(struct Connection *conn) {
+    if (!conn->session.dead || conn->released || conn->session.in_busy ||
+        conn->send_pending || conn->session.inflight > 0)
+        return;
+    conn->released = true;
+    close(conn->fd);
+    conn->next_dead = conn->server->dead;
+    conn->server->dead = conn;
+}
+
+// shutdown завершает ожидающие прием и отправку соединения
+static void CloseConnection(struct Session *session) {
+    struct Connection *conn = (struct Connection *)session;
+    shutdown(conn->fd, SHUT_RDWR);
+    ReleaseIfIdle(conn);
+}
+
+// Пока отправка в кольце, ядро читает out, поэтому буфер не сдвигается,
+// а при росте старый сохраняется до завершения отправки
+static bool AppendOutput(struct Session *session, const void *data,
+                         size_t size) {
+    struct Connection *conn = (struct Connection *)session;
+    if (!conn->send_pending && conn->out_sent == conn->out_len) {
+        conn->out_sent = 0;
+        conn->out_len = 0;
+    }
+    if (conn->out_len + size > conn->out_cap) {
+        size_t cap = conn->out_cap ? conn->out_cap * 2 : 64;
+        while (cap < conn->out_len + size)
+            cap *= 2;
+        char *out = malloc(cap);
+        if (out == NULL)
+            return false;
+        if (conn->out_len > 0)
+            memcpy(out, conn->out, conn->out_len);
+        if (conn->send_pending && conn->out_retired == NULL)
+            conn->out_retired = conn->out;
+        else
+            free(conn->out);
+        conn->out = out;
+        conn->out_cap = cap;
+    }
+    memcpy(conn->out + conn->out_len, data, size);
+    conn->out_len += size;
+    return true;
+}
+
+// После любого события соединения: закрытие опустевшего, новые операции
+static void Rearm(struct Session *session) {
+    struct Connection *conn = (struct Connection *)session;
+    SessionFinishIfDrained(session, !conn->send_pending &&
+                                        conn->out_sent == conn->out_len);
+    ArmConnection(conn);
+    ReleaseIfIdle(conn);
+}
+
+static const struct SessionOps kUringOps = {AppendOutput, CloseConnection,
+                                            Rearm};
+
+static void HandleRecv(struct Connection *conn, int res) {
+    struct Session *session = &conn->session;
+    session->in_busy = false;
+    if (res == 0) {
+        session->peer_eof = true;
+    } else if (res < 0) {
+        if (!session->dead && res != -ECONNRESET)
+            fprintf(stderr, "Client read failed\n");
+        SessionClose(session);
+    } else {
+        session->in_len += res;
+        MetricsAdd(&conn->server->loop.engine->metrics->bytes_in, res);
+    }
+    SessionProcessInput(session);
+    Rearm(session);
+}
+
+static void HandleSend(struct Connection *conn, int res) {
+    conn->send_pending = false;
+    free(conn->out_retired);
+    conn->out_retired = NULL;
+    if (res < 0) {
+        if (!conn->session.dead)
+            fprintf(stderr, "Can't send data to client\n");
+        SessionClose(&conn->session);
+    } else {
+        conn->out_sent += res;
+        MetricsAdd(&conn->server->loop.engine->metrics->bytes_out, res);
+    }
+    SessionProcessInput(&conn->session);
+    Rearm(&conn->session);
+}
+
+static void HandleAccept(struct UringServer *server, int res, uint32_t flags) {
+    // Без IORING_CQE_F_MORE многоразовый accept снят и ставится заново
+    if (!(flags & IORING_CQE_F_MORE)) {
+        if (res == -EINVAL && server->multishot) {
+            // Ядро старше 5.19: принимаем по одному соединению на операцию
+            server->multishot = false;
+        }
+        SubmitAccept(server);
+    }
+    if (res < 0) {
+        if (res != -EINVAL && res != -EAGAIN && res != -EINTR)
+            fprintf(stderr, "Could not establish new connection\n");
+        return;
+    }
+
+    struct Connection *conn = calloc(1, sizeof(struct Connection));
+    if (conn == NULL) {
+        fprintf(stderr, "Out of memory for connection\n");
+        close(res);
+        return;
+    }
+    char *in;
+    conn->fd = res;
+    conn->server = server;
+    conn->slot = -1;
+    if (server->free_slots_count > 0) {
+        conn->slot = server->free_slots[--server->free_slots_count];
+        in = server->fixed + (size_t)conn->slot * SESSION_IN_SIZE;
+    } else {
+        in = malloc(SESSION_IN_SIZE);
+        if (in == NULL) {
+            fprintf(stderr, "Out of memory for connection\n");
+            close(res);
+            free(conn);
+            return;
+        }
+    }
+    SessionInit(&conn->session, &server->loop, in);
+    MetricsAdd(&server->loop.engine->metrics->connections_total, 1);
+    MetricsAdd(&server->loop.engine->metrics->connections_active, 1);
+    ArmConnection(conn);
+}
+
+static void FreeDeadConnections(struct UringServer *server) {
+    while (server->dead != NULL) {
+        struct Connection *conn = server->dead;
+        server->dead = conn->next_dead;
+        if (conn->slot >= 0)
+            server->free_slots[server->free_slots_count++] = conn->slot;
+        else
+            free(conn->session.in);
+        free(conn->out);
+        free(conn);
+    }
+}
+
+bool UringAvailable(void) {
+    struct Uring ring;
+    if (UringSetup(&ring, 8) != 0)
+        return false;
+
+    static const int kOps[] = {IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SEND,
+                               IORING_OP_READ, IORING_OP_READ_FIXED};
+    size_t size = sizeof(struct io_uring_probe) +
+                  IORING_OP_LAST * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, size);
+    bool ok = probe != NULL &&
+              syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_PROBE,
+                      probe, IORING_OP_LAST) >= 0;
+    for (size_t i = 0; ok && i < sizeof(kOps) / sizeof(kOps[0]); i++) {
+        ok = kOps[i] <= probe->last_op &&
+             (probe->ops[kOps[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    UringDestroy(&ring);
+    return ok;
+}
+
+int ServeUring(int server_fd, const struct ComputeEngine *engine) {
+    // У каждого шарда свой цикл и свое кольцо
+    struct UringServer *server = calloc(1, sizeof(struct UringServer));
+    if (server == NULL) {
+        fprintf(stderr, "Can not allocate io_uring server\n");
+        return 1;
+    }
+    server->server_fd = server_fd;
+    server->multishot = true;
+
+    int event_fd = eventfd(0, 0);
+    if (event_fd < 0 || UringSetup(&server->ring, RING_ENTRIES) != 0) {
+        fprintf(stderr, "Can not create io_uring instance\n");
+        return 1;
+    }
+    SessionLoopInit(&server->loop, engine, &kUringOps, event_fd);
+
+    // Слоты приема регистрируются один раз; если ядро отказало (например,
+    // по RLIMIT_MEMLOCK), все соединения читают обычным recv
+    size_t fixed_size = (size_t)FIXED_SLOTS * SESSION_IN_SIZE;
+    server->fixed = mmap(NULL, fixed_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    struct iovec iov = {server->fixed, fixed_size};
+    if (server->fixed != MAP_FAILED &&
+        syscall(__NR_io_uring_register, server->ring.fd,
+                IORING_REGISTER_BUFFERS, &iov, 1) == 0) {
+        for (int i = FIXED_SLOTS - 1; i >= 0; i--)
+            server->free_slots[server->free_slots_count++] = i;
+    } else {
+        fprintf(stderr, "Can not register buffers, using plain recv\n");
+    }
+
+    SubmitAccept(server);
+    SubmitEventRead(server);
+
+    struct Uring *ring = &server->ring;
+    while (true) {
+        if (UringEnter(ring, true) != 0) {
+            fprintf(stderr, "io_uring_enter failed\n");
+            return 1;
+        }
+
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            struct io_uring_cqe cqe = ring->cqes[head & *ring->cq_mask];
+            head++;
+            __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+            if (cqe.user_data == (uintptr_t)&accept_marker) {
+                HandleAccept(server, cqe.res, cqe.flags);
+            } else if (cqe.user_data == (uintptr_t)&event_marker) {
+                SessionHandleCompleted(&server->loop);
+                SubmitEventRead(server);
+            } else {
+                struct Connection *conn = (struct Connection *)(uintptr_t)(
+                    cqe.user_data & ~(uint64_t)OP_MASK);
+                if ((cqe.user_data & OP_MASK) == OP_RECV)
+                    HandleRecv(conn, cqe.res);
+                else
+                    HandleSend(conn, cqe.res);
+            }
+            tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        }
+
+        FreeDeadConnections(server);
+    }
+
+    return 0;
+}
+
+#else
+
+bool UringAvailable(void) {
+    return false;
+}
+
+int ServeUring(int server_fd, const struct ComputeEngine *engine) {
+    (void)server_fd;
+    (void)engine;
+    fprintf(stderr, "Server was built without io_uring\n");
+    return 1;
+}
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef SERVER_URING_H
+#define SERVER_URING_H
+
+#include <stdbool.h>
+
+#include "compute.h"
+
+// Есть ли io_uring: сервер собран с HAVE_IO_URING, ядро разрешает
+// io_uring_setup и поддерживает нужные операции
+bool UringAvailable(void);
+
+// Цикл на io_uring с тем же протоколом, что и ServeEpoll: многоразовый
+// accept, прием в зарегистрированные буферы, отправка и прием всех
+// соединений одной пачкой на io_uring_enter. engine->metrics обязателен.
+// Возвращает управление только при ошибке.
+int ServeUring(int server_fd, const struct ComputeEngine *engine);
+
+#endif
@@ -0,0 +1,278 @@
+#include "session.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "metrics.h"
+
+void SessionLoopInit(struct SessionLoop *loop,
+                     const struct ComputeEngine *engine,
+                     const struct SessionOps *ops, int event_fd) {
+    memset(loop, 0, sizeof(*loop));
+    loop->engine = engine;
+    loop->ops = ops;
+    loop->event_fd = event_fd;
+    pthread_mutex_init(&loop->done_mutex, NULL);
+}
+
+void SessionInit(struct Session *session, struct SessionLoop *loop, char *in) {
+    memset(session, 0, sizeof(*session));
+    session->loop = loop;
+    session->in = in;
+}
+
+void SessionClose(struct Session *session) {
+    if (session->dead)
+        return;
+    session->dead = true;
+    MetricsSub(&session->loop->engine->metrics->connections_active, 1);
+    session->loop->ops->close(session);
+}
+
+void SessionRecordResult(const struct ComputeEngine *engine,
+                         uint64_t started_ns, uint64_t result, uint32_t path,
+                         uint32_t status) {
+    if (status == PROTO_OK) {
+        MetricsAdd(&engine->metrics->requests, 1);
+        HistRecord(&engine->metrics->latency, MetricsNow() - started_ns);
+    } else {
+        MetricsAdd(&engine->metrics->errors, 1);
+    }
+    if (engine->log_requests && status == PROTO_OK) {
+        char name[64];
+        FactPathFormat(path, name, sizeof(name));
+        printf("Result computed: %lu (%s)\n", result, name);
+    }
+}
+
+size_t SessionEncodeReply(void *buf, bool legacy, const struct ProtoReply *reply) {
+    if (legacy) {
+        memcpy(buf, &reply->result, LEGACY_REPLY_SIZE);
+        return LEGACY_REPLY_SIZE;
+    }
+    ProtoEncodeHeader(buf, PROTO_RESPONSE, 1);
+    ProtoEncodeReply((char *)buf + PROTO_HEADER_SIZE, reply);
+    return SESSION_REPLY_SIZE;
+}
+
+void SessionEncodeStats(const struct ComputeEngine *engine, void *buf) {
+    struct ProtoStats stats;
+    EngineFillStats(engine, &stats);
+    ProtoEncodeHeader(buf, PROTO_STATS_RESPONSE, PROTO_STATS_FIELDS);
+    ProtoEncodeStats((char *)buf + PROTO_HEADER_SIZE, &stats);
+}
+
+static void Append(struct Session *session, const void *data, size_t size) {
+    if (!session->loop->ops->append(session, data, size)) {
+        fprintf(stderr, "Out of memory for client output\n");
+        SessionClose(session);
+    }
+}
+
+static void SendResult(struct Session *session,
+                       const struct RangeRequest *req, uint32_t status) {
+    SessionRecordResult(session->loop->engine, req->started_ns, req->result,
+                        req->path, status);
+
+    struct ProtoReply reply;
+    reply.id = req->id;
+    reply.result = req->result;
+    reply.status = status;
+    reply.info = req->path;
+    char buffer[SESSION_REPLY_SIZE];
+    Append(session, buffer, SessionEncodeReply(buffer, req->legacy, &reply));
+}
+
+// Ответ на кадр статистики уходит сразу, не дожидаясь начатых задач
+static void SendStats(struct Session *session) {
+    char buffer[PROTO_HEADER_SIZE + PROTO_STATS_SIZE];
+    SessionEncodeStats(session->loop->engine, buffer);
+    Append(session, buffer, sizeof(buffer));
+}
+
+static void OnRequestDone(struct PoolBatch *batch) {
+    struct RangeRequest *req = (struct RangeRequest *)batch->arg;
+    struct Session *session = (struct Session *)req->owner;
+    struct SessionLoop *loop = session->loop;
+
+    req->next = NULL;
+    pthread_mutex_lock(&loop->done_mutex);
+    if (loop->done_tail != NULL)
+        loop->done_tail->next = req;
+    else
+        loop->done_head = req;
+    loop->done_tail = req;
+    pthread_mutex_unlock(&loop->done_mutex);
+
+    uint64_t one = 1;
+    if (write(loop->event_fd, &one, sizeof(one)) < 0)
+        fprintf(stderr, "Can't wake up event loop\n");
+}
+
+static struct RangeRequest *AllocRequest(struct SessionLoop *loop) {
+    struct RangeRequest *req = loop->free_requests;
+    if (req != NULL) {
+        loop->free_requests = req->next;
+        return req;
+    }
+
+    req = malloc(sizeof(struct RangeRequest));
+    if (req == NULL)
+        return NULL;
+    if (RangeRequestInit(req, loop->engine->pool->threads_count) != 0) {
+        free(req);
+        return NULL;
+    }
+    return req;
+}
+
+static void ReleaseRequest(struct SessionLoop *loop, struct RangeRequest *req) {
+    req->next = loop->free_requests;
+    loop->free_requests = req;
+}
+
+// Начинает вычисление одной задачи; короткие отвечаются сразу
+static void StartTask(struct Session *session, const struct ProtoTask *task,
+                      bool legacy) {
+    struct SessionLoop *loop = session->loop;
+    uint64_t started = MetricsNow();
+
+    if (loop->engine->log_requests)
+        printf("Receive: %lu %lu %lu\n", task->begin, task->end, task->mod);
+
+    if (task->mod == 0) {
+        fprintf(stderr, "Client sent zero modulus\n");
+        if (legacy) {
+            SessionClose(session);
+        } else {
+            struct RangeRequest bad;
+            bad.id = task->id;
+            bad.legacy = false;
+            bad.result = 0;
+            bad.path = 0;
+            bad.started_ns = started;
+            SendResult(session, &bad, PROTO_BAD_MODULUS);
+        }
+        return;
+    }
+
+    struct RangeRequest *req = AllocRequest(loop);
+    if (req == NULL) {
+        fprintf(stderr, "Out of memory for request\n");
+        SessionClose(session);
+        return;
+    }
+    ModContextInit(&req->ctx, task->mod);
+    req->begin = task->begin;
+    req->end = task->end;
+    req->id = task->id;
+    req->legacy = legacy;
+    req->owner = session;
+    req->started_ns = started;
+
+    if (RangeRequestStart(loop->engine, req, OnRequestDone)) {
+        SendResult(session, req, PROTO_OK);
+        ReleaseRequest(loop, req);
+    } else {
+        session->inflight++;
+        session->legacy_pending = legacy;
+    }
+}
+
+void SessionProcessInput(struct Session *session) {
+    size_t offset = session->in_start;
+
+    while (!session->dead && !session->legacy_pending &&
+           session->inflight < SESSION_MAX_INFLIGHT) {
+        const char *data = session->in + offset;
+        size_t available = session->in_len - offset;
+        struct ProtoTask task;
+
+        if (session->frame_remaining > 0) {
+            if (available < PROTO_TASK_SIZE)
+                break;
+            ProtoDecodeTask(data, &task);
+            offset += PROTO_TASK_SIZE;
+            session->frame_remaining--;
+            StartTask(session, &task, false);
+            continue;
+        }
+
+        if (available < PROTO_HEADER_SIZE)
+            break;
+
+        if (ProtoIsHeader(data)) {
+            struct ProtoHeader header;
+            ProtoDecodeHeader(data, &header);
+            if (header.type == PROTO_STATS_REQUEST && header.count == 0) {
+                offset += PROTO_HEADER_SIZE;
+                SendStats(session);
+                continue;
+            }
+            if (header.type != PROTO_REQUEST ||
+                header.count > PROTO_MAX_COUNT) {
+                fprintf(stderr, "Client send wrong data format\n");
+                SessionClose(session);
+                break;
+            }
+            offset += PROTO_HEADER_SIZE;
+            session->frame_remaining = header.count;
+            continue;
+        }
+
+        // Старый кадр отвечается по порядку после всех начатых запросов
+        if (available < LEGACY_FRAME_SIZE || session->inflight > 0)
+            break;
+        ProtoDecodeLegacy(data, &task);
+        offset += LEGACY_FRAME_SIZE;
+        StartTask(session, &task, true);
+    }
+
+    // Пока ядро пишет в хвост in, буфер сдвигается позже
+    session->in_start = offset;
+    if (!session->in_busy && session->in_start > 0) {
+        memmove(session->in, session->in + session->in_start,
+                session->in_len - session->in_start);
+        session->in_len -= session->in_start;
+        session->in_start = 0;
+    }
+}
+
+void SessionFinishIfDrained(struct Session *session, bool out_empty) {
+    if (!session->dead && session->peer_eof && session->inflight == 0 &&
+        out_empty) {
+        if (session->in_len > session->in_start)
+            fprintf(stderr, "Client send wrong data format\n");
+        SessionClose(session);
+    }
+}
+
+void SessionHandleCompleted(struct SessionLoop *loop) {
+    pthread_mutex_lock(&loop->done_mutex);
+    struct RangeRequest *req = loop->done_head;
+    loop->done_head = NULL;
+    loop->done_tail = NULL;
+    pthread_mutex_unlock(&loop->done_mutex);
+
+    while (req != NULL) {
+        struct RangeRequest *next = req->next;
+        struct Session *session = (struct Session *)req->owner;
+
+        RangeRequestFinish(req);
+        session->inflight--;
+        if (req->legacy)
+            session->legacy_pending = false;
+
+        // Клиент мог уйти, пока шло вычисление
+        if (!session->dead) {
+            SendResult(session, req, PROTO_OK);
+            SessionProcessInput(session);
+        }
+        loop->ops->rearm(session);
+
+        ReleaseRequest(loop, req);
+        req = next;
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pthread.h>
+
+#include "compute.h"
+#include "protocol.h"
+
+// Протокол соединения для событийных циклов (epoll и io_uring): разбор
+// кадров, запуск задач в пуле, ответы и кадр статистики. Цикл хранит
+// struct Session первым полем своего соединения, сам читает и пишет
+// сокет и дает SessionOps для всего, что зависит от способа ввода-вывода.
+
+// Размер буфера приема одного соединения
+#define SESSION_IN_SIZE 16384
+
+// Сколько запросов одного соединения может считаться одновременно
+#define SESSION_MAX_INFLIGHT 256
+
+// Наибольший ответ на одну задачу: заголовок и запись версии 2
+#define SESSION_REPLY_SIZE (PROTO_HEADER_SIZE + PROTO_REPLY_SIZE)
+
+struct Session;
+
+struct SessionOps {
+    // Дописывает data в очередь отправки; false - нет памяти
+    bool (*append)(struct Session *session, const void *data, size_t size);
+    // Закрывает сокет; session->dead уже выставлен
+    void (*close)(struct Session *session);
+    // Вызывается после изменения состояния сессии: отправить накопленное,
+    // закрыть опустевшее соединение, поставить прием и отправку заново,
+    // освободить закрытое соединение без запросов в пуле
+    void (*rearm)(struct Session *session);
+};
+
+// Общее для всех соединений одного цикла
+struct SessionLoop {
+    const struct ComputeEngine *engine;
+    const struct SessionOps *ops;
+    int event_fd;  // eventfd цикла: в него пишут рабочие потоки
+
+    // Запросы, завершенные рабочими потоками
+    pthread_mutex_t done_mutex;
+    struct RangeRequest *done_head;
+    struct RangeRequest *done_tail;
+
+    struct RangeRequest *free_requests;
+};
+
+struct Session {
+    struct SessionLoop *loop;
+
+    char *in;         // SESSION_IN_SIZE байт, память цикла
+    size_t in_start;  // начало неразобранных данных
+    size_t in_len;
+    bool in_busy;     // ядро пишет в хвост in, сдвигать его нельзя
+
+    int inflight;             // запросы соединения, переданные в пул
+    uint32_t frame_remaining; // неразобранные записи текущего кадра v2
+    // Ответы на старые кадры идут строго по порядку, поэтому следующий
+    // кадр разбирается только после ответа на такой запрос
+    bool legacy_pending;
+
+    bool peer_eof;  // клиент закрыл свою сторону
+    bool dead;      // соединение закрыто
+};
+
+void SessionLoopInit(struct SessionLoop *loop,
+                     const struct ComputeEngine *engine,
+                     const struct SessionOps *ops, int event_fd);
+
+void SessionInit(struct Session *session, struct SessionLoop *loop, char *in);
+
+// Помечает сессию закрытой и вызывает ops->close один раз
+void SessionClose(struct Session *session);
+
+// Разбирает накопленные кадры, пока хватает данных и лимита запросов
+void SessionProcessInput(struct Session *session);
+
+// Закрывает сессию, если клиент все отправил, ответы доставлены
+// (out_empty) и неполный кадр уже не придет
+void SessionFinishIfDrained(struct Session *session, bool out_empty);
+
+// Отвечает на запросы, завершенные пулом, после сигнала в event_fd;
+// для каждой затронутой сессии вызывает ops->rearm
+void SessionHandleCompleted(struct SessionLoop *loop);
+
+// Счетчики и строка журнала для ответа на одну задачу
+void SessionRecordResult(const struct ComputeEngine *engine,
+                         uint64_t started_ns, uint64_t result, uint32_t path,
+                         uint32_t status);
+
+// Кодирует ответ старым кадром или кадром версии 2 в буфер размером
+// SESSION_REPLY_SIZE и возвращает его длину
+size_t SessionEncodeReply(void *buf, bool legacy, const struct ProtoReply *reply);
+
+// Кадр статистики (PROTO_HEADER_SIZE + PROTO_STATS_SIZE байт)
+void SessionEncodeStats(const struct ComputeEngine *engine, void *buf);
+
+#endif
@@ -0,0 +1,426 @@
+#include "sublinear.h"
+
+#include <stdlib.h>
+
+#if SUBLINEAR_SUPPORTED
+
+typedef unsigned __int128 uint128_t;
+
+// Простые вида c * 2^24 + 1 меньше 2^62. Коэффициенты свертки не больше
+// (d + 1) * p^2 < 2^16 * 2^128, а произведение простых больше 2^185.
+#define NTT_PRIMES 3
+static const uint64_t kNttPrimes[NTT_PRIMES] = {
+    4611686018326724609ULL, 4611686018309947393ULL, 4611686018058289153ULL};
+// Квадратичные невычеты: g^((q - 1) / n) - первообразный корень степени n
+static const uint64_t kNttGenerators[NTT_PRIMES] = {3, 5, 5};
+
+// Поле вычетов по простому для NTT; числа хранятся в форме Montgomery
+struct NttField {
+    uint64_t mod;
+    uint64_t inv;  // -mod^(-1) mod 2^64
+    uint64_t r2;   // 2^128 mod mod
+    uint64_t one;  // 2^64 mod mod
+};
+
+static inline uint64_t FieldReduce(const struct NttField *f, uint128_t x) {
+    uint64_t m = (uint64_t)x * f->inv;
+    uint64_t t = (uint64_t)((x + (uint128_t)m * f->mod) >> 64);
+    return t >= f->mod ? t - f->mod : t;
+}
+
+static inline uint64_t FieldMul(const struct NttField *f, uint64_t a,
+                                uint64_t b) {
+    return FieldReduce(f, (uint128_t)a * b);
+}
+
+static inline uint64_t FieldAdd(const struct NttField *f, uint64_t a,
+                                uint64_t b) {
+    uint64_t s = a + b;
+    return s >= f->mod ? s - f->mod : s;
+}
+
+static inline uint64_t FieldSub(const struct NttField *f, uint64_t a,
+                                uint64_t b) {
+    return a >= b ? a - b : a + f->mod - b;
+}
+
+static inline uint64_t FieldTo(const struct NttField *f, uint64_t x) {
+    return FieldMul(f, x % f->mod, f->r2);
+}
+
+static uint64_t FieldPow(const struct NttField *f, uint64_t base,
+                         uint64_t exp) {
+    uint64_t result = f->one;
+    while (exp > 0) {
+        if (exp & 1)
+            result = FieldMul(f, result, base);
+        base = FieldMul(f, base, base);
+        exp >>= 1;
+    }
+    return result;
+}
+
+static void FieldInit(struct NttField *f, uint64_t mod) {
+    uint64_t inv = mod;
+    for (int i = 0; i < 5; i++)
+        inv *= 2 - mod * inv;
+    f->mod = mod;
+    f->inv = 0 - inv;
+    f->one = (uint64_t)(((uint128_t)1 << 64) % mod);
+    f->r2 = (uint64_t)((uint128_t)f->one * f->one % mod);
+}
+
+// Преобразование длины n (степень двойки) на одном простом. Таблица
+// twiddle хранит n / 2 степеней корня, этап длины len берет каждую
+// (n / len)-ю.
+static void Ntt(const struct NttField *f, uint64_t *a, size_t n,
+                const uint64_t *twiddle) {
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            uint64_t t = a[i];
+            a[i] = a[j];
+            a[j] = t;
+        }
+    }
+
+    for (size_t len = 2; len <= n; len <<= 1) {
+        size_t half = len >> 1;
+        size_t stride = n / len;
+        for (size_t i = 0; i < n; i += len) {
+            for (size_t j = 0; j < half; j++) {
+                uint64_t u = a[i + j];
+                uint64_t v = FieldMul(f, a[i + j + half], twiddle[j * stride]);
+                a[i + j] = FieldAdd(f, u, v);
+                a[i + j + half] = FieldSub(f, u, v);
+            }
+        }
+    }
+}
+
+// Состояние одного шага удвоения: свертки с общим множителем a
+struct Shifter {
+    const struct ModContext *ctx;
+    uint64_t d;
+    size_t n;
+    struct NttField fields[NTT_PRIMES];
+    uint64_t *twiddle[NTT_PRIMES];
+    uint64_t *itwiddle[NTT_PRIMES];
+    uint64_t *a_hat[NTT_PRIMES];  // образ a_i = h(i) / (i! (d - i)! (-1)^(d-i))
+    uint64_t *conv[NTT_PRIMES];
+    uint64_t *x;                  // m - d + t, t = 0..2d
+    uint64_t *prefix;
+    uint64_t *inv_x;
+    uint64_t n_inv[NTT_PRIMES];   // n^(-1) в обычной форме
+
+    // Константы восстановления по китайской теореме об остатках
+    uint64_t q1_inv_q2;        // q1^(-1) mod q2, обычная форма
+    uint64_t q12_inv_q3;       // (q1 q2)^(-1) mod q3, обычная форма
+    uint64_t q1_mont_q3;       // q1 * 2^128 mod q3
+    uint64_t q1_mod_p;
+    uint64_t q12_mod_p;
+};
+
+static inline uint64_t AddModP(uint64_t a, uint64_t b, uint64_t mod) {
+    return (a >= mod - b) ? a - (mod - b) : a + b;
+}
+
+static inline uint64_t SubModP(uint64_t a, uint64_t b, uint64_t mod) {
+    return a >= b ? a - b : a + (mod - b);
+}
+
+static void ShifterFree(struct Shifter *s) {
+    for (int k = 0; k < NTT_PRIMES; k++) {
+        free(s->twiddle[k]);
+        free(s->itwiddle[k]);
+        free(s->a_hat[k]);
+        free(s->conv[k]);
+    }
+    free(s->x);
+    free(s->prefix);
+    free(s->inv_x);
+}
+
+// Готовит свертки для многочлена степени d со значениями h(0..d)
+static bool ShifterInit(struct Shifter *s, const struct ModContext *ctx,
+                        const uint64_t *h, uint64_t d) {
+    uint64_t p = ctx->mod;
+    size_t n = 1;
+    while (n < 2 * d + 1)
+        n <<= 1;
+
+    s->ctx = ctx;
+    s->d = d;
+    s->n = n;
+    s->x = malloc(sizeof(uint64_t) * (2 * d + 1));
+    s->prefix = malloc(sizeof(uint64_t) * (2 * d + 1));
+    s->inv_x = malloc(sizeof(uint64_t) * (2 * d + 1));
+    bool ok = s->x != NULL && s->prefix != NULL && s->inv_x != NULL;
+    for (int k = 0; k < NTT_PRIMES; k++) {
+        FieldInit(&s->fields[k], kNttPrimes[k]);
+        s->twiddle[k] = malloc(sizeof(uint64_t) * (n / 2));
+        s->itwiddle[k] = malloc(sizeof(uint64_t) * (n / 2));
+        s->a_hat[k] = calloc(n, sizeof(uint64_t));
+        s->conv[k] = malloc(sizeof(uint64_t) * n);
+        ok = ok && s->twiddle[k] != NULL && s->itwiddle[k] != NULL &&
+             s->a_hat[k] != NULL && s->conv[k] != NULL;
+    }
+    if (!ok) {
+        ShifterFree(s);
+        return false;
+    }
+
+    // Веса Лагранжа: 1 / (i! (d - i)!) через обратный к d!
+    uint64_t *weight = s->inv_x;
+    uint64_t fact = 1 % p;
+    for (uint64_t i = 1; i <= d; i++)
+        fact = ModMul(ctx, fact, i);
+    uint64_t inv_fact_d = ModPow(ctx, fact, p - 2);
+    // inv_x до первого сдвига хранит 1 / i!
+    weight[d] = inv_fact_d;
+    for (uint64_t i = d; i > 0; i--)
+        weight[i - 1] = ModMul(ctx, weight[i], i);
+
+    for (int k = 0; k < NTT_PRIMES; k++) {
+        const struct NttField *f = &s->fields[k];
+        uint64_t root = FieldPow(f, FieldTo(f, kNttGenerators[k]),
+                                 (f->mod - 1) / n);
+        uint64_t iroot = FieldPow(f, root, f->mod - 2);
+        uint64_t w = f->one, iw = f->one;
+        for (size_t j = 0; j < n / 2; j++) {
+            s->twiddle[k][j] = w;
+            s->itwiddle[k][j] = iw;
+            w = FieldMul(f, w, root);
+            iw = FieldMul(f, iw, iroot);
+        }
+        // n^(-1) в обычной форме, чтобы сразу выйти из формы Montgomery
+        s->n_inv[k] = FieldReduce(f, FieldPow(f, FieldTo(f, n), f->mod - 2));
+    }
+
+    for (uint64_t i = 0; i <= d; i++) {
+        uint64_t a = ModMul(ctx, h[i], ModMul(ctx, weight[i], weight[d - i]));
+        if ((d - i) & 1)
+            a = (p - a) % p;
+        for (int k = 0; k < NTT_PRIMES; k++)
+            s->a_hat[k][i] = FieldTo(&s->fields[k], a);
+    }
+    for (int k = 0; k < NTT_PRIMES; k++)
+        Ntt(&s->fields[k], s->a_hat[k], n, s->twiddle[k]);
+
+    const struct NttField *f2 = &s->fields[1];
+    const struct NttField *f3 = &s->fields[2];
+    uint64_t q1 = kNttPrimes[0], q2 = kNttPrimes[1];
+    s->q1_inv_q2 = FieldReduce(f2, FieldPow(f2, FieldTo(f2, q1), q2 - 2));
+    uint64_t q12 = FieldMul(f3, FieldTo(f3, q1), FieldTo(f3, q2));
+    s->q12_inv_q3 = FieldReduce(f3, FieldPow(f3, q12, kNttPrimes[2] - 2));
+    s->q1_mont_q3 = FieldMul(f3, FieldTo(f3, q1), f3->r2);
+    s->q1_mod_p = q1 % p;
+    s->q12_mod_p = ModMul(ctx, q1 % p, q2 % p);
+    return true;
+}
+
+// По значениям h(0..d) считает h(m), ..., h(m + d). Требует, чтобы числа
+// m - d, ..., m + d не делились на p.
+static void Shift(struct Shifter *s, uint64_t m, uint64_t *out) {
+    const struct ModContext *ctx = s->ctx;
+    uint64_t p = ctx->mod;
+    uint64_t d = s->d;
+    size_t n = s->n;
+    uint64_t count = 2 * d + 1;
+
+    // Обратные к m - d + t одним возведением в степень
+    uint64_t x = SubModP(m % p, d % p, p);
+    for (uint64_t t = 0; t < count; t++) {
+        s->x[t] = x;
+        s->prefix[t] = t == 0 ? x : ModMul(ctx, s->prefix[t - 1], x);
+        x = AddModP(x, 1, p);
+    }
+    uint64_t inv = ModPow(ctx, s->prefix[count - 1], p - 2);
+    for (uint64_t t = count - 1; t > 0; t--) {
+        s->inv_x[t] = ModMul(ctx, inv, s->prefix[t - 1]);
+        inv = ModMul(ctx, inv, s->x[t]);
+    }
+    s->inv_x[0] = inv;
+
+    for (int k = 0; k < NTT_PRIMES; k++) {
+        const struct NttField *f = &s->fields[k];
+        uint64_t *c = s->conv[k];
+        for (uint64_t t = 0; t < count; t++)
+            c[t] = FieldTo(f, s->inv_x[t]);
+        for (size_t t = count; t < n; t++)
+            c[t] = 0;
+        Ntt(f, c, n, s->twiddle[k]);
+        for (size_t t = 0; t < n; t++)
+            c[t] = FieldMul(f, c[t], s->a_hat[k][t]);
+        Ntt(f, c, n, s->itwiddle[k]);
+    }
+
+    // Нужны коэффициенты d..2d; циклическая свертка длины n >= 2d + 1
+    // их не задевает
+    const struct NttField *f1 = &s->fields[0];
+    const struct NttField *f2 = &s->fields[1];
+    const struct NttField *f3 = &s->fields[2];
+    uint64_t prod = s->prefix[d];  // (m - d)(m - d + 1)...(m)
+    for (uint64_t k = 0; k <= d; k++) {
+        size_t idx = d + k;
+        // Умножение формы Montgomery на обычное число дает обычное
+        uint64_t r1 = FieldMul(f1, s->conv[0][idx], s->n_inv[0]);
+        uint64_t r2m = FieldMul(f2, FieldMul(f2, s->conv[1][idx], s->n_inv[1]),
+                                f2->r2);
+        uint64_t r3m = FieldMul(f3, FieldMul(f3, s->conv[2][idx], s->n_inv[2]),
+                                f3->r2);
+
+        uint64_t t2 = FieldMul(f2, FieldSub(f2, r2m, FieldTo(f2, r1)),
+                               s->q1_inv_q2);
+        uint64_t y = FieldSub(f3, r3m, FieldTo(f3, r1));
+        y = FieldSub(f3, y, FieldMul(f3, t2 % f3->mod, s->q1_mont_q3));
+        uint64_t t3 = FieldMul(f3, y, s->q12_inv_q3);
+
+        uint64_t sum = r1 % p;
+        sum = AddModP(sum, ModMul(ctx, t2, s->q1_mod_p), p);
+        sum = AddModP(sum, ModMul(ctx, t3, s->q12_mod_p), p);
+
+        out[k] = ModMul(ctx, prod, sum);
+        if (k < d)
+            prod = ModMul(ctx, ModMul(ctx, prod, s->x[d + k + 1]),
+                          s->inv_x[k]);
+    }
+}
+
+// h - значения f_d(0..d) для f_d(x) = (off + vx + 1)...(off + vx + d);
+// после вызова - значения f_2d(0..2d)
+static bool DoubleStep(const struct ModContext *ctx, uint64_t *h, uint64_t d,
+                       uint64_t v_inv) {
+    uint64_t p = ctx->mod;
+    struct Shifter s;
+    if (!ShifterInit(&s, ctx, h, d))
+        return false;
+
+    uint64_t *upper = malloc(sizeof(uint64_t) * (d + 1));
+    uint64_t *mid = malloc(sizeof(uint64_t) * (2 * d + 2));
+    if (upper == NULL || mid == NULL) {
+        free(upper);
+        free(mid);
+        ShifterFree(&s);
+        return false;
+    }
+
+    // f_2d(i) = f_d(i) * f_d(i + d / v)
+    uint64_t shift = ModMul(ctx, d % p, v_inv);
+    Shift(&s, d + 1, upper);
+    Shift(&s, shift, mid);
+    Shift(&s, AddModP(shift, (d + 1) % p, p), mid + d + 1);
+
+    for (uint64_t i = 0; i <= 2 * d; i++) {
+        uint64_t low = i <= d ? h[i] : upper[i - d - 1];
+        h[i] = ModMul(ctx, low, mid[i]);
+    }
+
+    free(upper);
+    free(mid);
+    ShifterFree(&s);
+    return true;
+}
+
+// f_d -> f_(d+1): домножение на (off + vi + d + 1) и новая точка i = d + 1
+static void IncrementStep(const struct ModContext *ctx, uint64_t *h,
+                          uint64_t d, uint64_t v, uint64_t off) {
+    uint64_t p = ctx->mod;
+    uint64_t term = AddModP(off, (d + 1) % p, p);
+    uint64_t step = v % p;
+    for (uint64_t i = 0; i <= d; i++) {
+        h[i] = ModMul(ctx, h[i], term);
+        term = AddModP(term, step, p);
+    }
+
+    uint64_t base = AddModP(off, ModMul(ctx, v % p, (d + 1) % p), p);
+    uint64_t last = 1 % p;
+    for (uint64_t j = 1; j <= d + 1; j++)
+        last = ModMul(ctx, last, AddModP(base, j % p, p));
+    h[d + 1] = last;
+}
+
+// (off + 1)(off + 2)...(off + v * v) mod p; false при нехватке памяти
+static bool BlockProduct(const struct ModContext *ctx, uint64_t off,
+                         uint64_t v, uint64_t *result) {
+    uint64_t p = ctx->mod;
+    uint64_t *h = malloc(sizeof(uint64_t) * (v + 2));
+    if (h == NULL)
+        return false;
+
+    uint64_t v_inv = ModPow(ctx, v % p, p - 2);
+    h[0] = AddModP(off, 1, p);
+    h[1] = AddModP(h[0], v % p, p);
+    uint64_t d = 1;
+
+    int bit = 63;
+    while (!((v >> bit) & 1))
+        bit--;
+    for (bit--; bit >= 0; bit--) {
+        if (!DoubleStep(ctx, h, d, v_inv)) {
+            free(h);
+            return false;
+        }
+        d *= 2;
+        if ((v >> bit) & 1) {
+            IncrementStep(ctx, h, d, v, off);
+            d++;
+        }
+    }
+
+    uint64_t acc = 1 % p;
+    for (uint64_t i = 0; i < v; i++)
+        acc = ModMul(ctx, acc, h[i]);
+    free(h);
+    *result = acc;
+    return true;
+}
+
+static uint64_t ISqrt(uint64_t n) {
+    uint64_t r = 0;
+    for (int bit = 31; bit >= 0; bit--) {
+        uint64_t c = r | (1ULL << bit);
+        if (c * c <= n)
+            r = c;
+    }
+    return r;
+}
+
+uint64_t SublinearRangeProduct(const struct ModContext *ctx, uint64_t begin,
+                               uint64_t end) {
+    uint64_t p = ctx->mod;
+    if (begin > end)
+        return 1 % p;
+    if (begin == 0 || end - begin >= p - 1 || end / p != (begin - 1) / p)
+        return 0;
+
+    uint64_t acc = 1 % p;
+    uint64_t current = begin;
+    while (end - current + 1 >= SUBLINEAR_MIN_NUMBERS) {
+        uint64_t v = ISqrt(end - current + 1);
+        if (v > SUBLINEAR_MAX_STEP)
+            v = SUBLINEAR_MAX_STEP;
+        // Точки сдвига m +- d не должны совпасть с нулем по модулю p
+        while (v > 1 && v * v + 2 * v + 2 >= p)
+            v /= 2;
+        uint64_t block;
+        if (v < 2 || !BlockProduct(ctx, (current - 1) % p, v, &block))
+            break;
+        acc = ModMul(ctx, acc, block);
+        current += v * v;
+    }
+
+    return ModMul(ctx, acc, ModRangeProduct(ctx, current, end));
+}
+
+#else
+
+uint64_t SublinearRangeProduct(const struct ModContext *ctx, uint64_t begin,
+                               uint64_t end) {
+    return ModRangeProduct(ctx, begin, end);
+}
+
+#endif
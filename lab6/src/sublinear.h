@@ -0,0 +1,32 @@
+#ifndef SUBLINEAR_H
+#define SUBLINEAR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "multmodulo.h"
+
+// Сублинейное произведение требует 128-битного умножения для NTT
+#ifdef __SIZEOF_INT128__
+#define SUBLINEAR_SUPPORTED 1
+#else
+#define SUBLINEAR_SUPPORTED 0
+#endif
+
+// Диапазоны короче этого дешевле перемножить напрямую
+#define SUBLINEAR_MIN_NUMBERS (1ULL << 22)
+
+// Наибольший шаг v: блок из v * v чисел считается за O(v log v), а память
+// на NTT растет как O(v), поэтому длинные диапазоны идут несколькими блоками
+#define SUBLINEAR_MAX_STEP (1U << 16)
+
+// begin * ... * end mod p для простого p = ctx->mod за O(sqrt(n) log n)
+// по методу сдвига точек интерполяции: значения многочлена
+// f_v(x) = (vx + 1)...(vx + v) в точках 0..v получаются удвоением степени,
+// а каждый сдвиг точек - одна свертка через NTT по трем простым.
+// Если диапазон содержит кратное p, результат 0. Без __int128 и при
+// нехватке памяти считается напрямую.
+uint64_t SublinearRangeProduct(const struct ModContext *ctx, uint64_t begin,
+                               uint64_t end);
+
+#endif
@@ -0,0 +1,158 @@
+#define _GNU_SOURCE
+#include "topology.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int ReadId(const char *root, int cpu, const char *name, int fallback) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/cpu%d/topology/%s", root, cpu, name);
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+        return fallback;
+    int value = fallback;
+    if (fscanf(f, "%d", &value) != 1)
+        value = fallback;
+    fclose(f);
+    return value;
+}
+
+// Ключи сортировки для политик; сравнение по cpu делает порядок полным
+static int CompareCompact(const void *a, const void *b) {
+    const struct CpuInfo *x = a, *y = b;
+    if (x->package != y->package)
+        return x->package - y->package;
+    if (x->core != y->core)
+        return x->core - y->core;
+    if (x->smt != y->smt)
+        return x->smt - y->smt;
+    return x->cpu - y->cpu;
+}
+
+static int CompareScatter(const void *a, const void *b) {
+    const struct CpuInfo *x = a, *y = b;
+    if (x->smt != y->smt)
+        return x->smt - y->smt;
+    if (x->core != y->core)
+        return x->core - y->core;
+    if (x->package != y->package)
+        return x->package - y->package;
+    return x->cpu - y->cpu;
+}
+
+int TopologyLoad(struct CpuTopology *topo, const char *root) {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            CPU_SET(cpu, &allowed);
+    }
+
+    topo->count = 0;
+    topo->packages = 0;
+    topo->cores = 0;
+    topo->cpus = malloc(sizeof(struct CpuInfo) * CPU_COUNT(&allowed));
+    if (topo->cpus == NULL)
+        return -1;
+
+    for (int cpu = 0; cpu < CPU_SETSIZE && topo->count < CPU_COUNT(&allowed);
+         cpu++) {
+        if (!CPU_ISSET(cpu, &allowed))
+            continue;
+        struct CpuInfo *info = &topo->cpus[topo->count++];
+        info->cpu = cpu;
+        info->package = ReadId(root, cpu, "physical_package_id", 0);
+        info->core = ReadId(root, cpu, "core_id", cpu);
+        info->smt = 0;
+    }
+
+    // Номер среди SMT-соседей и число ядер/сокетов по отсортированному списку
+    qsort(topo->cpus, topo->count, sizeof(struct CpuInfo), CompareCompact);
+    for (int i = 0; i < topo->count; i++) {
+        struct CpuInfo *info = &topo->cpus[i];
+        const struct CpuInfo *prev = i > 0 ? &topo->cpus[i - 1] : NULL;
+        if (prev != NULL && prev->package == info->package &&
+            prev->core == info->core) {
+            info->smt = prev->smt + 1;
+            continue;
+        }
+        topo->cores++;
+        if (prev == NULL || prev->package != info->package)
+            topo->packages++;
+    }
+    return 0;
+}
+
+void TopologyFree(struct CpuTopology *topo) {
+    free(topo->cpus);
+    topo->cpus = NULL;
+    topo->count = 0;
+}
+
+static const char *kPolicyNames[] = {"none", "compact", "scatter", "physical"};
+
+bool AffinityParse(const char *name, enum AffinityPolicy *policy) {
+    for (int i = 0; i < 4; i++) {
+        if (strcmp(name, kPolicyNames[i]) == 0) {
+            *policy = (enum AffinityPolicy)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *AffinityName(enum AffinityPolicy policy) {
+    return kPolicyNames[policy];
+}
+
+int TopologyOrder(const struct CpuTopology *topo, enum AffinityPolicy policy,
+                  int *order) {
+    struct CpuInfo *sorted = malloc(sizeof(struct CpuInfo) * topo->count);
+    if (sorted == NULL || policy == AFFINITY_NONE) {
+        free(sorted);
+        return 0;
+    }
+    memcpy(sorted, topo->cpus, sizeof(struct CpuInfo) * topo->count);
+    qsort(sorted, topo->count, sizeof(struct CpuInfo), CompareCompact);
+
+    if (policy == AFFINITY_SCATTER) {
+        // Номер ядра внутри сокета вместо core_id (он бывает с пропусками),
+        // затем сортировка по (smt, номер ядра, сокет): сокеты чередуются,
+        // SMT-соседи занимаются после всех ядер
+        int rank = 0;
+        for (int i = 0; i < topo->count; i++) {
+            const struct CpuInfo *prev = i > 0 ? &sorted[i - 1] : NULL;
+            if (prev == NULL || prev->package != sorted[i].package)
+                rank = 0;
+            else if (prev->core != sorted[i].core)
+                rank++;
+            sorted[i].core = rank;
+        }
+        qsort(sorted, topo->count, sizeof(struct CpuInfo), CompareScatter);
+    }
+
+    int n = 0;
+    for (int i = 0; i < topo->count; i++) {
+        if (policy != AFFINITY_PHYSICAL || sorted[i].smt == 0)
+            order[n++] = sorted[i].cpu;
+    }
+    free(sorted);
+    return n;
+}
+
+int AffinityApply(const pthread_t *threads, int threads_count,
+                  const int *order, int order_count) {
+    int failed = 0;
+    if (order_count == 0)
+        return 0;
+    for (int i = 0; i < threads_count; i++) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(order[i % order_count], &set);
+        if (pthread_setaffinity_np(threads[i], sizeof(set), &set) != 0)
+            failed++;
+    }
+    return failed;
+}
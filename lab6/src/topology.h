@@ -0,0 +1,50 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#define TOPOLOGY_SYSFS "/sys/devices/system/cpu"
+
+struct CpuInfo {
+    int cpu;      // номер логического процессора
+    int package;  // сокет
+    int core;     // номер ядра внутри сокета
+    int smt;      // порядковый номер среди SMT-соседей ядра, 0 - первый
+};
+
+// Логические процессоры, доступные процессу (по sched_getaffinity)
+struct CpuTopology {
+    struct CpuInfo *cpus;
+    int count;
+    int packages;
+    int cores;  // физических ядер
+};
+
+enum AffinityPolicy {
+    AFFINITY_NONE,      // потоки размещает ядро ОС
+    AFFINITY_COMPACT,   // SMT-соседи, затем ядра одного сокета, затем сокеты
+    AFFINITY_SCATTER,   // по сокетам поочередно, SMT-соседи в последнюю очередь
+    AFFINITY_PHYSICAL   // как compact, но только первый SMT-сосед каждого ядра
+};
+
+// Читает topology/ каждого доступного процессора под root (обычно
+// TOPOLOGY_SYSFS). Если файлов нет, процессор считается отдельным ядром
+// сокета 0. Возвращает -1 при нехватке памяти.
+int TopologyLoad(struct CpuTopology *topo, const char *root);
+void TopologyFree(struct CpuTopology *topo);
+
+bool AffinityParse(const char *name, enum AffinityPolicy *policy);
+const char *AffinityName(enum AffinityPolicy policy);
+
+// Порядок процессоров для политики: поток i закрепляется за order[i % n].
+// order вмещает topo->count элементов; возвращает n.
+int TopologyOrder(const struct CpuTopology *topo, enum AffinityPolicy policy,
+                  int *order);
+
+// Закрепляет threads[i] за order[i % order_count] через
+// pthread_setaffinity_np; возвращает число неудачных вызовов
+int AffinityApply(const pthread_t *threads, int threads_count,
+                  const int *order, int order_count);
+
+#endif